@@ -4,10 +4,45 @@
 #include <OpenSim/Simulation/Model/Ligament.h>
 #include "CustomAnalysis.h"
 
+// CustomLigament lives in its own plugin: import it, whatever this plugin exports
+#ifdef WIN32
+#undef OSIMPLUGIN_API
+#define OSIMPLUGIN_API __declspec(dllimport)
+#endif
+#include "CustomLigament.h"
+#ifdef WIN32
+#undef OSIMPLUGIN_API
+#define OSIMPLUGIN_API __declspec(dllexport)
+#endif
+
 using namespace OpenSim;
 using namespace SimTK;
 using namespace std;
 
+/*
+*	Tension, length and resting length of the ligament <force> in <s>. A
+*	CustomLigament keeps its resting length in the State (sampled by the
+*	Monte Carlo campaigns), not in its property; NaN for other forces
+*/
+static void getLigamentValues(const Force& force, const SimTK::State& s, double& tension, double& length,
+	double& restingLength)
+{
+	if (const CustomLigament* customLigament = dynamic_cast<const CustomLigament*>(&force))
+	{
+		tension = customLigament->getTension(s);
+		length = customLigament->getLength(s);
+		restingLength = customLigament->getRestingLength(s);
+	}
+	else if (const Ligament* ligament = dynamic_cast<const Ligament*>(&force))
+	{
+		tension = ligament->getTension(s);
+		length = ligament->getLength(s);
+		restingLength = ligament->getRestingLength();
+	}
+	else
+		tension = length = restingLength = SimTK::NaN;
+}
+
 CustomAnalysis::CustomAnalysis() 
 	: Analysis()
 {
@@ -323,38 +358,38 @@ int CustomAnalysis::record(const SimTK::State& s)
 #endif
 #endif
 	//add ligament forces
-	for(int i = 0 ; i < _model->updForceSet().getSize() ; i++)
+	for(int i = 0 ; i < _model->getForceSet().getSize() ; i++)
 	{
-		std::string name = _model->updForceSet()[i].getName();
-		if(name.substr(2, 2) == "CL")
+		const Force& ligament = _model->getForceSet()[i];
+		if(ligament.getName().substr(2, 2) == "CL")
 		{
-			Ligament& ligament = (Ligament &) _model->updForceSet().get(name);
-			double force = ligament.getTension(s);
+			double force, length, restingLength;
+			getLigamentValues(ligament, s, force, length, restingLength);
 			data.append(force);
 		}
 	}
 
 	//add ligament length
-	for(int i = 0 ; i < _model->updForceSet().getSize() ; i++)
+	for(int i = 0 ; i < _model->getForceSet().getSize() ; i++)
 	{
-		std::string name = _model->updForceSet()[i].getName();
-		if(name.substr(2, 2) == "CL")
+		const Force& ligament = _model->getForceSet()[i];
+		if(ligament.getName().substr(2, 2) == "CL")
 		{
-			Ligament& ligament = (Ligament &) _model->updForceSet().get(name);
-			double length = ligament.getLength(s);
+			double force, length, restingLength;
+			getLigamentValues(ligament, s, force, length, restingLength);
 			data.append(length);
 		}
 	}
 
-	//add ligament strain
-	for(int i = 0 ; i < _model->updForceSet().getSize() ; i++)
+	//add ligament strain, against the resting length of the State
+	for(int i = 0 ; i < _model->getForceSet().getSize() ; i++)
 	{
-		std::string name = _model->updForceSet()[i].getName();
-		if(name.substr(2, 2) == "CL")
+		const Force& ligament = _model->getForceSet()[i];
+		if(ligament.getName().substr(2, 2) == "CL")
 		{
-			Ligament& ligament = (Ligament &) _model->updForceSet().get(name);
-			double strain = 
-				(ligament.getLength(s) - ligament.getRestingLength()) / ligament.getRestingLength();
+			double force, length, restingLength;
+			getLigamentValues(ligament, s, force, length, restingLength);
+			double strain = (length - restingLength) / restingLength;
 			data.append(strain);
 		}
 	}
@@ -3,6 +3,7 @@
 #include <OpenSim/Simulation/Model/GeometryPath.h>
 #include <OpenSim/Simulation/Model/PointForceDirection.h>
 #include <OpenSim/Common/SimmSpline.h>
+#include <chrono>
 
 using namespace std;
 using namespace OpenSim;
@@ -11,6 +12,7 @@ using SimTK::Vec3;
 static const Vec3 DefaultCustomLigamentColor(.9,.9,.9); 
 
 CustomLigament::CustomLigament()
+	: _profiling(false), _numComputeForceCalls(0), _computeForceTime(0)
 {
 	constructProperties();
 }
@@ -80,6 +82,32 @@ void CustomLigament::addToSystem(SimTK::MultibodySystem& system) const
 	// Cache the computed tension and strain of the CustomLigament
 	addCacheVariable<double>("tension", 0.0, SimTK::Stage::Velocity);
 	addCacheVariable<double>("strain", 0.0, SimTK::Stage::Velocity);
+
+	// Parameters that may change between simulations without rebuilding the system
+	addDiscreteVariable("resting_length", SimTK::Stage::Instance);
+	addDiscreteVariable("stiffness", SimTK::Stage::Instance);
+	addDiscreteVariable("damping", SimTK::Stage::Instance);
+	addDiscreteVariable("el", SimTK::Stage::Instance);
+}
+
+void CustomLigament::initStateFromProperties(SimTK::State& state) const
+{
+	Super::initStateFromProperties(state);
+
+	setDiscreteVariable(state, "resting_length", get_resting_length());
+	setDiscreteVariable(state, "stiffness", get_stiffness());
+	setDiscreteVariable(state, "damping", get_damping());
+	setDiscreteVariable(state, "el", get_el());
+}
+
+void CustomLigament::setPropertiesFromState(const SimTK::State& state)
+{
+	Super::setPropertiesFromState(state);
+
+	set_resting_length(getRestingLength(state));
+	set_stiffness(getStiffness(state));
+	set_damping(getDamping(state));
+	set_el(getEL(state));
 }
  
 //=============================================================================
@@ -113,6 +141,49 @@ bool CustomLigament::setRestingLength(double aRestingLength)
 	return true;
 }
 
+//-----------------------------------------------------------------------------
+// STATE PARAMETERS
+//-----------------------------------------------------------------------------
+double CustomLigament::getRestingLength(const SimTK::State& s) const
+{
+	return getDiscreteVariable(s, "resting_length");
+}
+
+void CustomLigament::setRestingLength(SimTK::State& s, double aRestingLength) const
+{
+	setDiscreteVariable(s, "resting_length", aRestingLength);
+}
+
+double CustomLigament::getStiffness(const SimTK::State& s) const
+{
+	return getDiscreteVariable(s, "stiffness");
+}
+
+void CustomLigament::setStiffness(SimTK::State& s, double k) const
+{
+	setDiscreteVariable(s, "stiffness", k);
+}
+
+double CustomLigament::getDamping(const SimTK::State& s) const
+{
+	return getDiscreteVariable(s, "damping");
+}
+
+void CustomLigament::setDamping(SimTK::State& s, double c) const
+{
+	setDiscreteVariable(s, "damping", c);
+}
+
+double CustomLigament::getEL(const SimTK::State& s) const
+{
+	return getDiscreteVariable(s, "el");
+}
+
+void CustomLigament::setEL(SimTK::State& s, double e_l) const
+{
+	setDiscreteVariable(s, "el", e_l);
+}
+
 //=============================================================================
 // SCALING
 //=============================================================================
@@ -190,10 +261,30 @@ double CustomLigament::computeMomentArm(const SimTK::State& s, Coordinate& aCoor
 void CustomLigament::computeForce(const SimTK::State& s, 
 							  SimTK::Vector_<SimTK::SpatialVec>& bodyForces, 
 							  SimTK::Vector& generalizedForces) const
+{
+	if (!_profiling) {
+		applyForce(s, bodyForces);
+		return;
+	}
+
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	applyForce(s, bodyForces);
+	_computeForceTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	_numComputeForceCalls++;
+}
+
+void CustomLigament::resetComputeForceCounters() const
+{
+	_numComputeForceCalls = 0;
+	_computeForceTime = 0;
+}
+
+void CustomLigament::applyForce(const SimTK::State& s,
+							SimTK::Vector_<SimTK::SpatialVec>& bodyForces) const
 {
 	const GeometryPath& path = getGeometryPath();
-	const double& restingLength = get_resting_length();
-	const double& damping = get_damping();
+	const double restingLength = getRestingLength(s);
+	const double damping = getDamping(s);
 
 	double force = 0;
 
@@ -205,8 +296,8 @@ void CustomLigament::computeForce(const SimTK::State& s,
 	// evaluate normalized tendon force length curve
 	const double strain_force = force_strain(
 		(path.getLength(s) - restingLength) / restingLength, 
-		get_stiffness(), 
-		get_el());
+		getStiffness(s), 
+		getEL(s));
 	//force = f(e) + dumping * lengthening_speed
 	force = strain_force + damping * path.getLengtheningSpeed(s);
 
@@ -101,6 +101,25 @@ public:
 		return true;
 	}
 
+	//--------------------------------------------------------------------------
+	// STATE PARAMETERS
+	//--------------------------------------------------------------------------
+	/** Resting length, stiffness, damping and el are also kept in the State
+	as Instance-stage discrete variables, initialized from the properties.
+	Changing them in a State only invalidates Stage::Instance, so no
+	initSystem() is needed between simulations with different values. **/
+	double getRestingLength(const SimTK::State& s) const;
+	void setRestingLength(SimTK::State& s, double aRestingLength) const;
+
+	double getStiffness(const SimTK::State& s) const;
+	void setStiffness(SimTK::State& s, double k) const;
+
+	double getDamping(const SimTK::State& s) const;
+	void setDamping(SimTK::State& s, double c) const;
+
+	double getEL(const SimTK::State& s) const;
+	void setEL(SimTK::State& s, double e_l) const;
+
 	//--------------------------------------------------------------------------
 	// COMPUTATIONS
 	//--------------------------------------------------------------------------
@@ -110,6 +129,19 @@ public:
 		SimTK::Vector_<SimTK::SpatialVec>& bodyForces, 
 		SimTK::Vector& generalizedForces) const;
 
+	//--------------------------------------------------------------------------
+	// PROFILING
+	//--------------------------------------------------------------------------
+	/** Count the calls of computeForce and their wall time (off by default).
+	The counters belong to this instance, profile one integration of its
+	model at a time. **/
+	void setProfiling(bool enabled) { _profiling = enabled; }
+	bool isProfiling() const { return _profiling; }
+	void resetComputeForceCounters() const;
+	long long getNumComputeForceCalls() const { return _numComputeForceCalls; }
+	/** Seconds spent in computeForce since the last reset. **/
+	double getComputeForceTime() const { return _computeForceTime; }
+
 	//--------------------------------------------------------------------------
 	// SCALE
 	//--------------------------------------------------------------------------
@@ -158,6 +190,12 @@ protected:
 	allocate and initialize the SimTK state for this CustomLigament.**/
 	void addToSystem(SimTK::MultibodySystem& system) const OVERRIDE_11;
 
+	/** Initialize the state parameters from the properties. **/
+	void initStateFromProperties(SimTK::State& state) const OVERRIDE_11;
+
+	/** Copy the state parameters back to the properties. **/
+	void setPropertiesFromState(const SimTK::State& state) OVERRIDE_11;
+
     /** See if anyone has an opinion about the path color and change it if so. **/
     void realizeDynamics(const SimTK::State& state) const OVERRIDE_11;
 
@@ -197,6 +235,15 @@ private:
 	 */
 	void constructProperties();
 
+	/** Force of the ligament along its path, computeForce without the
+	counters. **/
+	void applyForce(const SimTK::State& s,
+		SimTK::Vector_<SimTK::SpatialVec>& bodyForces) const;
+
+	bool _profiling;
+	mutable long long _numComputeForceCalls;
+	mutable double _computeForceTime;
+
 	/**
 	* Computes force-strain curve
 	*/
@@ -0,0 +1,105 @@
+#include <OpenSim/OpenSim.h>
+#include <OpenSim/Simulation/InverseDynamicsSolver.h>
+#include "ContinuationSweep.h"
+#include "CustomLigament.h"
+#include "KneeKinematicsTable.h"
+#include <cmath>
+
+using namespace std;
+
+// run from KneeSimulation/src, as the simulator
+static const string ModelFile = "../resources/3DGaitModel2392_optimized_v6.osim";
+static const char* FootCoordinates[] = {"ankle_angle_r", "subtalar_angle_r", "mtp_angle_r", "mtp_angle_l"};
+
+/*
+*	Unloaded right knee at <angle> degrees without gravity, the knee angle
+*	locked
+*/
+static SimTK::State& initKnee(Model& model, double angle)
+{
+	SimTK::State& s = model.initSystem();
+	model.updGravityForce().setGravityVector(s, SimTK::Vec3(0));
+	KneeKinematicsTable::getDefault(model).apply(model, s, angle);
+	model.getCoordinateSet().get("knee_angle_r").setLocked(s, true);
+	model.equilibrateMuscles(s);
+	return s;
+}
+
+/*
+*	Largest generalized force of the solved coordinates at rest in <s>,
+*	from the inverse dynamics of OpenSim
+*/
+static double getStaticResidual(const Model& model, SimTK::State& s, const vector<string>& names)
+{
+	s.updU() = 0;
+	InverseDynamicsSolver inverseDynamics(model);
+	SimTK::Vector forces = inverseDynamics.solve(s, SimTK::Vector(s.getNU(), 0.0));
+	double max = 0;
+	for (unsigned int c=0; c<names.size(); c++)
+	{
+		const Coordinate& coordinate = model.getCoordinateSet().get(names[c]);
+		const SimTK::MobilizedBody& mobod = model.getMatterSubsystem().getMobilizedBody(coordinate.getBodyIndex());
+		max = std::max(max, std::fabs(forces[mobod.getFirstUIndex(s) + coordinate.getMobilizerQIndex()]));
+	}
+	return max;
+}
+
+void testSweepEquilibria()
+{
+	// every equilibrium of a flexion sweep holds the free knee coordinates
+	// at rest, whatever the unbalanced foot coordinates do
+	Model model(ModelFile);
+	SimTK::State& s = initKnee(model, 0);
+	const QuasiStaticSettings settings;
+
+	ContinuationSweep sweep(model, settings);
+	sweep.updSolver().addFreeCoordinates(s, "knee_r");
+	const vector<string> names = sweep.updSolver().getCoordinateNames();
+	SimTK_TEST(names.size() == 5);
+
+	const Coordinate& kneeAngle = model.getCoordinateSet().get("knee_angle_r");
+	const double angles[4] = {0, -10, -20, -30};
+	int numEquilibria = 0;
+	sweep.run(s, vector<double>(angles, angles + 4), [&](SimTK::State& s, double angle)
+	{
+		kneeAngle.setLocked(s, false);
+		kneeAngle.setValue(s, angle * SimTK::Pi / 180, false);
+		kneeAngle.setLocked(s, true);
+	},
+		[&](SimTK::State& s, double angle, const QuasiStaticResult& equilibrium)
+	{
+		SimTK_TEST(equilibrium.converged);
+		SimTK_TEST(getStaticResidual(model, s, names) <= settings.residualTolerance);
+		numEquilibria++;
+	});
+	SimTK_TEST(numEquilibria == 4);
+}
+
+void testFootCoordinatesHeld()
+{
+	// the equilibrium does not move when the foot coordinates are locked:
+	// they have no part in the residual of the knee
+	Model model(ModelFile);
+	SimTK::State& s = initKnee(model, -30);
+	QuasiStaticSolver solver(model);
+	solver.addFreeCoordinates(s, "knee_r");
+	QuasiStaticResult free = solver.solve(s);
+	SimTK_TEST(free.converged);
+
+	for (int c=0; c<4; c++)
+		model.getCoordinateSet().get(FootCoordinates[c]).setLocked(s, true);
+	QuasiStaticResult locked = solver.solve(s);
+	SimTK_TEST(locked.converged);
+	SimTK_TEST(locked.iterations == 0);
+	for (unsigned int c=0; c<free.values.size(); c++)
+		SimTK_TEST_EQ_TOL(locked.values[c], free.values[c], 1.e-9);
+}
+
+int main()
+{
+	Object::registerType(CustomLigament());
+	SimTK_START_TEST("testContinuationSweep");
+		SimTK_SUBTEST(testSweepEquilibria);
+		SimTK_SUBTEST(testFootCoordinatesHeld);
+	SimTK_END_TEST();
+}
@@ -0,0 +1,165 @@
+#include <OpenSim/OpenSim.h>
+#include <OpenSim/Simulation/InverseDynamicsSolver.h>
+#include "CustomLigament.h"
+#include "KneeKinematicsTable.h"
+#include "QuasiStaticSolver.h"
+#include <cmath>
+#include <cstdio>
+
+using namespace std;
+
+// run from KneeSimulation/src, as the simulator
+static const string ModelFile = "../resources/3DGaitModel2392_optimized_v6.osim";
+
+static KneeKinematicsTable createTable(const vector<double>& angles, const vector<double>& values)
+{
+	return KneeKinematicsTable(angles, vector<string>(1, "y"), vector<vector<double> >(1, values));
+}
+
+void testEvenSpline()
+{
+	// (0,0) (1,1) (2,0): natural spline with M1 = -3, S(0.5) = S(1.5) = 11/16
+	const double angles[3] = {0, 1, 2}, values[3] = {0, 1, 0};
+	KneeKinematicsTable table = createTable(vector<double>(angles, angles + 3), vector<double>(values, values + 3));
+	for (int a=0; a<3; a++)
+		SimTK_TEST_EQ(table.getValue(0, angles[a]), values[a]);
+	SimTK_TEST_EQ(table.getValue(0, 0.5), 0.6875);
+	SimTK_TEST_EQ(table.getValue(0, 1.5), 0.6875);
+	SimTK_TEST_EQ(table.getValue("y", 0.5), 0.6875);
+}
+
+void testUnevenSpline()
+{
+	// (0,0) (1,1) (3,0): M1 = -1.5, S(0.5) = 19/32, S(2) = 7/8
+	const double angles[3] = {0, 1, 3}, values[3] = {0, 1, 0};
+	KneeKinematicsTable table = createTable(vector<double>(angles, angles + 3), vector<double>(values, values + 3));
+	for (int a=0; a<3; a++)
+		SimTK_TEST_EQ(table.getValue(0, angles[a]), values[a]);
+	SimTK_TEST_EQ(table.getValue(0, 0.5), 0.59375);
+	SimTK_TEST_EQ(table.getValue(0, 2), 0.875);
+}
+
+void testLine()
+{
+	// a natural spline through a line is the line, on even and uneven angles
+	const double even[5] = {-120, -90, -60, -30, 0}, uneven[5] = {-120, -100, -45, -30, 0};
+	const double* angles[2] = {even, uneven};
+	for (int t=0; t<2; t++)
+	{
+		vector<double> values;
+		for (int a=0; a<5; a++)
+			values.push_back(0.01 * angles[t][a] - 0.2);
+		KneeKinematicsTable table = createTable(vector<double>(angles[t], angles[t] + 5), values);
+		for (double angle=-120; angle<=0; angle += 7.5)
+			SimTK_TEST_EQ_TOL(table.getValue(0, angle), 0.01 * angle - 0.2, 1.e-12);
+	}
+}
+
+void testSmoothness()
+{
+	// continuous slope at the knots and zero curvature at the ends
+	const double angles[6] = {-100, -80, -60, -40, -20, 0}, values[6] = {0.3, -0.1, 0.4, 0.2, 0.25, -0.05};
+	KneeKinematicsTable table = createTable(vector<double>(angles, angles + 6), vector<double>(values, values + 6));
+	const double h = 1.e-4;
+	for (int a=1; a<5; a++)
+	{
+		const double left = (table.getValue(0, angles[a]) - table.getValue(0, angles[a] - h)) / h;
+		const double right = (table.getValue(0, angles[a] + h) - table.getValue(0, angles[a])) / h;
+		SimTK_TEST_EQ_TOL(left, right, 1.e-4);
+	}
+	for (int end=0; end<2; end++)
+	{
+		const double angle = end == 0 ? angles[0] + 2 * h : angles[5] - 2 * h;
+		const double curvature = (table.getValue(0, angle + h) - 2 * table.getValue(0, angle)
+			+ table.getValue(0, angle - h)) / (h * h);
+		SimTK_TEST_EQ_TOL(curvature, 0.0, 1.e-4);
+	}
+}
+
+void testBeyondRange()
+{
+	const double angles[3] = {-90, -45, 0}, values[3] = {0.5, 1, 2};
+	KneeKinematicsTable table = createTable(vector<double>(angles, angles + 3), vector<double>(values, values + 3));
+	SimTK_TEST(table.getValue(0, -120) == 0.5);
+	SimTK_TEST(table.getValue(0, 10) == 2);
+
+	// a single angle is constant
+	KneeKinematicsTable single = createTable(vector<double>(1, -30), vector<double>(1, 0.1));
+	SimTK_TEST(single.getValue(0, -60) == 0.1);
+	SimTK_TEST(single.getValue(0, 0) == 0.1);
+}
+
+void testInvalidTables()
+{
+	const double angles[3] = {0, 2, 1}, values[3] = {0, 1, 0};
+	SimTK_TEST_MUST_THROW(createTable(vector<double>(angles, angles + 3), vector<double>(values, values + 3)));
+	SimTK_TEST_MUST_THROW(createTable(vector<double>(angles, angles + 2), vector<double>(values, values + 3)));
+
+	KneeKinematicsTable table = createTable(vector<double>(values, values + 2), vector<double>(values, values + 2));
+	SimTK_TEST_MUST_THROW(table.getValue("knee_angle_r", 0.5));
+}
+
+void testFileVersion()
+{
+	const double angles[3] = {-90, -45, 0}, values[3] = {0.5, 1, 2};
+	KneeKinematicsTable table = createTable(vector<double>(angles, angles + 3), vector<double>(values, values + 3));
+	table.print("testKneeKinematicsTable.sto");
+	KneeKinematicsTable read("testKneeKinematicsTable.sto");
+	std::remove("testKneeKinematicsTable.sto");
+	SimTK_TEST(read.getFileVersion() == KneeKinematicsTable::FileVersion);
+	for (double angle=-90; angle<=0; angle += 15)
+		SimTK_TEST_EQ_TOL(read.getValue(0, angle), table.getValue(0, angle), 1.e-6);
+}
+
+void testGeneratedEquilibria()
+{
+	// each angle is a block of its own, solved from the default table with
+	// the muscles equilibrated there: the inverse dynamics of OpenSim at
+	// rest in the same state leaves no generalized force on the secondary
+	// knee coordinates
+	Model model(ModelFile);
+	KneeKinematicsTable table = KneeKinematicsTable::generate(model, -10, 0, 10, 1);
+	const vector<string>& names = table.getCoordinateNames();
+	SimTK_TEST(table.getAngles().size() == 2);
+	SimTK_TEST(names.size() == 6 && names[0] == "knee_angle_r");
+
+	const double tolerance = QuasiStaticSettings().residualTolerance;
+	for (unsigned int a=0; a<table.getAngles().size(); a++)
+	{
+		const double angle = table.getAngles()[a];
+		SimTK_TEST_EQ(table.getValue(0, angle), angle * SimTK::Pi / 180);
+
+		SimTK::State& s = model.initSystem();
+		model.updGravityForce().setGravityVector(s, SimTK::Vec3(0));
+		KneeKinematicsTable::getDefault(model).apply(model, s, angle);
+		model.getCoordinateSet().get(names[0]).setLocked(s, true);
+		model.equilibrateMuscles(s);
+		for (unsigned int c=1; c<names.size(); c++)
+			model.getCoordinateSet().get(names[c]).setValue(s, table.getValue(c, angle), false);
+		s.updU() = 0;
+
+		InverseDynamicsSolver inverseDynamics(model);
+		SimTK::Vector forces = inverseDynamics.solve(s, SimTK::Vector(s.getNU(), 0.0));
+		for (unsigned int c=1; c<names.size(); c++)
+		{
+			const Coordinate& coordinate = model.getCoordinateSet().get(names[c]);
+			const SimTK::MobilizedBody& mobod = model.getMatterSubsystem().getMobilizedBody(coordinate.getBodyIndex());
+			SimTK_TEST(std::fabs(forces[mobod.getFirstUIndex(s) + coordinate.getMobilizerQIndex()]) <= tolerance);
+		}
+	}
+}
+
+int main()
+{
+	Object::registerType(CustomLigament());
+	SimTK_START_TEST("testKneeKinematicsTable");
+		SimTK_SUBTEST(testEvenSpline);
+		SimTK_SUBTEST(testUnevenSpline);
+		SimTK_SUBTEST(testLine);
+		SimTK_SUBTEST(testSmoothness);
+		SimTK_SUBTEST(testBeyondRange);
+		SimTK_SUBTEST(testInvalidTables);
+		SimTK_SUBTEST(testFileVersion);
+		SimTK_SUBTEST(testGeneratedEquilibria);
+	SimTK_END_TEST();
+}
@@ -0,0 +1,105 @@
+#include <OpenSim/OpenSim.h>
+#include "MCSampler.h"
+
+using namespace std;
+
+/*
+*	First points of the Sobol sequence in 6 dimensions (the origin is
+*	skipped), as generated by Joe and Kuo from new-joe-kuo-6.21201: the
+*	first direction numbers of every dimension
+*/
+static const double SobolPoints[8][6] = {
+	{0.5, 0.5, 0.5, 0.5, 0.5, 0.5},
+	{0.75, 0.25, 0.25, 0.25, 0.75, 0.75},
+	{0.25, 0.75, 0.75, 0.75, 0.25, 0.25},
+	{0.375, 0.375, 0.625, 0.875, 0.375, 0.125},
+	{0.875, 0.875, 0.125, 0.375, 0.875, 0.625},
+	{0.625, 0.125, 0.875, 0.625, 0.625, 0.875},
+	{0.125, 0.625, 0.375, 0.125, 0.125, 0.375},
+	{0.1875, 0.3125, 0.9375, 0.4375, 0.5625, 0.3125}
+};
+
+void testSobolPoints()
+{
+	MCSobolSampler sampler(6);
+	vector<double> u;
+	for (int i=0; i<8; i++)
+	{
+		sampler.getSample(i, u);
+		SimTK_TEST(u.size() == 6);
+		for (int d=0; d<6; d++)
+			SimTK_TEST(u[d] == SobolPoints[i][d]);
+	}
+}
+
+void testSobolIndependentOfDimensions()
+{
+	// a point does not depend on the dimensions after it
+	MCSobolSampler small(3);
+	MCSobolSampler large(MCSobolSampler::getMaxNumDimensions());
+	vector<double> u, v;
+	for (int i=0; i<1024; i += 37)
+	{
+		small.getSample(i, u);
+		large.getSample(i, v);
+		for (int d=0; d<3; d++)
+			SimTK_TEST(u[d] == v[d]);
+	}
+}
+
+void testSobolStratification()
+{
+	// the first 2^k points of every dimension are one per interval of size 2^-k
+	const int k = 10;
+	MCSobolSampler sampler(MCSobolSampler::getMaxNumDimensions());
+	vector<vector<int> > counts(sampler.getNumDimensions(), vector<int>(1 << k, 0));
+	vector<double> u;
+
+	// the origin is point 0 of the sequence
+	for (int d=0; d<sampler.getNumDimensions(); d++)
+		counts[d][0]++;
+	for (int i=0; i<(1 << k) - 1; i++)
+	{
+		sampler.getSample(i, u);
+		for (int d=0; d<sampler.getNumDimensions(); d++)
+			counts[d][(int)(u[d] * (1 << k))]++;
+	}
+	for (int d=0; d<sampler.getNumDimensions(); d++)
+		for (int b=0; b<(1 << k); b++)
+			SimTK_TEST(counts[d][b] == 1);
+}
+
+void testTooManyDimensions()
+{
+	SimTK_TEST_MUST_THROW(MCSobolSampler sampler(MCSobolSampler::getMaxNumDimensions() + 1));
+}
+
+void testHaltonPoints()
+{
+	// radical inverses of 1, 2, 3, 4 in bases 2, 3, 5
+	MCHaltonSampler sampler(3);
+	const double points[4][3] = {
+		{1.0/2, 1.0/3, 1.0/5},
+		{1.0/4, 2.0/3, 2.0/5},
+		{3.0/4, 1.0/9, 3.0/5},
+		{1.0/8, 4.0/9, 4.0/5}
+	};
+	vector<double> u;
+	for (int i=0; i<4; i++)
+	{
+		sampler.getSample(i, u);
+		for (int d=0; d<3; d++)
+			SimTK_TEST_EQ(u[d], points[i][d]);
+	}
+}
+
+int main()
+{
+	SimTK_START_TEST("testMCSampler");
+		SimTK_SUBTEST(testSobolPoints);
+		SimTK_SUBTEST(testSobolIndependentOfDimensions);
+		SimTK_SUBTEST(testSobolStratification);
+		SimTK_SUBTEST(testTooManyDimensions);
+		SimTK_SUBTEST(testHaltonPoints);
+	SimTK_END_TEST();
+}
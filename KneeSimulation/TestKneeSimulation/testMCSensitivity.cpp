@@ -0,0 +1,125 @@
+#include <OpenSim/OpenSim.h>
+#include "MCSensitivity.h"
+
+using namespace std;
+
+/*
+*	Ishigami function on [-pi, pi]^3, a = 7, b = 0.1. Its indices are known
+*	in closed form: V = a^2/8 + b pi^4/5 + b^2 pi^8/18 + 1/2,
+*	V1 = (1 + b pi^4/5)^2 / 2, V2 = a^2/8, V13 = b^2 pi^8 (1/18 - 1/50)
+*/
+static const double IshigamiA = 7;
+static const double IshigamiB = 0.1;
+
+static double getIshigami(const vector<double>& u)
+{
+	const double x1 = -SimTK::Pi + 2 * SimTK::Pi * u[0];
+	const double x2 = -SimTK::Pi + 2 * SimTK::Pi * u[1];
+	const double x3 = -SimTK::Pi + 2 * SimTK::Pi * u[2];
+	return std::sin(x1) + IshigamiA * std::sin(x2) * std::sin(x2) + IshigamiB * std::pow(x3, 4) * std::sin(x1);
+}
+
+static void getIshigamiIndices(vector<double>& firstOrder, vector<double>& total)
+{
+	const double pi4 = std::pow(SimTK::Pi, 4), pi8 = std::pow(SimTK::Pi, 8);
+	const double a = IshigamiA, b = IshigamiB;
+	const double v1 = 0.5 * (1 + b * pi4 / 5) * (1 + b * pi4 / 5);
+	const double v2 = a * a / 8;
+	const double v13 = b * b * pi8 * (1.0 / 18 - 1.0 / 50);
+	const double v = v1 + v2 + v13;
+
+	firstOrder.resize(3);
+	firstOrder[0] = v1 / v;
+	firstOrder[1] = v2 / v;
+	firstOrder[2] = 0;
+	total.resize(3);
+	total[0] = (v1 + v13) / v;
+	total[1] = v2 / v;
+	total[2] = v13 / v;
+}
+
+static void getIshigamiOutputs(int numBaseSamples, vector<double>& y)
+{
+	MCSobolSampler sampler(6);
+	y.resize(numBaseSamples * 5);
+	vector<double> point;
+	for (int e=0; e<(int)y.size(); e++)
+	{
+		MCSensitivity::getDesignPoint(sampler, e, point);
+		y[e] = getIshigami(point);
+	}
+}
+
+void testAnalyticIndices()
+{
+	// the usual values of the literature
+	vector<double> firstOrder, total;
+	getIshigamiIndices(firstOrder, total);
+	SimTK_TEST_EQ_TOL(firstOrder[0], 0.3139, 1e-4);
+	SimTK_TEST_EQ_TOL(firstOrder[1], 0.4424, 1e-4);
+	SimTK_TEST_EQ_TOL(total[0], 0.5576, 1e-4);
+	SimTK_TEST_EQ_TOL(total[2], 0.2437, 1e-4);
+}
+
+void testDesign()
+{
+	// A, B, then A with column i from B, for every base sample
+	MCSobolSampler sampler(6);
+	vector<double> u, point;
+	for (int j=0; j<4; j++)
+	{
+		sampler.getSample(j, u);
+		for (int k=0; k<5; k++)
+		{
+			MCSensitivity::getDesignPoint(sampler, j*5 + k, point);
+			SimTK_TEST(point.size() == 3);
+			for (int p=0; p<3; p++)
+			{
+				const bool fromB = k == 1 || k == 2 + p;
+				SimTK_TEST(point[p] == u[fromB ? 3 + p : p]);
+			}
+		}
+	}
+}
+
+void testIshigamiIndices()
+{
+	vector<double> y;
+	getIshigamiOutputs(4096, y);
+
+	vector<double> firstOrder, total, expectedFirstOrder, expectedTotal;
+	SimTK_TEST(MCSensitivity::estimateIndices(3, y, firstOrder, total) == 4096);
+	getIshigamiIndices(expectedFirstOrder, expectedTotal);
+	for (int p=0; p<3; p++)
+	{
+		SimTK_TEST_EQ_TOL(firstOrder[p], expectedFirstOrder[p], 0.01);
+		SimTK_TEST_EQ_TOL(total[p], expectedTotal[p], 0.01);
+	}
+}
+
+void testFailedEvaluations()
+{
+	vector<double> y;
+	getIshigamiOutputs(64, y);
+
+	// a failed evaluation leaves its base sample out
+	vector<double> firstOrder, total;
+	y[7] = SimTK::NaN;
+	SimTK_TEST(MCSensitivity::estimateIndices(3, y, firstOrder, total) == 63);
+	SimTK_TEST(SimTK::isFinite(firstOrder[0]) && SimTK::isFinite(total[2]));
+
+	// no indices from a single base sample
+	y.resize(5);
+	SimTK_TEST(MCSensitivity::estimateIndices(3, y, firstOrder, total) == 1);
+	SimTK_TEST(SimTK::isNaN(firstOrder[0]) && SimTK::isNaN(total[0]));
+}
+
+int main()
+{
+	SimTK_START_TEST("testMCSensitivity");
+		SimTK_SUBTEST(testAnalyticIndices);
+		SimTK_SUBTEST(testDesign);
+		SimTK_SUBTEST(testIshigamiIndices);
+		SimTK_SUBTEST(testFailedEvaluations);
+	SimTK_END_TEST();
+}
@@ -0,0 +1,113 @@
+#include <OpenSim/OpenSim.h>
+#include "MCStatistics.h"
+
+using namespace std;
+
+void testP2JainChlamtac()
+{
+	// worked example of Jain and Chlamtac (1985): the median markers after
+	// the 20 observations are 0.02, 0.49, 4.44, 17.20, 38.62
+	const double values[20] = {0.02, 0.15, 0.74, 3.39, 0.83, 22.37, 10.15, 15.43, 38.62, 15.92,
+		34.60, 10.28, 1.47, 0.40, 0.05, 11.39, 0.27, 0.42, 0.09, 11.37};
+	MCP2Quantile median(0.5);
+	for (int i=0; i<20; i++)
+		median.add(values[i]);
+	SimTK_TEST_EQ_TOL(median.getValue(), 4.44, 0.005);
+}
+
+void testP2FewValues()
+{
+	// exact order statistic below five values
+	MCP2Quantile median(0.5);
+	const double values[5] = {3, 1, 4, 0, 2};
+	median.add(values[0]);
+	SimTK_TEST(median.getValue() == 3);
+	median.add(values[1]);
+	median.add(values[2]);
+	SimTK_TEST(median.getValue() == 3);
+	median.add(values[3]);
+	median.add(values[4]);
+	SimTK_TEST(median.getValue() == 2);
+}
+
+void testP2Permutation()
+{
+	// 0..999 in a fixed scrambled order, against the exact quantiles
+	MCP2Quantile low(0.1), median(0.5), high(0.9);
+	for (int i=1; i<=1000; i++)
+	{
+		const double x = (i * 7919) % 1000;
+		low.add(x);
+		median.add(x);
+		high.add(x);
+	}
+	SimTK_TEST_EQ_TOL(low.getValue(), 99.9, 2);
+	SimTK_TEST_EQ_TOL(median.getValue(), 499.5, 2);
+	SimTK_TEST_EQ_TOL(high.getValue(), 899.1, 2);
+
+	// regression values of this sequence
+	SimTK_TEST_EQ_TOL(low.getValue(), 101.45183890876974, 1e-9);
+	SimTK_TEST_EQ_TOL(median.getValue(), 498.91317454637215, 1e-9);
+	SimTK_TEST_EQ_TOL(high.getValue(), 899.44432667548426, 1e-9);
+}
+
+void testWelfordMoments()
+{
+	MCOutputStatistics statistics("x");
+	for (int i=1; i<=1000; i++)
+		statistics.add((i * 7919) % 1000);
+	SimTK_TEST(statistics.getNumSamples() == 1000);
+	// 0..999: mean 999/2, variance n(n+1)/12 with n = 1000
+	SimTK_TEST_EQ(statistics.getMean(), 499.5);
+	SimTK_TEST_EQ(statistics.getVariance(), 1000.0 * 1001.0 / 12.0);
+	SimTK_TEST(statistics.getMin() == 0);
+	SimTK_TEST(statistics.getMax() == 999);
+}
+
+void testWelfordLargeOffset()
+{
+	// the naive sum of squares loses the variance on a large offset
+	MCOutputStatistics statistics("x");
+	const double values[4] = {4, 7, 13, 16};
+	for (int i=0; i<4; i++)
+		statistics.add(1e9 + values[i]);
+	SimTK_TEST_EQ(statistics.getMean(), 1e9 + 10);
+	SimTK_TEST_EQ(statistics.getVariance(), 30.0);
+	SimTK_TEST_EQ(statistics.getConfidenceWidth(2.0), 2 * 2.0 * std::sqrt(30.0) / 2);
+}
+
+void testWelfordOneValue()
+{
+	MCOutputStatistics statistics("x");
+	statistics.add(1.5);
+	SimTK_TEST(statistics.getMean() == 1.5);
+	SimTK_TEST(SimTK::isNaN(statistics.getVariance()));
+}
+
+void testTargetsNeedIndependentSamples()
+{
+	// no valid confidence interval of the mean on low discrepancy points
+	MCStatistics statistics(vector<string>(1, "x"));
+	MCConvergenceTargets targets;
+	targets["x"] = 0.1;
+	SimTK_TEST_MUST_THROW(statistics.setTargets(targets, MCSobol));
+	SimTK_TEST_MUST_THROW(statistics.setTargets(targets, MCHalton));
+	statistics.setTargets(targets, MCPseudoRandom);
+	statistics.setTargets(targets, MCLatinHypercube);
+	SimTK_TEST(statistics.hasTargets());
+	statistics.setTargets(MCConvergenceTargets(), MCSobol);
+	SimTK_TEST(!statistics.hasTargets());
+}
+
+int main()
+{
+	SimTK_START_TEST("testMCStatistics");
+		SimTK_SUBTEST(testP2JainChlamtac);
+		SimTK_SUBTEST(testP2FewValues);
+		SimTK_SUBTEST(testP2Permutation);
+		SimTK_SUBTEST(testWelfordMoments);
+		SimTK_SUBTEST(testWelfordLargeOffset);
+		SimTK_SUBTEST(testWelfordOneValue);
+		SimTK_SUBTEST(testTargetsNeedIndependentSamples);
+	SimTK_END_TEST();
+}
@@ -2,6 +2,12 @@
 #include "osimutils.h"
 #include <ctime>
 #include "CustomLigament.h"
+#include "SteadyStateHandler.h"
+#include "QuasiStaticSolver.h"
+#include "ContinuationSweep.h"
+#include "KneeKinematicsTable.h"
+#include "Profiler.h"
+#include "IntegratorTelemetry.h"
 #include <OpenSim/Auxiliary/auxiliaryTestFunctions.h>
 
 Array_<State> saveEm;
@@ -248,11 +254,9 @@ void anteriorTibialLoadsFD(Model& model, double knee_angle)
 	addTibialLoads(model, knee_angle);
 	
 	// init system
-	std::time_t result = std::time(nullptr);
-	std::cout << "\nBefore initSystem() " << std::asctime(std::localtime(&result)) << endl;
-	SimTK::State& si = model.initSystem();
-	result = std::time(nullptr);
-	std::cout << "\nAfter initSystem() " << std::asctime(std::localtime(&result)) << endl;
+	ProfileScope initSystem("initSystem");
+	SimTK::State& si = SteadyStateHandler::initSystem(model);
+	initSystem.stop();
 	
 	// set gravity	
 	model.updGravityForce().setGravityVector(si, Vec3(0,0,0));
@@ -273,7 +277,9 @@ void anteriorTibialLoadsFD(Model& model, double knee_angle)
 		//	|| muscle_name == "rect_fem_r" || muscle_name == "vas_med_r" || muscle_name == "vas_int_r" || muscle_name == "vas_lat_r" )
 		//		model.getActuators().get(i).setDisabled(si, false);
 	//}
+	ProfileScope equilibrate("equilibrateMuscles");
 	model.equilibrateMuscles( si);
+	equilibrate.stop();
 
 	// Add reporters
     ForceReporter* forceReporter = new ForceReporter(&model);
@@ -282,31 +288,36 @@ void anteriorTibialLoadsFD(Model& model, double knee_angle)
 	CustomAnalysis* customReporter = new CustomAnalysis(&model, "r");
 	model.addAnalysis(customReporter);
 
+	IntegratorTelemetry* telemetry = new IntegratorTelemetry(&model);
+	model.addAnalysis(telemetry);
+
 	// Create the integrator and manager for the simulation.
 	SimTK::RungeKuttaMersonIntegrator integrator(model.getMultibodySystem());
 	//SimTK::CPodesIntegrator integrator(model.getMultibodySystem());
 	//integrator.setAccuracy(1.0e-3);
 	//integrator.setFixedStepSize(0.001);
+	telemetry->setIntegrator(&integrator);
 	Manager manager(model, integrator);
 
 	// Define the initial and final simulation times
 	double initialTime = 0.0;
-	double finalTime = 1.0;
+	double finalTime = 1.0;	// horizon, stops earlier once the tibia settled
 
 	// Integrate from initial time to final time
 	manager.setInitialTime(initialTime);
 	manager.setFinalTime(finalTime);
 	std::cout<<"\n\nIntegrating from "<<initialTime<<" to " <<finalTime<<std::endl;
 
-	result = std::time(nullptr);
-	std::cout << "\nBefore integrate(si) " << std::asctime(std::localtime(&result)) << endl;
-
+	SteadyStateHandler* steadyState = SteadyStateHandler::get(model);
+	steadyState->reset(si);
+	ProfileScope integrate("integrate");
 	manager.integrate(si);
+	integrate.stop();
 
-	result = std::time(nullptr);
-	std::cout << "\nAfter integrate(si) " << std::asctime(std::localtime(&result)) << endl;
+	std::cout << "\n" << steadyState->getReport() << endl;
 
 	// Save the simulation results
+	ProfileScope fileOutput("file_output");
 	//osimModel.updAnalysisSet().adoptAndAppend(forces);
 	Storage statesDegrees(manager.getStateStorage());
 	statesDegrees.print("../outputs/states_ant_load_" + changeToString(abs(knee_angle)) +".sto");
@@ -317,9 +328,155 @@ void anteriorTibialLoadsFD(Model& model, double knee_angle)
 	model.updAnalysisSet().adoptAndAppend(forceReporter);
 	forceReporter->getForceStorage().print("../outputs/force_reporter_ant_load_" + changeToString(abs(knee_angle)) +".mot");
 	customReporter->print( "../outputs/custom_reporter_ant_load_" + changeToString(abs(knee_angle)) +".mot");
+	telemetry->print("../outputs/telemetry_ant_load_" + changeToString(abs(knee_angle)) +".txt");
+	fileOutput.stop();
+	std::cout << "\n" << telemetry->getSummary() << endl;
+	std::cout << "\n" << Profiler::getSummary() << endl;
 
 	model.removeAnalysis(forceReporter);
 	model.removeAnalysis(customReporter);
+	model.removeAnalysis(telemetry);
+}
+
+void anteriorTibialLoadsQS(Model& model, double knee_angle)
+{
+	addTibialLoads(model, knee_angle);
+
+	SimTK::State& si = model.initSystem();
+	model.updGravityForce().setGravityVector(si, Vec3(0,0,0));
+	setKneeAngle(model, si, knee_angle, true, true);
+	model.equilibrateMuscles(si);
+
+	// solve for the knee coordinates left free by setKneeAngle
+	QuasiStaticSolver solver(model);
+	solver.addFreeCoordinates(si, "knee_r");
+
+	std::clock_t start = std::clock();
+	QuasiStaticResult equilibrium = solver.solve(si);
+	std::cout << "\n" << QuasiStaticSolver::getReport(equilibrium) << " in "
+		<< double(std::clock() - start) / CLOCKS_PER_SEC << " s" << endl;
+
+	// one row of results at the equilibrium
+	CustomAnalysis* customReporter = new CustomAnalysis(&model, "r");
+	model.addAnalysis(customReporter);
+	customReporter->begin(si);
+	customReporter->end(si);
+	customReporter->print( "../outputs/custom_reporter_ant_load_qs_" + changeToString(abs(knee_angle)) +".mot");
+
+	model.removeAnalysis(customReporter);
+}
+
+void anteriorTibialLoadsSweep(Model& model, double start_angle, double end_angle, double angle_increment,
+	double load, int num_load_steps)
+{
+	addTibialLoads(model, start_angle, 0);
+
+	SimTK::State& si = model.initSystem();
+	model.updGravityForce().setGravityVector(si, Vec3(0,0,0));
+	setKneeAngle(model, si, start_angle, true, true);
+	model.equilibrateMuscles(si);
+
+	// unloaded knee along the flexion, loaded from there at each angle
+	ContinuationSweep angleSweep(model), loadSweep(model);
+	angleSweep.updSolver().addFreeCoordinates(si, "knee_r");
+	loadSweep.updSolver().addFreeCoordinates(si, "knee_r");
+
+	vector<double> angles;
+	const double increment = (end_angle < start_angle ? -1 : 1) * std::abs(angle_increment);
+	for (int i=0; increment != 0 && (end_angle - start_angle - i * increment) * increment > -1.e-9; i++)
+		angles.push_back(start_angle + i * increment);
+	if (angles.empty() || angles.back() != end_angle)
+		angles.push_back(end_angle);
+	vector<double> loads;
+	for (int i=0; i<=num_load_steps; i++)
+		loads.push_back(load * i / num_load_steps);
+
+	const Coordinate& knee_angle = model.getCoordinateSet().get("knee_angle_r");
+	double angle = start_angle;
+	ContinuationParameter setAngle = [&](SimTK::State& s, double value)
+	{
+		angle = value;
+		knee_angle.setLocked(s, false);
+		knee_angle.setValue(s, value * SimTK::Pi / 180, false);
+		knee_angle.setLocked(s, true);
+		addTibialLoads(model, angle, 0);
+		s.invalidateAll(SimTK::Stage::Dynamics);
+	};
+	ContinuationParameter setLoad = [&](SimTK::State& s, double value)
+	{
+		addTibialLoads(model, angle, value);
+		s.invalidateAll(SimTK::Stage::Dynamics);
+	};
+
+	// one row per equilibrium, the CustomAnalysis translations are
+	// relative to the unloaded knee at the same angle
+	CustomAnalysis* customReporter = new CustomAnalysis(&model, "r");
+	model.addAnalysis(customReporter);
+	Storage loadDisplacement, angleLaxity;
+	loadDisplacement.setName("load_displacement");
+	angleLaxity.setName("angle_laxity");
+	int numPoints = 0;
+	ContinuationObserver record = [&](SimTK::State& s, double value, const QuasiStaticResult& equilibrium)
+	{
+		if (value == 0)
+			customReporter->begin(s);
+		else
+			customReporter->step(s, numPoints);
+		const Array<double>& row = customReporter->m_storage.getLastStateVector()->getData();
+
+		if (numPoints == 0)
+		{
+			const Array<string>& columns = customReporter->m_storage.getColumnLabels();
+			Array<string> labels;
+			labels.append("time");
+			labels.append("flexion_angle");
+			labels.append("load");
+			for (int c=1; c<columns.getSize(); c++)
+				labels.append(columns[c]);
+			loadDisplacement.setColumnLabels(labels);
+
+			Array<string> laxityLabels;
+			laxityLabels.append("time");
+			for (int c=1; c<columns.getSize(); c++)
+				laxityLabels.append(columns[c]);
+			angleLaxity.setColumnLabels(laxityLabels);
+		}
+
+		// time: index of the point in the load-displacement curves
+		Array<double> data;
+		data.append(-angle);
+		data.append(value);
+		data.append(row);
+		loadDisplacement.append(numPoints, data.getSize(), &data[0]);
+		// time: flexion angle (degrees)
+		if (value == loads.back())
+			angleLaxity.append(-angle, row.getSize(), &row[0]);
+		numPoints++;
+	};
+
+	std::clock_t start = std::clock();
+	for (unsigned int a=0; a<angles.size(); a++)
+	{
+		angleSweep.run(si, vector<double>(1, angles[a]), setAngle,
+			[](SimTK::State& s, double value, const QuasiStaticResult& equilibrium) {});
+		SimTK::State unloaded(si);
+
+		loadSweep.restart();
+		loadSweep.run(si, loads, setLoad, record);
+		std::cout << "Knee angle " << angle << " done" << endl;
+
+		si = unloaded;
+		addTibialLoads(model, angle, 0);
+	}
+	std::cout << "\n" << angles.size() << " angles, " << numPoints << " equilibria, "
+		<< angleSweep.getNumSolves() + loadSweep.getNumSolves() << " solves, "
+		<< angleSweep.getNumEvaluations() + loadSweep.getNumEvaluations() << " evaluations in "
+		<< double(std::clock() - start) / CLOCKS_PER_SEC << " s" << endl;
+
+	loadDisplacement.print("../outputs/sweep_ant_load_load_displacement.sto");
+	angleLaxity.print("../outputs/sweep_ant_load_angle_laxity.sto");
+
+	model.removeAnalysis(customReporter);
 }
 
 void flexionFDSimulation(Model& model)
@@ -328,11 +485,9 @@ void flexionFDSimulation(Model& model)
 	//addExtensionController(model);
 
 	// init system
-	std::time_t result = std::time(nullptr);
-	std::cout << "\nBefore initSystem() " << std::asctime(std::localtime(&result)) << endl;
+	ProfileScope initSystem("initSystem");
 	SimTK::State& si = model.initSystem();
-	result = std::time(nullptr);
-	std::cout << "\nAfter initSystem() " << std::asctime(std::localtime(&result)) << endl;
+	initSystem.stop();
 	
 	// set gravity
 	model.updGravityForce().setGravityVector(si, Vec3(-9.80665,0,0));
@@ -340,7 +495,9 @@ void flexionFDSimulation(Model& model)
 	
 	setHipAngle(model, si, 90);
 	setKneeAngle(model, si, 0, false, false);
+	ProfileScope equilibrate("equilibrateMuscles");
 	model.equilibrateMuscles( si);
+	equilibrate.stop();
 
 	// Add reporters
     ForceReporter* forceReporter = new ForceReporter(&model);
@@ -349,12 +506,16 @@ void flexionFDSimulation(Model& model)
 	CustomAnalysis* customReporter = new CustomAnalysis(&model, "r");
 	model.addAnalysis(customReporter);
 
+	IntegratorTelemetry* telemetry = new IntegratorTelemetry(&model);
+	model.addAnalysis(telemetry);
+
 	// Create the integrator and manager for the simulation.
 	SimTK::RungeKuttaMersonIntegrator integrator(model.getMultibodySystem());
 	//SimTK::CPodesIntegrator integrator(model.getMultibodySystem());
 	//integrator.setAccuracy(.01);
 	//integrator.setAccuracy(1e-3);
 	//integrator.setFixedStepSize(0.001);
+	telemetry->setIntegrator(&integrator);
 	Manager manager(model, integrator);
 
 	// Define the initial and final simulation times
@@ -366,15 +527,12 @@ void flexionFDSimulation(Model& model)
 	manager.setFinalTime(finalTime);
 	std::cout<<"\n\nIntegrating from "<<initialTime<<" to " <<finalTime<<std::endl;
 
-	result = std::time(nullptr);
-	std::cout << "\nBefore integrate(si) " << std::asctime(std::localtime(&result)) << endl;
-
+	ProfileScope integrate("integrate");
 	manager.integrate(si);
-
-	result = std::time(nullptr);
-	std::cout << "\nAfter integrate(si) " << std::asctime(std::localtime(&result)) << endl;
+	integrate.stop();
 
 	// Save the simulation results
+	ProfileScope fileOutput("file_output");
 	Storage statesDegrees(manager.getStateStorage());
 	statesDegrees.print("../outputs/states_flex.sto");
 	model.updSimbodyEngine().convertRadiansToDegrees(statesDegrees);
@@ -383,6 +541,10 @@ void flexionFDSimulation(Model& model)
 	// force reporter results
 	forceReporter->getForceStorage().print("../outputs/force_reporter_flex.mot");
 	customReporter->print( "../outputs/custom_reporter_flex.mot");
+	telemetry->print("../outputs/telemetry_flex.txt");
+	fileOutput.stop();
+	std::cout << "\n" << telemetry->getSummary() << endl;
+	std::cout << "\n" << Profiler::getSummary() << endl;
 }
 
 void flexionFDSimulationWithHitMap(Model& model)
@@ -394,11 +556,9 @@ void flexionFDSimulationWithHitMap(Model& model)
     model.setUseVisualizer(true);
 
 	// init system
-	std::time_t result = std::time(nullptr);
-	std::cout << "\nBefore initSystem() " << std::asctime(std::localtime(&result)) << endl;
+	ProfileScope initSystem("initSystem");
 	SimTK::State& si = model.initSystem();
-	result = std::time(nullptr);
-	std::cout << "\nAfter initSystem() " << std::asctime(std::localtime(&result)) << endl;
+	initSystem.stop();
 	
 	// set gravity
 	//model.updGravityForce().setGravityVector(si, Vec3(-9.80665,0,0));
@@ -506,12 +666,16 @@ void flexionFDSimulationWithHitMap(Model& model)
 	CustomAnalysis* customReporter = new CustomAnalysis(&model, "r");
 	model.addAnalysis(customReporter);
 
+	IntegratorTelemetry* telemetry = new IntegratorTelemetry(&model);
+	model.addAnalysis(telemetry);
+
 	// Create the integrator and manager for the simulation.
 	SimTK::RungeKuttaMersonIntegrator integrator(model.getMultibodySystem());
 	//SimTK::CPodesIntegrator integrator(model.getMultibodySystem());
 	//integrator.setAccuracy(.01);
 	//integrator.setAccuracy(1e-3);
 	//integrator.setFixedStepSize(0.001);
+	telemetry->setIntegrator(&integrator);
 	Manager manager(model, integrator);
 
 	// Define the initial and final simulation times
@@ -523,15 +687,12 @@ void flexionFDSimulationWithHitMap(Model& model)
 	manager.setFinalTime(finalTime);
 	std::cout<<"\n\nIntegrating from "<<initialTime<<" to " <<finalTime<<std::endl;
 
-	result = std::time(nullptr);
-	std::cout << "\nBefore integrate(si) " << std::asctime(std::localtime(&result)) << endl;
-
+	ProfileScope integrate("integrate");
 	manager.integrate(state);
-
-	result = std::time(nullptr);
-	std::cout << "\nAfter integrate(si) " << std::asctime(std::localtime(&result)) << endl;
+	integrate.stop();
 
 	// Save the simulation results
+	ProfileScope fileOutput("file_output");
 	Storage statesDegrees(manager.getStateStorage());
 	statesDegrees.print("../outputs/states_flex.sto");
 	model.updSimbodyEngine().convertRadiansToDegrees(statesDegrees);
@@ -540,6 +701,10 @@ void flexionFDSimulationWithHitMap(Model& model)
 	// force reporter results
 	forceReporter->getForceStorage().print("../outputs/force_reporter_flex.mot");
 	//customReporter->print( "../outputs/custom_reporter_flex.mot");
+	telemetry->print("../outputs/telemetry_flex.txt");
+	fileOutput.stop();
+	std::cout << "\n" << telemetry->getSummary() << endl;
+	std::cout << "\n" << Profiler::getSummary() << endl;
 
 	//cout << "You can choose 'Replay'" << endl;
 	int menuId, item;
@@ -575,7 +740,7 @@ void flexionFDSimulationWithHitMap(Model& model)
 	} while (menuId != RunMenuId || item != QuitItem);
 }
 
-void addTibialLoads(Model& model, double knee_angle)
+void addTibialLoads(Model& model, double knee_angle, double load)
 {
 	// edit prescribed force
 	PrescribedForce& prescribedForce = dynamic_cast<PrescribedForce&>(model.updForceSet().get("prescribedForce"));
@@ -586,23 +751,10 @@ void addTibialLoads(Model& model, double knee_angle)
 	//prescribedForce->setName(strs.str());
 	prescribedForce.setBodyName("tibia_r");
 
-	// Set the force and point functions for the new prescribed force
-	if (knee_angle == 0)
-		prescribedForce.setForceFunctions(new Constant(110.0), new Constant(0.0), new Constant(0.0));		// at 0 degrees
-	else if (knee_angle == -15)
-		prescribedForce.setForceFunctions(new Constant(106.25), new Constant(-28.47), new Constant(0.0));	// at -15 degrees
-	else if (knee_angle == -20)
-		prescribedForce.setForceFunctions(new Constant(103.366188), new Constant(-37.6222), new Constant(0.0));	// at -20 degrees (knee_angle)
-	else if (knee_angle == -30)
-		prescribedForce.setForceFunctions(new Constant(95.26279), new Constant(-55), new Constant(0.0));	// at -20 degrees (knee_angle)
-	else if (knee_angle == -40)
-		prescribedForce.setForceFunctions(new Constant(84.26488), new Constant(-70.7066), new Constant(0.0));	// at -40 degrees (knee_angle)
-	else if (knee_angle == -60)
-		prescribedForce.setForceFunctions(new Constant(55), new Constant(-95.2627), new Constant(0.0));	// at -60 degrees (knee_angle)
-	else if (knee_angle == -80)
-		prescribedForce.setForceFunctions(new Constant(19.101), new Constant(-108.3288), new Constant(0.0));	// at -80 degrees (knee_angle)	
-	else if (knee_angle == -90)
-		prescribedForce.setForceFunctions(new Constant(0), new Constant(-110.0), new Constant(0.0));	// at -90 degrees (knee_angle)	
+	// Set the force and point functions for the new prescribed force:
+	// <load> rotated by the knee angle, e.g. (55, -95.2627) N at -60 degrees
+	const double angle = knee_angle * SimTK::Pi / 180;
+	prescribedForce.setForceFunctions(new Constant(load * cos(angle)), new Constant(load * sin(angle)), new Constant(0.0));
 
 	prescribedForce.setPointFunctions(new Constant(0.03), new Constant(-0.03), new Constant(0));
 
@@ -674,34 +826,41 @@ void addExtensionController(Model& model)
 	model.addController( controller);
 }
 
+/*
+*	Knee adduction of the anterior tibial loads experiments, interpolated
+*	between the angles it was tuned at (within the passive kinematics
+*	elsewhere)
+*/
+static const KneeKinematicsTable& getConstrainedAdduction()
+{
+	static const double angles[] = {-90, -80, -60, -40, -30, -20, -15, 0};
+	static const double adduction[] = {
+		-0.05235,		// ant load at -90 degrees flexion (+10 degrees)
+		-0.06981,		// ant load at -80 degrees flexion (+10 degrees)
+		-0.226892,		// ant load at -60 degrees flexion (+4 degrees)
+		-0.16667,		// ant load at -40 degrees flexion (+5 degrees)
+		-0.13512278,	// ant load at -30 degrees flexion (+8 degrees)
+		-0.15708,		// ant load at -20 degrees flexion (+8 degrees)
+		-0.191992,		// ant load at -15 degrees flexion (+5 degrees)
+		-0.29408};		// ant load at 0 degrees flexion (0)
+	static const KneeKinematicsTable table(vector<double>(angles, angles + 8), vector<string>(1, "knee_adduction_r"),
+		vector<vector<double> >(1, vector<double>(adduction, adduction + 8)));
+	return table;
+}
+
 void setATT(Model& model, SimTK::State &si, double angle_degrees)
 {
+	// anterior tibial translation under load, added to the passive one
+	static const double angles[] = {-90, -60, -40, -20, -15, 0};
+	static const double translation[] = {0.0065, 0.0075, 0.0065, 0.005, 0.0045, 0.003};
+	static const KneeKinematicsTable table(vector<double>(angles, angles + 6), vector<string>(1, "knee_anterior_posterior_r"),
+		vector<vector<double> >(1, vector<double>(translation, translation + 6)));
+
 	const CoordinateSet &knee_r_cs = model.getJointSet().get("knee_r").getCoordinateSet();
-    if (angle_degrees == -90)
-	{
-		knee_r_cs.get("knee_anterior_posterior_r").setValue(si, 0.0275 + 0.0065);
-		
-	}
-	else if (angle_degrees == -60)
-	{
-		knee_r_cs.get("knee_anterior_posterior_r").setValue(si, 0.02092232 + 0.0075);
-	}
-	else if (angle_degrees == -40)
-	{
-		knee_r_cs.get("knee_anterior_posterior_r").setValue(si, 0.012679 + 0.0065);
-	}
-	else if (angle_degrees == -20)
-	{
-		knee_r_cs.get("knee_anterior_posterior_r").setValue(si, 0.00522225 + 0.005);
-	}
-	else if (angle_degrees == -15)
-	{
-		knee_r_cs.get("knee_anterior_posterior_r").setValue(si, 0.004 + 0.0045);
-	}
-	else if (angle_degrees == 0)
-	{
-		knee_r_cs.get("knee_anterior_posterior_r").setValue(si, knee_r_cs.get("knee_anterior_posterior_r").getDefaultValue() + 0.003);
-	}
+	knee_r_cs.get("knee_anterior_posterior_r").setLocked(si, false);
+	knee_r_cs.get("knee_anterior_posterior_r").setValue(si,
+		KneeKinematicsTable::getDefault(model).getValue("knee_anterior_posterior_r", angle_degrees)
+		+ table.getValue(0, angle_degrees));
 
 	knee_r_cs.get("knee_anterior_posterior_r").setLocked(si, true);
 	knee_r_cs.get("knee_inferior_superior_r").setLocked(si, true);
@@ -712,158 +871,15 @@ void setATT(Model& model, SimTK::State &si, double angle_degrees)
 void setKneeAngle(Model& model, SimTK::State &si, double angle_degrees, bool lock_knee_angle, bool constrain_adduction)
 {
 	const CoordinateSet &knee_r_cs = model.getJointSet().get("knee_r").getCoordinateSet();
-	if (angle_degrees == -120)
-	{
-		knee_r_cs.get("knee_angle_r").setValue(si, -2.09439510);  // -120 degrees
-		
-		knee_r_cs.get("knee_adduction_r").setValue(si, -0.19163894);
-		knee_r_cs.get("knee_rotation_r").setValue(si, 0.02110966);
-		knee_r_cs.get("knee_anterior_posterior_r").setValue(si, 0.02843407);
-		knee_r_cs.get("knee_inferior_superior_r").setValue(si, -0.41174209);
-		knee_r_cs.get("knee_medial_lateral_r").setValue(si, -0.00329063);
-	}
-	else if (angle_degrees == -100)
-	{
-		knee_r_cs.get("knee_angle_r").setValue(si, -1.74533);  // -100 degrees
-		
-		knee_r_cs.get("knee_adduction_r").setValue(si, -0.23053779);
-		knee_r_cs.get("knee_rotation_r").setValue(si, 0.00044497);
-		knee_r_cs.get("knee_anterior_posterior_r").setValue(si, 0.0293309);
-		knee_r_cs.get("knee_inferior_superior_r").setValue(si, -0.40140432);
-		knee_r_cs.get("knee_medial_lateral_r").setValue(si, -0.00504724);
-	}
-	else if (angle_degrees == -90)
-	{
-		knee_r_cs.get("knee_angle_r").setValue(si, -1.57079);	// -90 degrees
-
-		knee_r_cs.get("knee_adduction_r").setValue(si, -0.24);
-		knee_r_cs.get("knee_rotation_r").setValue(si, 0.008);
-		knee_r_cs.get("knee_anterior_posterior_r").setValue(si, 0.0275);
-		knee_r_cs.get("knee_inferior_superior_r").setValue(si, -0.396);
-		knee_r_cs.get("knee_medial_lateral_r").setValue(si, -0.005);
-
-		if (constrain_adduction)
-			//knee_r_cs.get("knee_adduction_r").setValue(si, -0.24 + 0.2094);   // ant load at -90 degrees flexion (+12 degrees)
-			knee_r_cs.get("knee_adduction_r").setValue(si, -0.05235);   // ant load at -90 degrees flexion (+10 degrees)
-			//knee_r_cs.get("knee_adduction_r").setValue(si, -0.2574532);   // ant load at -90 degrees flexion (-1 degrees)
-			//knee_r_cs.get("knee_adduction_r").setValue(si, -0.1353);   // ant load at -90 degrees flexion (+6 degrees)
-			//knee_r_cs.get("knee_adduction_r").setValue(si, -0.1706);   // ant load at -90 degrees flexion (+4 degrees)
-			//knee_r_cs.get("knee_adduction_r").setValue(si, -0.1004);   // ant load at -90 degrees flexion (+8 degrees)
-	}
-	else if (angle_degrees == -80)
-	{
-		knee_r_cs.get("knee_angle_r").setValue(si, -1.39626);  // -80 degrees
-			
-		knee_r_cs.get("knee_adduction_r").setValue(si, -0.24427703);
-		knee_r_cs.get("knee_rotation_r").setValue(si, 0.01682137);
-		knee_r_cs.get("knee_anterior_posterior_r").setValue(si, 0.02661332);
-		knee_r_cs.get("knee_inferior_superior_r").setValue(si, -0.39351699 );
-		knee_r_cs.get("knee_medial_lateral_r").setValue(si, -0.00483042);
-
-		if (constrain_adduction)
-			knee_r_cs.get("knee_adduction_r").setValue(si, -0.06981);   // ant load at -80 degrees flexion (+10 degrees)
-	}
-	else if (angle_degrees == -60)
-	{
-		knee_r_cs.get("knee_angle_r").setValue(si, -1.0472);  // -60 degrees
-			
-		knee_r_cs.get("knee_adduction_r").setValue(si, -0.29941123);
-		knee_r_cs.get("knee_rotation_r").setValue(si, -0.00183259);
-		knee_r_cs.get("knee_anterior_posterior_r").setValue(si, 0.02092232);
-		knee_r_cs.get("knee_inferior_superior_r").setValue(si, -0.38597298);
-		knee_r_cs.get("knee_medial_lateral_r").setValue(si, -0.00403978);
-
-		if (constrain_adduction)
-			//knee_r_cs.get("knee_adduction_r").setValue(si, -0.264511);   // ant load at -60 degrees flexion (+2 degrees)
-			//knee_r_cs.get("knee_adduction_r").setValue(si, -0.0648476);   // ant load at -60 degrees flexion (-2 degrees)
-			//knee_r_cs.get("knee_adduction_r").setValue(si, -0.157079);   // ant load at -60 degrees flexion (+8 degrees)
-			//knee_r_cs.get("knee_adduction_r").setValue(si, -0.191986);   // ant load at -60 degrees flexion (+6 degrees)
-			knee_r_cs.get("knee_adduction_r").setValue(si, -0.226892);   // ant load at -60 degrees flexion (+4 degrees)
 
-	}
-	else if (angle_degrees == -40)
-	{
-		knee_r_cs.get("knee_angle_r").setValue(si, -0.698132);  // -40 degrees
-			
-		knee_r_cs.get("knee_adduction_r").setValue(si, -0.25397256);
-		knee_r_cs.get("knee_rotation_r").setValue(si, 0.03301188);
-		knee_r_cs.get("knee_anterior_posterior_r").setValue(si, 0.012679);
-		knee_r_cs.get("knee_inferior_superior_r").setValue(si, -0.38227168);
-		knee_r_cs.get("knee_medial_lateral_r").setValue(si, -0.00403308);
-
-		if (constrain_adduction)
-			knee_r_cs.get("knee_adduction_r").setValue(si, -0.16667);   // ant load at -40 degrees flexion (+5 degrees)
-			//knee_r_cs.get("knee_adduction_r").setValue(si, -0.27142576);   // ant load at -40 degrees flexion (-1 degrees)
-			//knee_r_cs.get("knee_adduction_r").setValue(si, -0.148352);   // ant load at -40 degrees flexion (+6 degrees)
-			//knee_r_cs.get("knee_adduction_r").setValue(si, -0.13179956);   // ant load at -40 degrees flexion (+7 degrees)
-	}
-	else if (angle_degrees == -30)
-	{
-		knee_r_cs.get("knee_angle_r").setValue(si, -0.5235987);  // -30 degrees
-		
-		knee_r_cs.get("knee_adduction_r").setValue(si, -0.27474878);
-		knee_r_cs.get("knee_rotation_r").setValue(si, 0.01870684);
-		knee_r_cs.get("knee_anterior_posterior_r").setValue(si, 0.008950625);
-		knee_r_cs.get("knee_inferior_superior_r").setValue(si, -0.38234884);
-		knee_r_cs.get("knee_medial_lateral_r").setValue(si, -0.00444654);
-
-		if (constrain_adduction)
-			knee_r_cs.get("knee_adduction_r").setValue(si, -0.13512278);   // ant load at -30 degrees flexion (+8 degrees)
-
-	}
-	else if (angle_degrees == -20)
-	{
-		knee_r_cs.get("knee_angle_r").setValue(si, -0.349066);  // -20 degrees
-		
-		knee_r_cs.get("knee_adduction_r").setValue(si, -0.295525);
-		knee_r_cs.get("knee_rotation_r").setValue(si, 0.0044018);
-		knee_r_cs.get("knee_anterior_posterior_r").setValue(si, 0.00522225);
-		knee_r_cs.get("knee_inferior_superior_r").setValue(si, -0.382426);
-		knee_r_cs.get("knee_medial_lateral_r").setValue(si, -0.00486);
-
-		if (constrain_adduction)
-			knee_r_cs.get("knee_adduction_r").setValue(si, -0.15708);   // ant load at -20 degrees flexion (+8 degrees)
-			//knee_r_cs.get("knee_adduction_r").setValue(si, -0.330431);   // ant load at -20 degrees flexion (-2 degrees)
-			//knee_r_cs.get("knee_adduction_r").setValue(si, -0.225715);   // ant load at -20 degrees flexion (+4 degrees)
-			//knee_r_cs.get("knee_adduction_r").setValue(si, -0.20943);   // ant load at -20 degrees flexion (+5 degrees)
-			//knee_r_cs.get("knee_adduction_r").setValue(si, -0.243225);   // ant load at -20 degrees flexion (+3 degrees)
-			//knee_r_cs.get("knee_adduction_r").setValue(si, -0.17453);   // ant load at -20 degrees flexion (+7 degrees)
+	// passive knee kinematics at this angle
+	KneeKinematicsTable::getDefault(model).apply(model, si, angle_degrees);
 
-	}
-	else if (angle_degrees == -15)
-	{
-		knee_r_cs.get("knee_angle_r").setValue(si, -0.26179938);  // -15 degrees
- 		
-		knee_r_cs.get("knee_adduction_r").setValue(si, -0.279252);
-		knee_r_cs.get("knee_rotation_r").setValue(si, -0.03060429);
-		knee_r_cs.get("knee_anterior_posterior_r").setValue(si, 0.004);
-		knee_r_cs.get("knee_inferior_superior_r").setValue(si, -0.384);
-		knee_r_cs.get("knee_medial_lateral_r").setValue(si, -0.00391863);
-		
-		if (constrain_adduction)
-			knee_r_cs.get("knee_adduction_r").setValue(si, -0.191992);   // ant load at -15 degrees flexion (+5 degrees)
-			//knee_r_cs.get("knee_adduction_r").setValue(si, -0.314152);   // ant load at -15 degrees flexion (-2 degrees)
-			//knee_r_cs.get("knee_adduction_r").setValue(si, -0.226952);   // ant load at -15 degrees flexion (+3 degrees)
-			//knee_r_cs.get("knee_adduction_r").setValue(si, -0.209442);   // ant load at -15 degrees flexion (+4 degrees)
-			//knee_r_cs.get("knee_adduction_r").setValue(si, -0.157152);   // ant load at -15 degrees flexion (+7 degrees)
-
-	}
-	else if (angle_degrees == 0)
+	const KneeKinematicsTable& adduction = getConstrainedAdduction();
+	if (constrain_adduction && angle_degrees >= adduction.getMinAngle() && angle_degrees <= adduction.getMaxAngle())
 	{
-		knee_r_cs.get("knee_angle_r").setValue(si, knee_r_cs.get("knee_angle_r").getDefaultValue());
-		//knee_r_cs.get("knee_angle_r").setValue(si, 0);
-		
-		knee_r_cs.get("knee_adduction_r").setValue(si, knee_r_cs.get("knee_adduction_r").getDefaultValue());
-		knee_r_cs.get("knee_rotation_r").setValue(si, knee_r_cs.get("knee_rotation_r").getDefaultValue());
-		knee_r_cs.get("knee_anterior_posterior_r").setValue(si, knee_r_cs.get("knee_anterior_posterior_r").getDefaultValue());
-		knee_r_cs.get("knee_inferior_superior_r").setValue(si, knee_r_cs.get("knee_inferior_superior_r").getDefaultValue());
-		//knee_r_cs.get("knee_inferior_superior_r").setValue(si, -0.385578);
-		knee_r_cs.get("knee_medial_lateral_r").setValue(si, knee_r_cs.get("knee_medial_lateral_r").getDefaultValue());
-
-		if (constrain_adduction)
-			knee_r_cs.get("knee_adduction_r").setValue(si, -0.29408);   // ant load at 0 degrees flexion (0)
-			//knee_r_cs.get("knee_adduction_r").setValue(si, -0.259174);   // ant load at 0 degrees flexion (+2)
-			//knee_r_cs.get("knee_adduction_r").setValue(si, -0.31153);   // ant load at 0 degrees flexion (-1)
+		knee_r_cs.get("knee_adduction_r").setLocked(si, false);
+		knee_r_cs.get("knee_adduction_r").setValue(si, adduction.getValue(0, angle_degrees));
 	}
 
 	knee_r_cs.get("knee_angle_r").setLocked(si, lock_knee_angle);
@@ -16,6 +16,23 @@ using namespace SimTK;
 */
 void anteriorTibialLoadsFD(Model& model, double knee_angle);
 /*
+*	Anterior tibial loads experiment at <knee_angle> solved for the static
+*	equilibrium of the free knee coordinates instead of integrating until
+*	the tibia settles (see QuasiStaticSolver)
+*/
+void anteriorTibialLoadsQS(Model& model, double knee_angle);
+/*
+*	Anterior tibial loads experiment swept in one pass: from the static
+*	equilibrium at <start_angle> the unloaded
+*	knee is moved to <end_angle> by <angle_increment> degrees, and at each
+*	angle the load is raised from 0 to <load> in <num_load_steps> steps,
+*	each equilibrium warm started from the previous ones (see
+*	ContinuationSweep). Prints the load-displacement curves of all the
+*	angles and the angle-laxity curve at full load
+*/
+void anteriorTibialLoadsSweep(Model& model, double start_angle = 0, double end_angle = -90,
+	double angle_increment = 1, double load = 110, int num_load_steps = 11);
+/*
 *	Perform a forward dynamic simulation of active knee flexion experiment
 */
 void flexionFDSimulation(Model& model);
@@ -28,9 +45,9 @@ void flexionFDSimulationWithHitMap(Model& model);
 
 /*
 *	Add external forces to tibia accordingly to knee angle 
-*	so that the force is vertical to the tibia
+*	so that the force (<load> N) is vertical to the tibia
 */
-void addTibialLoads(Model& model, double knee_angle);
+void addTibialLoads(Model& model, double knee_angle, double load = 110);
 /*
 *	Activate knee flexion muscles
 *	setting a Constant Actuator Controller
@@ -45,6 +62,7 @@ void addExtensionController(Model& model);
 /* 
 * set desired knee angle to the model, lock/unlock knee flexion coordinate, 
 * unlock/constrai knee adduction to predefined rotations 
+* (the other knee coordinates are interpolated from KneeKinematicsTable::getDefault)
 */
 void setKneeAngle(Model& model, SimTK::State &si, double angle_degrees, bool lock_knee_angle, bool lock_adduction);
 // set hip angle to desired value (degrees) and lock this coordinate
@@ -0,0 +1,91 @@
+#include "ContinuationSweep.h"
+#include <cmath>
+
+ContinuationSweep::ContinuationSweep(const Model& model, const QuasiStaticSettings& settings)
+	: maxBisections(6), m_model(model), m_solver(model, settings), m_numEquilibria(0), m_numSolves(0),
+	m_numEvaluations(0)
+{
+}
+
+void ContinuationSweep::restart()
+{
+	m_numEquilibria = 0;
+}
+
+void ContinuationSweep::setCoordinates(SimTK::State& s, const vector<double>& values) const
+{
+	const vector<string>& names = m_solver.getCoordinateNames();
+	for (unsigned int c=0; c<names.size(); c++)
+		m_model.getCoordinateSet().get(names[c]).setValue(s, values[c], false);
+}
+
+void ContinuationSweep::run(SimTK::State& s, const vector<double>& values, const ContinuationParameter& setParameter,
+	const ContinuationObserver& observer)
+{
+	for (unsigned int v=0; v<values.size(); v++)
+	{
+		const double target = values[v];
+		if (m_numEquilibria == 0)
+		{
+			// nothing to continue from
+			setParameter(s, target);
+			QuasiStaticResult equilibrium = m_solver.solve(s);
+			m_numSolves++;
+			m_numEvaluations += equilibrium.numEvaluations;
+			if (!equilibrium.converged)
+				throw OpenSim::Exception("ContinuationSweep: no equilibrium at " + std::to_string((long double)target)
+					+ ", " + QuasiStaticSolver::getReport(equilibrium));
+			m_values[0] = equilibrium.values;
+			m_parameters[0] = target;
+			m_numEquilibria = 1;
+			observer(s, target, equilibrium);
+			continue;
+		}
+
+		double step = target - m_parameters[0];
+		int numBisections = 0;
+		while (true)
+		{
+			const double last = m_parameters[0];
+			const double next = std::fabs(target - last) <= std::fabs(step) ? target : last + step;
+
+			// secant predictor
+			vector<double> predicted(m_values[0]);
+			if (m_numEquilibria > 1 && m_parameters[0] != m_parameters[1])
+			{
+				const double ratio = (next - last) / (m_parameters[0] - m_parameters[1]);
+				for (unsigned int c=0; c<predicted.size(); c++)
+					predicted[c] += ratio * (m_values[0][c] - m_values[1][c]);
+			}
+
+			SimTK::State saved(s);
+			setParameter(s, next);
+			setCoordinates(s, predicted);
+			QuasiStaticResult equilibrium = m_solver.solve(s);
+			m_numSolves++;
+			m_numEvaluations += equilibrium.numEvaluations;
+
+			if (!equilibrium.converged)
+			{
+				if (++numBisections > maxBisections)
+					throw OpenSim::Exception("ContinuationSweep: no equilibrium from " + std::to_string((long double)last)
+						+ " towards " + std::to_string((long double)target) + ", " + QuasiStaticSolver::getReport(equilibrium));
+				s = saved;
+				step /= 2;
+				continue;
+			}
+
+			m_values[1] = m_values[0];
+			m_parameters[1] = m_parameters[0];
+			m_values[0] = equilibrium.values;
+			m_parameters[0] = next;
+			m_numEquilibria = 2;
+
+			if (next == target)
+			{
+				observer(s, target, equilibrium);
+				break;
+			}
+		}
+	}
+}
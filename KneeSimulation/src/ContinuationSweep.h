@@ -0,0 +1,62 @@
+#ifndef CONTINUATIONSWEEP_H
+#define CONTINUATIONSWEEP_H
+
+#include "QuasiStaticSolver.h"
+#include <functional>
+
+/*
+*	Set the swept parameter (load, knee angle, ...) to <value> in <s>
+*/
+typedef std::function<void(SimTK::State& s, double value)> ContinuationParameter;
+/*
+*	Called at the equilibrium of each requested parameter value
+*/
+typedef std::function<void(SimTK::State& s, double value, const QuasiStaticResult& equilibrium)> ContinuationObserver;
+
+/*
+*	Sequence of quasi-static equilibria along a parameter, each solve warm
+*	started from the previous ones: the coordinates are extrapolated from
+*	the last two equilibria (secant predictor) and a step that does not
+*	converge is halved, from the last equilibrium, up to maxBisections times
+*/
+class ContinuationSweep
+{
+public:
+	ContinuationSweep(const Model& model, const QuasiStaticSettings& settings = QuasiStaticSettings());
+
+	// coordinates solved for at each step
+	QuasiStaticSolver& updSolver() { return m_solver; }
+
+	/*
+	*	Solve at each of <values> in order, starting from the coordinates
+	*	in <s>. Throws if a step cannot be completed
+	*/
+	void run(SimTK::State& s, const vector<double>& values, const ContinuationParameter& setParameter,
+		const ContinuationObserver& observer);
+	/*
+	*	Forget the previous equilibria (the predictor starts again), e.g.
+	*	between two sweeps of another parameter
+	*/
+	void restart();
+
+	int getNumSolves() const { return m_numSolves; }
+	int getNumEvaluations() const { return m_numEvaluations; }
+
+	int maxBisections;
+
+private:
+	void setCoordinates(SimTK::State& s, const vector<double>& values) const;
+
+	const Model& m_model;
+	QuasiStaticSolver m_solver;
+
+	// last two equilibria
+	vector<double> m_values[2];
+	double m_parameters[2];
+	int m_numEquilibria;
+
+	int m_numSolves;
+	int m_numEvaluations;
+};
+
+#endif
@@ -0,0 +1,243 @@
+#include "ForceCostProfiler.h"
+#include "CustomLigament.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+
+// batches of realizations timed, the fastest one counts
+static const int NumBatches = 3;
+
+ForceCostProfiler::ForceCostProfiler(Model* model, int sampleInterval, int numRepeats)
+	: Analysis(model), m_sampleInterval(sampleInterval), m_numRepeats(std::max(1, numRepeats)), m_numSteps(0),
+	m_numStates(0), m_startEvaluations(0), m_samplingEvaluations(0), m_numEvaluations(0), m_baseTime(0)
+{
+	setName("ForceCostProfiler");
+}
+
+/*
+*	Seconds per realization of <s> from Position to Acceleration
+*/
+double ForceCostProfiler::timeRealizations(const SimTK::State& s) const
+{
+	const SimTK::MultibodySystem& system = _model->getMultibodySystem();
+	SimTK::State work(s);
+	system.realize(work, SimTK::Stage::Acceleration);
+
+	double fastest = SimTK::Infinity;
+	for (int b=0; b<NumBatches; b++)
+	{
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int r=0; r<m_numRepeats; r++)
+		{
+			work.invalidateAllCacheAtOrAbove(SimTK::Stage::Position);
+			system.realize(work, SimTK::Stage::Acceleration);
+		}
+		const double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		fastest = std::min(fastest, time / m_numRepeats);
+	}
+	return fastest;
+}
+
+void ForceCostProfiler::measureIsolated(const SimTK::State& s)
+{
+	const SimTK::MultibodySystem& system = _model->getMultibodySystem();
+	const int evaluations = system.getNumRealizationsOfThisStage(SimTK::Stage::Dynamics);
+
+	const ForceSet& forces = _model->getForceSet();
+	SimTK::State none(s);
+	for (int f=0; f<forces.getSize(); f++)
+		forces.get(f).setDisabled(none, true);
+	const double baseTime = timeRealizations(none);
+
+	for (int f=0; f<forces.getSize(); f++)
+	{
+		if (m_costs[f].counted || !m_enabled[f] || forces.get(f).isDisabled(s))
+			continue;
+		SimTK::State one(none);
+		forces.get(f).setDisabled(one, false);
+		// a cheap force may vanish in the noise of the base time
+		const double time = std::max(0.0, timeRealizations(one) - baseTime);
+		m_costs[f].evaluationTime = (m_costs[f].evaluationTime * m_numMeasured[f] + time) / (m_numMeasured[f] + 1);
+		m_numMeasured[f]++;
+	}
+	m_baseTime = (m_baseTime * m_numStates + baseTime) / (m_numStates + 1);
+	m_numStates++;
+
+	m_samplingEvaluations += system.getNumRealizationsOfThisStage(SimTK::Stage::Dynamics) - evaluations;
+}
+
+void ForceCostProfiler::setProfiling(bool profiling)
+{
+	ForceSet& forces = _model->updForceSet();
+	for (int f=0; f<forces.getSize(); f++)
+	{
+		CustomLigament* ligament = dynamic_cast<CustomLigament*>(&forces.get(f));
+		if (!ligament)
+			continue;
+		if (profiling)
+			ligament->resetComputeForceCounters();
+		ligament->setProfiling(profiling);
+	}
+}
+
+int ForceCostProfiler::getNumEvaluations() const
+{
+	return _model->getMultibodySystem().getNumRealizationsOfThisStage(SimTK::Stage::Dynamics) - m_startEvaluations
+		- m_samplingEvaluations;
+}
+
+int ForceCostProfiler::begin(SimTK::State& s)
+{
+	m_costs.clear();
+	m_enabled.clear();
+	const ForceSet& forces = _model->getForceSet();
+	for (int f=0; f<forces.getSize(); f++)
+	{
+		ForceCost cost;
+		cost.name = forces.get(f).getName();
+		cost.type = forces.get(f).getConcreteClassName();
+		cost.numForces = 1;
+		cost.counted = dynamic_cast<const CustomLigament*>(&forces.get(f)) != nullptr;
+		m_costs.push_back(cost);
+		m_enabled.push_back(!forces.get(f).isDisabled(s));
+	}
+	m_numMeasured.assign(m_costs.size(), 0);
+	m_numSteps = m_numStates = 0;
+	m_baseTime = 0;
+	m_numEvaluations = 0;
+
+	m_startEvaluations = _model->getMultibodySystem().getNumRealizationsOfThisStage(SimTK::Stage::Dynamics);
+	m_samplingEvaluations = 0;
+	measureIsolated(s);
+	setProfiling(true);
+	return 0;
+}
+
+int ForceCostProfiler::step(const SimTK::State& s, int stepNumber)
+{
+	m_numSteps++;
+	if (m_sampleInterval > 0 && m_numSteps % m_sampleInterval == 0)
+		measureIsolated(s);
+	return 0;
+}
+
+int ForceCostProfiler::end(SimTK::State& s)
+{
+	m_numEvaluations = getNumEvaluations();
+
+	const ForceSet& forces = _model->getForceSet();
+	for (int f=0; f<forces.getSize(); f++)
+	{
+		const CustomLigament* ligament = dynamic_cast<const CustomLigament*>(&forces.get(f));
+		if (!ligament)
+			continue;
+		m_costs[f].numCalls = ligament->getNumComputeForceCalls();
+		m_costs[f].totalTime = ligament->getComputeForceTime();
+		m_costs[f].evaluationTime = m_costs[f].numCalls > 0 ? m_costs[f].totalTime / m_costs[f].numCalls : 0;
+	}
+	setProfiling(false);
+	return 0;
+}
+
+static bool isMoreExpensive(const ForceCost& a, const ForceCost& b)
+{
+	return a.evaluationTime > b.evaluationTime;
+}
+
+vector<ForceCost> ForceCostProfiler::getForceCosts() const
+{
+	vector<ForceCost> costs;
+	for (unsigned int f=0; f<m_costs.size(); f++)
+	{
+		if (!m_enabled[f] || (!m_costs[f].counted && m_numMeasured[f] == 0))
+			continue;
+		ForceCost cost = m_costs[f];
+		if (!cost.counted)
+		{
+			cost.numCalls = m_numEvaluations;
+			cost.totalTime = cost.evaluationTime * m_numEvaluations;
+		}
+		costs.push_back(cost);
+	}
+	std::stable_sort(costs.begin(), costs.end(), isMoreExpensive);
+	return costs;
+}
+
+vector<ForceCost> ForceCostProfiler::getTypeCosts() const
+{
+	const vector<ForceCost> forces = getForceCosts();
+	map<string, ForceCost> types;
+	for (unsigned int f=0; f<forces.size(); f++)
+	{
+		ForceCost& type = types[forces[f].type];
+		type.name = type.type = forces[f].type;
+		type.counted = forces[f].counted;
+		type.numForces++;
+		type.evaluationTime += forces[f].evaluationTime;
+		type.numCalls += forces[f].numCalls;
+		type.totalTime += forces[f].totalTime;
+	}
+
+	vector<ForceCost> costs;
+	for (map<string, ForceCost>::const_iterator type = types.begin(); type != types.end(); ++type)
+		costs.push_back(type->second);
+	std::stable_sort(costs.begin(), costs.end(), isMoreExpensive);
+	return costs;
+}
+
+double ForceCostProfiler::getBaseTime() const
+{
+	return m_baseTime;
+}
+
+static double getForcesTime(const vector<ForceCost>& costs)
+{
+	double time = 0;
+	for (unsigned int c=0; c<costs.size(); c++)
+		time += costs[c].evaluationTime;
+	return time;
+}
+
+static void printCosts(ostream& out, const vector<ForceCost>& costs)
+{
+	const double forcesTime = getForcesTime(costs);
+	out << "name\ttype\tforces\tmethod\tevaluation_time\tshare\tcalls\ttotal_time" << endl;
+	for (unsigned int c=0; c<costs.size(); c++)
+		out << costs[c].name << "\t" << costs[c].type << "\t" << costs[c].numForces << "\t"
+			<< (costs[c].counted ? "counted" : "isolated") << "\t" << setprecision(6)
+			<< costs[c].evaluationTime << "\t" << (forcesTime > 0 ? costs[c].evaluationTime / forcesTime : 0) << "\t"
+			<< costs[c].numCalls << "\t" << costs[c].totalTime << endl;
+}
+
+void ForceCostProfiler::print(const string& fileName) const
+{
+	const vector<ForceCost> forces = getForceCosts();
+	ofstream file(fileName.c_str());
+	file << "# " << m_numSteps << " steps, isolated forces timed at " << m_numStates << " states, " << m_numRepeats
+		<< " realizations per force, " << m_numEvaluations << " evaluations in the simulation" << endl;
+	file << "# base time per evaluation (no forces): " << setprecision(6) << m_baseTime << " s, forces: "
+		<< getForcesTime(forces) << " s" << endl;
+	printCosts(file, getTypeCosts());
+	file << endl;
+	printCosts(file, forces);
+}
+
+string ForceCostProfiler::getSummary(int numForces) const
+{
+	const vector<ForceCost> forces = getForceCosts();
+	const vector<ForceCost> types = getTypeCosts();
+	const double forcesTime = getForcesTime(forces);
+	std::ostringstream summary;
+	summary << setprecision(3) << "Force costs per evaluation: " << forcesTime * 1.e6 << " us in the forces, "
+		<< m_baseTime * 1.e6 << " us without them";
+	for (unsigned int t=0; t<types.size(); t++)
+		summary << "\n\t" << types[t].name << " (" << types[t].numForces << "): " << types[t].evaluationTime * 1.e6
+			<< " us, " << (forcesTime > 0 ? 100 * types[t].evaluationTime / forcesTime : 0) << "%";
+	for (int f=0; f<numForces && f<(int)forces.size(); f++)
+		summary << "\n\t" << forces[f].name << ": " << forces[f].evaluationTime * 1.e6 << " us, "
+			<< (forcesTime > 0 ? 100 * forces[f].evaluationTime / forcesTime : 0) << "%";
+	return summary.str();
+}
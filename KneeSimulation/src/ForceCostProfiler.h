@@ -0,0 +1,81 @@
+#ifndef FORCECOSTPROFILER_H
+#define FORCECOSTPROFILER_H
+
+#include <OpenSim/OpenSim.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace OpenSim;
+
+struct ForceCost
+{
+	string name;			// of the force, or of the type for the costs by type
+	string type;
+	int numForces;
+	bool counted;			// computeForce counted and timed, else isolated
+	double evaluationTime;	// seconds per evaluation of the system forces
+	long long numCalls;		// in the simulation
+	double totalTime;		// in the simulation
+
+	ForceCost() : numForces(0), counted(false), evaluationTime(0), numCalls(0), totalTime(0) {}
+};
+
+/*
+*	Cost of every force of the ForceSet over one integration, two ways:
+*	- CustomLigament: its computeForce counts its calls and their wall
+*	  time (CustomLigament::setProfiling) from begin to end
+*	- the others (the contact forces are Simbody force elements without a
+*	  computeForce, the OpenSim forces cannot be derived from here): at the
+*	  initial state and every <sampleInterval> steps, the system is
+*	  realized to Acceleration from Position <numRepeats> times with only
+*	  the force enabled, its cost is the time above the one with every
+*	  force disabled (kinematics, mass matrix, gravity and constraints).
+*	  The calls in the simulation are the evaluations of the system forces
+*	  (Dynamics stage realizations) of the integration.
+*	Forces disabled at the initial state are left out. The realizations of
+*	the sampling are not counted as evaluations but do count in the
+*	budgets of a WatchdogHandler. Added to the model like the other
+*	analyses (the model owns it); read its results before
+*	Model::removeAnalysis
+*/
+class ForceCostProfiler : public Analysis
+{
+OpenSim_DECLARE_CONCRETE_OBJECT(ForceCostProfiler, Analysis);
+public:
+	ForceCostProfiler(Model* model = nullptr, int sampleInterval = 50, int numRepeats = 20);
+
+	int begin(SimTK::State& s);
+	int step(const SimTK::State& s, int stepNumber);
+	int end(SimTK::State& s);
+
+	// ranked, most expensive first
+	vector<ForceCost> getForceCosts() const;
+	vector<ForceCost> getTypeCosts() const;
+	// seconds per evaluation with every force disabled
+	double getBaseTime() const;
+
+	void print(const string& fileName) const;
+	// the <numForces> most expensive forces and every type
+	string getSummary(int numForces = 5) const;
+
+private:
+	double timeRealizations(const SimTK::State& s) const;
+	void measureIsolated(const SimTK::State& s);
+	void setProfiling(bool profiling);
+	int getNumEvaluations() const;
+
+	int m_sampleInterval;
+	int m_numRepeats;
+	int m_numSteps;
+	int m_numStates;
+	int m_startEvaluations;
+	int m_samplingEvaluations;	// realizations of the isolated timings
+	long long m_numEvaluations;
+	double m_baseTime;
+	vector<ForceCost> m_costs;
+	vector<bool> m_enabled;		// at the initial state
+	vector<int> m_numMeasured;	// states each isolated force was timed in
+};
+
+#endif
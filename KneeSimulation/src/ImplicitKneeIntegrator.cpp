@@ -0,0 +1,209 @@
+#include "ImplicitKneeIntegrator.h"
+#include "Profiler.h"
+#include "SteadyStateHandler.h"
+#include "WatchdogHandler.h"
+#include "osimutils.h"
+#include <algorithm>
+#include <cmath>
+
+ImplicitKneeIntegrator::ImplicitKneeIntegrator(Model& model, const ImplicitKneeSettings& settings)
+	: m_model(model), m_settings(settings), m_jacobianAge(0), m_numSteps(0), m_numRejected(0), m_numJacobians(0),
+	m_numRealizations(0)
+{
+}
+
+void ImplicitKneeIntegrator::addImplicitCoordinate(const string& name)
+{
+	m_names.push_back(name);
+}
+
+void ImplicitKneeIntegrator::addFreeCoordinates(const SimTK::State& s, const string& jointName)
+{
+	const CoordinateSet& coordinates = m_model.getJointSet().get(jointName).getCoordinateSet();
+	for (int c=0; c<coordinates.getSize(); c++)
+		if (!coordinates.get(c).getLocked(s) && !coordinates.get(c).isConstrained(s))
+			addImplicitCoordinate(coordinates.get(c).getName());
+}
+
+void ImplicitKneeIntegrator::computeJacobians(const SimTK::State& s)
+{
+	const int n = (int)m_uIndices.size();
+	m_jacobianQ.resize(n, n);
+	m_jacobianU.resize(n, n);
+
+	SimTK::State perturbed(s);
+	for (int j=0; j<n; j++)
+	{
+		for (int wrtU=0; wrtU<2; wrtU++)
+		{
+			perturbed = s;
+			double delta;
+			if (wrtU)
+			{
+				delta = m_settings.perturbation * (1 + std::fabs(s.getU()[m_uIndices[j]]));
+				perturbed.updU()[m_uIndices[j]] += delta;
+			}
+			else
+			{
+				delta = m_settings.perturbation * (1 + std::fabs(s.getQ()[m_qIndices[j]]));
+				perturbed.updQ()[m_qIndices[j]] += delta;
+			}
+			m_model.getMultibodySystem().realize(perturbed, SimTK::Stage::Acceleration);
+			m_numRealizations++;
+
+			SimTK::Matrix& jacobian = wrtU ? m_jacobianU : m_jacobianQ;
+			for (int i=0; i<n; i++)
+				jacobian(i, j) = (perturbed.getUDot()[m_uIndices[i]] - s.getUDot()[m_uIndices[i]]) / delta;
+		}
+	}
+	m_jacobianAge = 0;
+	m_numJacobians++;
+}
+
+double ImplicitKneeIntegrator::step(const SimTK::State& s0, SimTK::State& s1, double h)
+{
+	const int n = (int)m_uIndices.size();
+	const SimTK::Vector& u0 = s0.getU();
+	const SimTK::Vector& a0 = s0.getUDot();
+
+	// implicit knee block
+	SimTK::Matrix iteration(n, n);
+	SimTK::Vector rhs(n);
+	for (int i=0; i<n; i++)
+	{
+		double coupling = 0;
+		for (int j=0; j<n; j++)
+		{
+			iteration(i, j) = (i == j ? 1.0 : 0.0) - h * m_jacobianU(i, j) - h * h * m_jacobianQ(i, j);
+			coupling += m_jacobianQ(i, j) * u0[m_uIndices[j]];
+		}
+		rhs[i] = h * (a0[m_uIndices[i]] + h * coupling);
+	}
+	SimTK::FactorLU lu(iteration);
+	SimTK::Vector du(n);
+	lu.solve(rhs, du);
+
+	// explicit speeds, coordinates from the new speeds, muscle states
+	s1 = s0;
+	SimTK::Vector u1 = u0 + h * a0;
+	for (int i=0; i<n; i++)
+		u1[m_uIndices[i]] = u0[m_uIndices[i]] + du[i];
+	s1.updU() = u1;
+	m_model.getMultibodySystem().realize(s1, SimTK::Stage::Velocity);
+	SimTK::Vector q1 = s0.getQ() + h * s1.getQDot();
+	s1.updQ() = q1;
+	s1.updZ() = s0.getZ() + h * s0.getZDot();
+	s1.setTime(s0.getTime() + h);
+	m_model.getMultibodySystem().realize(s1, SimTK::Stage::Acceleration);
+	m_numRealizations += 2;
+
+	// difference with the trapezoidal rule
+	SimTK::Vector speedError = (s1.getUDot() - a0) * (h / 2);
+	SimTK::Vector coordinateError = (s1.getQDot() - s0.getQDot()) * (h / 2);
+	SimTK::Vector auxiliaryError = (s1.getZDot() - s0.getZDot()) * (h / 2);
+
+	// stiff components of the knee block are damped by the implicit step
+	SimTK::Vector kneeError(n), filtered(n);
+	for (int i=0; i<n; i++)
+		kneeError[i] = speedError[m_uIndices[i]];
+	lu.solve(kneeError, filtered);
+	for (int i=0; i<n; i++)
+		speedError[m_uIndices[i]] = filtered[i];
+
+	double error = 0;
+	const double accuracy = m_settings.accuracy;
+	for (int i=0; i<speedError.size(); i++)
+		error = std::max(error, std::fabs(speedError[i]) / (accuracy * (std::fabs(u1[i]) + m_settings.speedScale)));
+	for (int i=0; i<coordinateError.size(); i++)
+		error = std::max(error, std::fabs(coordinateError[i]) / (accuracy * (std::fabs(q1[i]) + m_settings.coordinateScale)));
+	for (int i=0; i<auxiliaryError.size(); i++)
+		error = std::max(error, std::fabs(auxiliaryError[i])
+			/ (accuracy * (std::fabs(s1.getZ()[i]) + m_settings.auxiliaryScale)));
+	return error;
+}
+
+void ImplicitKneeIntegrator::recordState(const SimTK::State& s)
+{
+	Array<double> values;
+	m_model.getStateValues(s, values);
+	m_states.append(s.getTime(), values.getSize(), values.getSize() > 0 ? &values[0] : 0);
+}
+
+void ImplicitKneeIntegrator::integrate(SimTK::State& s, double finalTime)
+{
+	if (m_names.empty())
+		throw OpenSim::Exception("ImplicitKneeIntegrator: no implicit coordinates");
+
+	getCoordinateIndices(m_model, s, m_names, m_qIndices, m_uIndices);
+
+	Array<string> labels;
+	labels.append("time");
+	labels.append(m_model.getStateVariableNames());
+	m_states.reset(0);
+	m_states.setColumnLabels(labels);
+
+	SteadyStateHandler* steadyState = SteadyStateHandler::get(m_model);
+	double nextCheck = steadyState ? s.getTime() + steadyState->getEventInterval() : SimTK::Infinity;
+	WatchdogHandler* watchdog = WatchdogHandler::get(m_model);
+
+	m_model.getMultibodySystem().realize(s, SimTK::Stage::Acceleration);
+	m_numRealizations++;
+	m_model.updAnalysisSet().begin(s);
+	recordState(s);
+
+	double h = m_settings.initialStepSize;
+	int stepNumber = 0;
+	bool freshJacobians = false;
+	SimTK::State next(s);
+	computeJacobians(s);
+	while (s.getTime() < finalTime - 1.e-12 * std::max(1.0, std::fabs(finalTime)))
+	{
+		// budgets checked on every attempt, rejected steps included: a step
+		// size shrinking without progress is the stall the watchdog stops
+		if (watchdog && watchdog->getValue(s) < 0)
+			break;
+
+		if (m_jacobianAge >= m_settings.jacobianInterval)
+			computeJacobians(s);
+		freshJacobians = m_jacobianAge == 0;
+
+		const double stepSize = std::min(h, finalTime - s.getTime());
+		const double error = step(s, next, stepSize);
+		const double factor = error > 0 && SimTK::isFinite(error) ? 0.9 / std::sqrt(error) : 2.0;
+
+		if (!(error <= 1))
+		{
+			// stale Jacobians first, then smaller steps
+			m_numRejected++;
+			if (freshJacobians)
+				h = stepSize * std::max(0.2, std::min(factor, 0.9));
+			else
+				computeJacobians(s);
+			if (h < m_settings.minStepSize)
+				throw OpenSim::Exception("ImplicitKneeIntegrator: step size below the minimum at t = "
+					+ std::to_string((long double)s.getTime()));
+			continue;
+		}
+
+		s = next;
+		m_numSteps++;
+		m_jacobianAge++;
+		{
+			ProfileScope recording("analysis_recording");
+			m_model.updAnalysisSet().step(s, ++stepNumber);
+			recordState(s);
+		}
+		h = std::min(m_settings.maxStepSize, stepSize * std::max(0.2, std::min(factor, 2.0)));
+
+		if (s.getTime() >= nextCheck)
+		{
+			bool terminate = false;
+			steadyState->handleEvent(s, m_settings.accuracy, terminate);
+			nextCheck += steadyState->getEventInterval();
+			if (terminate)
+				break;
+		}
+	}
+
+	m_model.updAnalysisSet().end(s);
+}
@@ -0,0 +1,97 @@
+#ifndef IMPLICITKNEEINTEGRATOR_H
+#define IMPLICITKNEEINTEGRATOR_H
+
+#include <OpenSim/OpenSim.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace OpenSim;
+
+struct ImplicitKneeSettings
+{
+	double accuracy;
+	double initialStepSize;
+	double minStepSize;
+	double maxStepSize;
+	int jacobianInterval;	// accepted steps between two Jacobians
+	double perturbation;	// relative, finite difference Jacobians
+	// error of a state variable relative to (|value| + scale)
+	double coordinateScale;	// m or rad
+	double speedScale;		// m/s or rad/s
+	double auxiliaryScale;	// muscle states
+
+	ImplicitKneeSettings()
+		: accuracy(1.e-3), initialStepSize(1.e-4), minStepSize(1.e-10), maxStepSize(1.e-2), jacobianInterval(10),
+		perturbation(1.e-7), coordinateScale(1.e-2), speedScale(1.e-1), auxiliaryScale(1.e-1) {}
+};
+
+/*
+*	IMEX integration for stiff knee contact: the coordinates of the knee
+*	(implicit block) are advanced by a linearly implicit Euler step
+*		(I - h dA/du - h^2 dA/dq) du = h (A + h dA/dq u)
+*	where A are their accelerations, so the stiffness of the contact and
+*	ligament forces acting on them (their dependence on the knee
+*	coordinates and speeds) is implicit; the other speeds, the coordinates
+*	(from the new speeds) and the muscle states are explicit.
+*	The Jacobians are computed by finite differences and reused over
+*	several steps. The step size follows the local error, estimated as the
+*	difference with the trapezoidal rule and filtered by the implicit
+*	matrix for the knee block, so that it grows during sustained contact
+*	instead of following the contact stiffness.
+*	Drives the analyses of the model like Manager::integrate and stops on
+*	the steady state of a SteadyStateHandler of the system or out of the
+*	budgets of its WatchdogHandler (checked at every step)
+*/
+class ImplicitKneeIntegrator
+{
+public:
+	ImplicitKneeIntegrator(Model& model, const ImplicitKneeSettings& settings = ImplicitKneeSettings());
+
+	void addImplicitCoordinate(const string& name);
+	/*
+	*	Add the coordinates of joint <jointName> neither locked nor
+	*	constrained in <s>
+	*/
+	void addFreeCoordinates(const SimTK::State& s, const string& jointName);
+
+	/*
+	*	Integrate <s> from its time to <finalTime>
+	*/
+	void integrate(SimTK::State& s, double finalTime);
+
+	// states of the accepted steps
+	Storage& getStateStorage() { return m_states; }
+
+	int getNumStepsTaken() const { return m_numSteps; }
+	int getNumStepsRejected() const { return m_numRejected; }
+	int getNumJacobians() const { return m_numJacobians; }
+	int getNumRealizations() const { return m_numRealizations; }
+
+private:
+	void computeJacobians(const SimTK::State& s);
+	/*
+	*	Step of <h> from <s0> (realized to Acceleration) to <s1>, returns the
+	*	weighted local error (accepted up to 1)
+	*/
+	double step(const SimTK::State& s0, SimTK::State& s1, double h);
+	void recordState(const SimTK::State& s);
+
+	Model& m_model;
+	ImplicitKneeSettings m_settings;
+	vector<string> m_names;
+	vector<int> m_qIndices;
+	vector<int> m_uIndices;
+
+	SimTK::Matrix m_jacobianQ;	// of the knee accelerations
+	SimTK::Matrix m_jacobianU;
+	int m_jacobianAge;
+
+	Storage m_states;
+	int m_numSteps;
+	int m_numRejected;
+	int m_numJacobians;
+	int m_numRealizations;
+};
+
+#endif
@@ -0,0 +1,298 @@
+#include "IntegratorBenchmark.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+
+//=============================================================================
+// SETTINGS
+//=============================================================================
+string IntegratorSettings::getTypeName(IntegratorType type)
+{
+	switch (type)
+	{
+	case RungeKuttaMerson: return "RungeKuttaMerson";
+	case RungeKuttaFeldberg: return "RungeKuttaFeldberg";
+	case RungeKutta3: return "RungeKutta3";
+	case SemiExplicitEuler2: return "SemiExplicitEuler2";
+	case Verlet: return "Verlet";
+	case CPodesBDF: return "CPodesBDF";
+	case MultiRateKnee: return "MultiRateKnee";
+	}
+	return "unknown";
+}
+
+string IntegratorSettings::getName() const
+{
+	std::ostringstream name;
+	name << getTypeName(type);
+	if (fixedStepSize > 0)
+		name << "_step_" << fixedStepSize;
+	else
+		name << "_accuracy_" << accuracy;
+	return name.str();
+}
+
+SimTK::Integrator* IntegratorSettings::createIntegrator(const SimTK::System& system) const
+{
+	SimTK::Integrator* integrator = nullptr;
+	switch (type)
+	{
+	case RungeKuttaMerson: integrator = new SimTK::RungeKuttaMersonIntegrator(system); break;
+	case RungeKuttaFeldberg: integrator = new SimTK::RungeKuttaFeldbergIntegrator(system); break;
+	case RungeKutta3: integrator = new SimTK::RungeKutta3Integrator(system); break;
+	case SemiExplicitEuler2: integrator = new SimTK::SemiExplicitEuler2Integrator(system); break;
+	case Verlet: integrator = new SimTK::VerletIntegrator(system); break;
+	case CPodesBDF: integrator = new SimTK::CPodesIntegrator(system, SimTK::CPodes::BDF, SimTK::CPodes::Newton); break;
+	case MultiRateKnee: return nullptr;
+	}
+
+	integrator->setAccuracy(accuracy);
+	if (fixedStepSize > 0)
+		integrator->setFixedStepSize(fixedStepSize);
+	return integrator;
+}
+
+//=============================================================================
+// BENCHMARK
+//=============================================================================
+IntegratorBenchmark::IntegratorBenchmark(const Model& model, const MCWorkerSetup& setup, const IntegratorBenchmarkTask& task)
+	: m_task(task)
+{
+	m_model = model.clone();
+	if (setup)
+		setup(*m_model);
+	else
+		m_model->initSystem();
+	m_baseState = m_model->getWorkingState();
+
+	// tight reference
+	setReference(IntegratorSettings(RungeKuttaMerson, 1.e-7));
+}
+
+IntegratorBenchmark::~IntegratorBenchmark()
+{
+	delete m_model;
+}
+
+void IntegratorBenchmark::add(const IntegratorSettings& settings)
+{
+	IntegratorBenchmarkResult result;
+	result.settings = settings;
+	m_results.push_back(result);
+}
+
+void IntegratorBenchmark::addDefaultSettings()
+{
+	const double accuracies[] = {1.e-2, 1.e-3, 1.e-4, 1.e-5};
+	for (int a=0; a<4; a++)
+	{
+		add(IntegratorSettings(RungeKuttaMerson, accuracies[a]));
+		add(IntegratorSettings(CPodesBDF, accuracies[a]));
+		if (a > 0)
+		{
+			add(IntegratorSettings(RungeKuttaFeldberg, accuracies[a]));
+			add(IntegratorSettings(RungeKutta3, accuracies[a]));
+			add(IntegratorSettings(SemiExplicitEuler2, accuracies[a]));
+			add(IntegratorSettings(Verlet, accuracies[a]));
+		}
+		if (m_multiRateTask)
+			add(IntegratorSettings(MultiRateKnee, accuracies[a]));
+	}
+	add(IntegratorSettings(RungeKuttaMerson, 1.e-3, 1.e-4));
+	add(IntegratorSettings(RungeKuttaMerson, 1.e-3, 2.5e-5));
+}
+
+void IntegratorBenchmark::run(IntegratorBenchmarkResult& result)
+{
+	result.failed = false;
+	result.wallTime = SimTK::NaN;
+	result.numSteps = result.numAttempts = result.numRejected = result.numRealizations = 0;
+	result.outputs = MCOutputs();
+	result.maxError = SimTK::NaN;
+	result.pareto = false;
+
+	mcLog("Integrator benchmark: " + result.settings.getName());
+	try
+	{
+		SimTK::State state(m_baseState);
+		if (result.settings.type == MultiRateKnee)
+		{
+			runMultiRate(state, result);
+			return;
+		}
+		std::unique_ptr<SimTK::Integrator> integrator(result.settings.createIntegrator(m_model->getMultibodySystem()));
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		m_task(*m_model, state, *integrator, result.outputs);
+		result.wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		result.numSteps = integrator->getNumStepsTaken();
+		result.numAttempts = integrator->getNumStepsAttempted();
+		result.numRejected = integrator->getNumErrorTestFailures() + integrator->getNumConvergenceTestFailures();
+		result.numRealizations = integrator->getNumRealizations();
+	}
+	catch (const std::exception& ex)
+	{
+		result.failed = true;
+		result.message = ex.what();
+		mcLog("Integrator benchmark: " + result.settings.getName() + " failed: " + result.message);
+	}
+}
+
+void IntegratorBenchmark::runMultiRate(SimTK::State& state, IntegratorBenchmarkResult& result)
+{
+	if (!m_multiRateTask)
+		throw OpenSim::Exception("IntegratorBenchmark: no multi-rate task");
+	if (result.settings.fixedStepSize > 0)
+		throw OpenSim::Exception("IntegratorBenchmark: MultiRateKnee has no fixed step size");
+
+	MultiRateKneeSettings settings;
+	settings.accuracy = result.settings.accuracy;
+	MultiRateKneeIntegrator integrator(*m_model, settings);
+	integrator.addFreeCoordinates(state, "knee_r");
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	m_multiRateTask(*m_model, state, integrator, result.outputs);
+	result.wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// macro steps, the knee substeps are in the realizations
+	result.numSteps = integrator.getNumStepsTaken();
+	result.numAttempts = integrator.getNumStepsTaken() + integrator.getNumStepsRejected();
+	result.numRejected = integrator.getNumStepsRejected();
+	result.numRealizations = integrator.getNumRealizations();
+}
+
+void IntegratorBenchmark::run(const vector<string>& outputNames)
+{
+	run(m_reference);
+	if (m_reference.failed)
+		throw OpenSim::Exception("IntegratorBenchmark: the reference " + m_reference.settings.getName()
+			+ " failed: " + m_reference.message);
+	m_reference.maxError = 0;
+	m_outputNames = outputNames.empty() ? m_reference.outputs.names : outputNames;
+
+	for (unsigned int r=0; r<m_results.size(); r++)
+	{
+		IntegratorBenchmarkResult& result = m_results[r];
+		run(result);
+		if (result.failed)
+			continue;
+
+		// relative to the reference
+		result.maxError = 0;
+		for (unsigned int o=0; o<m_outputNames.size(); o++)
+		{
+			vector<string>::const_iterator ref = std::find(m_reference.outputs.names.begin(),
+				m_reference.outputs.names.end(), m_outputNames[o]);
+			vector<string>::const_iterator it = std::find(result.outputs.names.begin(),
+				result.outputs.names.end(), m_outputNames[o]);
+			if (ref == m_reference.outputs.names.end() || it == result.outputs.names.end())
+				throw OpenSim::Exception("IntegratorBenchmark: no output " + m_outputNames[o]);
+
+			const double reference = m_reference.outputs.values[ref - m_reference.outputs.names.begin()];
+			const double value = result.outputs.values[it - result.outputs.names.begin()];
+			const double error = std::fabs(value - reference) / std::max(std::fabs(reference), 1.e-12);
+			result.maxError = std::max(result.maxError, SimTK::isFinite(error) ? error : SimTK::Infinity);
+		}
+	}
+
+	// Pareto front: more accurate than every faster run
+	vector<IntegratorBenchmarkResult*> byTime;
+	for (unsigned int r=0; r<m_results.size(); r++)
+		if (!m_results[r].failed)
+			byTime.push_back(&m_results[r]);
+	std::sort(byTime.begin(), byTime.end(), [](const IntegratorBenchmarkResult* a, const IntegratorBenchmarkResult* b)
+	{
+		return a->wallTime < b->wallTime || (a->wallTime == b->wallTime && a->maxError < b->maxError);
+	});
+	double bestError = SimTK::Infinity;
+	for (unsigned int r=0; r<byTime.size(); r++)
+		if (byTime[r]->maxError < bestError)
+		{
+			byTime[r]->pareto = true;
+			bestError = byTime[r]->maxError;
+		}
+}
+
+const IntegratorBenchmarkResult* IntegratorBenchmark::getRecommendation(double tolerance) const
+{
+	const IntegratorBenchmarkResult* best = nullptr;
+	for (unsigned int r=0; r<m_results.size(); r++)
+		if (m_results[r].pareto && m_results[r].maxError <= tolerance && (!best || m_results[r].wallTime < best->wallTime))
+			best = &m_results[r];
+	return best;
+}
+
+void IntegratorBenchmark::print(const string& fileName, double tolerance) const
+{
+	ofstream file(fileName.c_str());
+	file << "integrator\taccuracy\tfixed_step\twall_time\tsteps\tattempts\trejected\trealizations\tmax_error\tpareto";
+	for (unsigned int o=0; o<m_outputNames.size(); o++)
+		file << "\t" << m_outputNames[o];
+	file << endl;
+
+	vector<const IntegratorBenchmarkResult*> rows(1, &m_reference);
+	for (unsigned int r=0; r<m_results.size(); r++)
+		rows.push_back(&m_results[r]);
+	for (unsigned int r=0; r<rows.size(); r++)
+	{
+		const IntegratorBenchmarkResult& result = *rows[r];
+		file << IntegratorSettings::getTypeName(result.settings.type) << (r == 0 ? "_reference" : "") << "\t"
+			<< result.settings.accuracy << "\t" << result.settings.fixedStepSize << "\t";
+		if (result.failed)
+		{
+			file << "failed: " << result.message << endl;
+			continue;
+		}
+		file << setprecision(6) << result.wallTime << "\t" << result.numSteps << "\t" << result.numAttempts << "\t"
+			<< result.numRejected << "\t" << result.numRealizations << "\t" << result.maxError << "\t"
+			<< (result.pareto ? 1 : 0);
+		for (unsigned int o=0; o<m_outputNames.size(); o++)
+		{
+			vector<string>::const_iterator it = std::find(result.outputs.names.begin(), result.outputs.names.end(),
+				m_outputNames[o]);
+			file << "\t" << (it == result.outputs.names.end() ? SimTK::NaN
+				: result.outputs.values[it - result.outputs.names.begin()]);
+		}
+		file << endl;
+	}
+
+	const IntegratorBenchmarkResult* recommendation = getRecommendation(tolerance);
+	std::ostringstream message;
+	if (recommendation)
+		message << "Recommended integrator (error up to " << tolerance << "): " << recommendation->settings.getName()
+			<< ", " << recommendation->wallTime << " s, error " << recommendation->maxError
+			<< " (reference " << m_reference.wallTime << " s)";
+	else
+		message << "No integrator within an error of " << tolerance;
+	file << endl;
+
+	// multi-rate against single rate at the same accuracy
+	for (unsigned int r=0; r<m_results.size(); r++)
+	{
+		const IntegratorBenchmarkResult& multiRate = m_results[r];
+		if (multiRate.settings.type != MultiRateKnee || multiRate.failed)
+			continue;
+		for (unsigned int o=0; o<m_results.size(); o++)
+		{
+			const IntegratorBenchmarkResult& merson = m_results[o];
+			if (merson.settings.type != RungeKuttaMerson || merson.failed || merson.settings.fixedStepSize > 0
+				|| merson.settings.accuracy != multiRate.settings.accuracy)
+				continue;
+			std::ostringstream comparison;
+			comparison << multiRate.settings.getName() << ": " << multiRate.wallTime << " s, "
+				<< multiRate.numRealizations << " realizations, error " << multiRate.maxError << " against "
+				<< merson.settings.getName() << ": " << merson.wallTime << " s, " << merson.numRealizations
+				<< " realizations, error " << merson.maxError << " (speedup " << merson.wallTime / multiRate.wallTime << ")";
+			file << comparison.str() << endl;
+			mcLog(comparison.str());
+		}
+	}
+
+	file << message.str() << endl;
+	mcLog(message.str());
+}
@@ -0,0 +1,130 @@
+#ifndef INTEGRATORBENCHMARK_H
+#define INTEGRATORBENCHMARK_H
+
+#include <OpenSim/OpenSim.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include "MCEngine.h"
+#include "MCSensitivity.h"
+#include "MultiRateKneeIntegrator.h"
+
+using namespace std;
+using namespace OpenSim;
+
+enum IntegratorType
+{
+	RungeKuttaMerson,
+	RungeKuttaFeldberg,
+	RungeKutta3,
+	SemiExplicitEuler2,
+	Verlet,
+	CPodesBDF,
+	MultiRateKnee	// MultiRateKneeIntegrator, not a SimTK::Integrator
+};
+
+/*
+*	Integrator of a benchmark run: error controlled at <accuracy>, or
+*	with steps of <fixedStepSize> when it is positive
+*/
+struct IntegratorSettings
+{
+	IntegratorType type;
+	double accuracy;
+	double fixedStepSize;
+
+	IntegratorSettings(IntegratorType aType = RungeKuttaMerson, double aAccuracy = 1.e-3, double aFixedStepSize = 0)
+		: type(aType), accuracy(aAccuracy), fixedStepSize(aFixedStepSize) {}
+
+	string getName() const;
+	// owned by the caller, nullptr for MultiRateKnee
+	SimTK::Integrator* createIntegrator(const SimTK::System& system) const;
+
+	static string getTypeName(IntegratorType type);
+};
+
+struct IntegratorBenchmarkResult
+{
+	IntegratorSettings settings;
+	bool failed;
+	string message;		// of the failure
+	double wallTime;	// seconds
+	int numSteps;
+	int numAttempts;
+	int numRejected;	// error and convergence test failures
+	int numRealizations;
+	MCOutputs outputs;
+	double maxError;	// largest relative error of the watched outputs
+	bool pareto;		// no other run both faster and more accurate
+};
+
+/*
+*	Simulation of the benchmarked task from <state> with <integrator>,
+*	filling <outputs> (e.g. CustomAnalysis peaks, see addPeakOutputs)
+*/
+typedef std::function<void(Model& model, SimTK::State& state, SimTK::Integrator& integrator, MCOutputs& outputs)>
+	IntegratorBenchmarkTask;
+/*
+*	Same task with a MultiRateKneeIntegrator on the free knee coordinates
+*/
+typedef std::function<void(Model& model, SimTK::State& state, MultiRateKneeIntegrator& integrator, MCOutputs& outputs)>
+	IntegratorBenchmarkMultiRateTask;
+
+/*
+*	Runs a task with a list of integrator settings and with a tight
+*	reference, one after the other on the same set up model, and compares
+*	wall time, step counts and the error of the outputs. The runs that no
+*	other run beats on both time and error form the Pareto front; the
+*	recommended setting is the fastest one of the front within a tolerance
+*/
+class IntegratorBenchmark
+{
+public:
+	IntegratorBenchmark(const Model& model, const MCWorkerSetup& setup, const IntegratorBenchmarkTask& task);
+	~IntegratorBenchmark();
+
+	void setReference(const IntegratorSettings& settings) { m_reference.settings = settings; }
+	// needed by the MultiRateKnee settings
+	void setMultiRateTask(const IntegratorBenchmarkMultiRateTask& task) { m_multiRateTask = task; }
+	void add(const IntegratorSettings& settings);
+	/*
+	*	Runge-Kutta (Merson, Feldberg, 3), semi-explicit Euler, Verlet and
+	*	CPodes at accuracies 1e-2 to 1e-5, and fixed step Runge-Kutta-Merson;
+	*	MultiRateKnee at the same accuracies with a multi-rate task
+	*/
+	void addDefaultSettings();
+
+	/*
+	*	Run the reference, then every setting; the error is measured on
+	*	<outputNames> (all the outputs if empty)
+	*/
+	void run(const vector<string>& outputNames = vector<string>());
+
+	const IntegratorBenchmarkResult& getReference() const { return m_reference; }
+	const vector<IntegratorBenchmarkResult>& getResults() const { return m_results; }
+	/*
+	*	Fastest run of the Pareto front with a relative error up to
+	*	<tolerance>, nullptr if there is none
+	*/
+	const IntegratorBenchmarkResult* getRecommendation(double tolerance) const;
+
+	/*
+	*	Table of the runs, then each MultiRateKnee run against the
+	*	Runge-Kutta-Merson run of the same accuracy and the recommendation
+	*/
+	void print(const string& fileName, double tolerance) const;
+
+private:
+	void run(IntegratorBenchmarkResult& result);
+	void runMultiRate(SimTK::State& state, IntegratorBenchmarkResult& result);
+
+	Model* m_model;
+	SimTK::State m_baseState;
+	IntegratorBenchmarkTask m_task;
+	IntegratorBenchmarkMultiRateTask m_multiRateTask;
+	IntegratorBenchmarkResult m_reference;
+	vector<IntegratorBenchmarkResult> m_results;
+	vector<string> m_outputNames;
+};
+
+#endif
@@ -0,0 +1,227 @@
+#include "IntegratorTelemetry.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+
+const double IntegratorTelemetry::MinBinStepSize = 1.e-10;
+// 1e-10 to 1 s
+static const int NumBins = 10 * IntegratorTelemetry::BinsPerDecade + 1;
+
+IntegratorTelemetry::IntegratorTelemetry(Model* model)
+	: Analysis(model), m_integrator(nullptr), m_wallTime(0), m_lastTime(0), m_inContact(false), m_numSteps(0),
+	m_numContactChanges(0), m_minStep(0), m_maxStep(0), m_contactTime(0), m_freeTime(0),
+	m_stepsTaken(-1), m_stepsAttempted(-1), m_stepsRejected(-1), m_realizations(-1)
+{
+	setName("IntegratorTelemetry");
+}
+
+static vector<int> getStageRealizations(const SimTK::System& system)
+{
+	vector<int> realizations;
+	for (SimTK::Stage stage = SimTK::Stage::Time; stage <= SimTK::Stage::Acceleration; stage = stage.next())
+		realizations.push_back(system.getNumRealizationsOfThisStage(stage));
+	return realizations;
+}
+
+void IntegratorTelemetry::updateContact(const SimTK::State& s)
+{
+	_model->getMultibodySystem().realize(s, SimTK::Stage::Dynamics);
+	const ForceSet& forces = _model->getForceSet();
+	bool inContact = false;
+	for (unsigned int f=0; f<m_contactForces.size() && !inContact; f++)
+	{
+		const Force& force = forces.get(m_contactForces[f]);
+		if (force.isDisabled(s))
+			continue;
+		const Array<double> values = force.getRecordValues(s);
+		for (int v=0; v<values.getSize() && !inContact; v++)
+			inContact = values[v] != 0;
+	}
+	m_inContact = inContact;
+}
+
+int IntegratorTelemetry::begin(SimTK::State& s)
+{
+	m_contactForces.clear();
+	const ForceSet& forces = _model->getForceSet();
+	for (int f=0; f<forces.getSize(); f++)
+		if (dynamic_cast<const ElasticFoundationForce*>(&forces.get(f))
+			|| dynamic_cast<const HuntCrossleyForce*>(&forces.get(f)))
+			m_contactForces.push_back(f);
+
+	m_start = std::chrono::steady_clock::now();
+	m_wallTime = 0;
+	m_lastTime = s.getTime();
+	m_numSteps = m_numContactChanges = 0;
+	m_minStep = m_maxStep = 0;
+	m_contactTime = m_freeTime = 0;
+	m_histogram.assign(NumBins, 0);
+	m_stageRealizations = getStageRealizations(_model->getMultibodySystem());
+	m_stepsTaken = m_stepsAttempted = m_stepsRejected = m_realizations = -1;
+	updateContact(s);
+	return 0;
+}
+
+int IntegratorTelemetry::step(const SimTK::State& s, int stepNumber)
+{
+	// event handlers return at the time of the previous step
+	const double stepSize = s.getTime() - m_lastTime;
+	if (!(stepSize > 0))
+		return 0;
+	m_lastTime = s.getTime();
+
+	m_numSteps++;
+	m_minStep = m_numSteps == 1 ? stepSize : std::min(m_minStep, stepSize);
+	m_maxStep = m_numSteps == 1 ? stepSize : std::max(m_maxStep, stepSize);
+	const int bin = (int)std::floor(BinsPerDecade * std::log10(stepSize / MinBinStepSize));
+	m_histogram[std::max(0, std::min(NumBins - 1, bin))]++;
+
+	// the step is counted in the contact state at its end
+	const bool wasInContact = m_inContact;
+	updateContact(s);
+	if (m_inContact != wasInContact)
+		m_numContactChanges++;
+	(m_inContact ? m_contactTime : m_freeTime) += stepSize;
+	return 0;
+}
+
+int IntegratorTelemetry::end(SimTK::State& s)
+{
+	m_wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+
+	const vector<int> realizations = getStageRealizations(_model->getMultibodySystem());
+	for (unsigned int k=0; k<realizations.size(); k++)
+		m_stageRealizations[k] = realizations[k] - m_stageRealizations[k];
+
+	if (m_integrator)
+	{
+		m_stepsTaken = m_integrator->getNumStepsTaken();
+		m_stepsAttempted = m_integrator->getNumStepsAttempted();
+		m_stepsRejected = m_stepsAttempted - m_stepsTaken;
+		m_realizations = m_integrator->getNumRealizations();
+	}
+	return 0;
+}
+
+void IntegratorTelemetry::print(const string& fileName) const
+{
+	ofstream file(fileName.c_str());
+	file << setprecision(6);
+	file << "wall_time\t" << m_wallTime << endl;
+	file << "steps_recorded\t" << m_numSteps << endl;
+	file << "steps_taken\t" << m_stepsTaken << endl;
+	file << "steps_attempted\t" << m_stepsAttempted << endl;
+	file << "steps_rejected\t" << m_stepsRejected << endl;
+	file << "realizations\t" << m_realizations << endl;
+	file << "min_step_size\t" << m_minStep << endl;
+	file << "max_step_size\t" << m_maxStep << endl;
+	file << "contact_time\t" << m_contactTime << endl;
+	file << "free_time\t" << m_freeTime << endl;
+	file << "contact_changes\t" << m_numContactChanges << endl;
+
+	file << endl << "stage\trealizations" << endl;
+	SimTK::Stage stage = SimTK::Stage::Time;
+	for (unsigned int k=0; k<m_stageRealizations.size(); k++, stage = stage.next())
+		file << stage.getName() << "\t" << m_stageRealizations[k] << endl;
+
+	file << endl << "step_size_from\tstep_size_to\tsteps" << endl;
+	for (int b=0; b<(int)m_histogram.size(); b++)
+		file << (b == 0 ? 0 : MinBinStepSize * std::pow(10.0, (double)b / BinsPerDecade)) << "\t"
+			<< (b == (int)m_histogram.size() - 1 ? SimTK::Infinity : MinBinStepSize * std::pow(10.0, (double)(b + 1) / BinsPerDecade))
+			<< "\t" << m_histogram[b] << endl;
+}
+
+string IntegratorTelemetry::getSummary() const
+{
+	std::ostringstream summary;
+	summary << setprecision(4) << "Integration: " << m_wallTime << " s, " << m_numSteps << " steps";
+	if (m_integrator)
+		summary << " (" << m_stepsRejected << " rejected), " << m_realizations << " realizations";
+	summary << ", step size " << m_minStep << " to " << m_maxStep << ", " << m_contactTime << " s in contact, "
+		<< m_freeTime << " s out of contact";
+	return summary.str();
+}
+
+static std::mutex telemetryFileMutex;
+
+void IntegratorTelemetry::appendToFile(const string& fileName, int sample) const
+{
+	std::lock_guard<std::mutex> lock(telemetryFileMutex);
+	ifstream test(fileName.c_str());
+	const bool exists = test.good();
+	test.close();
+
+	ofstream file(fileName.c_str(), ios::app);
+	if (!exists)
+		file << "sample\twall_time\tsteps\tattempted\trejected\trealizations\tmin_step_size\tmax_step_size"
+			"\tcontact_time\tfree_time" << endl;
+	file << sample << "\t" << setprecision(8) << m_wallTime << "\t" << m_numSteps << "\t" << m_stepsAttempted
+		<< "\t" << m_stepsRejected << "\t" << m_realizations << "\t" << m_minStep << "\t" << m_maxStep << "\t"
+		<< m_contactTime << "\t" << m_freeTime << endl;
+}
+
+struct TelemetryRow
+{
+	int sample;
+	double wallTime;
+	long long steps, attempted, rejected, realizations;
+	double minStep, maxStep, contactTime, freeTime;
+};
+
+static bool isSlower(const TelemetryRow& a, const TelemetryRow& b)
+{
+	return a.wallTime > b.wallTime;
+}
+
+string IntegratorTelemetry::summarizeFile(const string& fileName, int numSlowest)
+{
+	ifstream file(fileName.c_str());
+	string line;
+	getline(file, line);	// labels
+	vector<TelemetryRow> rows;
+	while (getline(file, line))
+	{
+		std::istringstream values(line);
+		TelemetryRow row;
+		if (values >> row.sample >> row.wallTime >> row.steps >> row.attempted >> row.rejected >> row.realizations
+			>> row.minStep >> row.maxStep >> row.contactTime >> row.freeTime)
+			rows.push_back(row);
+	}
+
+	std::ostringstream summary;
+	summary << setprecision(4) << "Integrator telemetry of " << rows.size() << " samples";
+	if (rows.empty())
+		return summary.str();
+
+	double wallTime = 0, contactTime = 0, freeTime = 0, minStep = SimTK::Infinity;
+	long long steps = 0, attempted = 0, rejected = 0, realizations = 0;
+	for (unsigned int r=0; r<rows.size(); r++)
+	{
+		wallTime += rows[r].wallTime;
+		steps += rows[r].steps;
+		// -1 without integrator counters
+		attempted += std::max(0LL, rows[r].attempted);
+		rejected += std::max(0LL, rows[r].rejected);
+		realizations += std::max(0LL, rows[r].realizations);
+		if (rows[r].minStep > 0)
+			minStep = std::min(minStep, rows[r].minStep);
+		contactTime += rows[r].contactTime;
+		freeTime += rows[r].freeTime;
+	}
+	const double n = (double)rows.size();
+	summary << ": mean " << wallTime / n << " s, " << steps / n << " steps, " << rejected / n << " rejected ("
+		<< (attempted > 0 ? 100.0 * rejected / attempted : 0) << "%), " << realizations / n << " realizations, "
+		<< "smallest step " << minStep << ", " << (contactTime + freeTime > 0 ? 100 * contactTime / (contactTime + freeTime) : 0)
+		<< "% of the time in contact";
+
+	std::stable_sort(rows.begin(), rows.end(), isSlower);
+	summary << "\nSlowest samples:";
+	for (int r=0; r<numSlowest && r<(int)rows.size(); r++)
+		summary << "\n\t" << rows[r].sample << ": " << rows[r].wallTime << " s, " << rows[r].steps << " steps, "
+			<< rows[r].rejected << " rejected, " << rows[r].realizations << " realizations, smallest step "
+			<< rows[r].minStep;
+	return summary.str();
+}
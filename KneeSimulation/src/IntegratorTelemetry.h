@@ -0,0 +1,92 @@
+#ifndef INTEGRATORTELEMETRY_H
+#define INTEGRATORTELEMETRY_H
+
+#include <OpenSim/OpenSim.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace OpenSim;
+
+/*
+*	Telemetry of one integration, recorded at every step the analyses see
+*	(every accepted step of the Manager):
+*	- histogram of the step sizes, 4 logarithmic bins per decade
+*	- time in and out of contact: any ElasticFoundationForce or
+*	  HuntCrossleyForce with a non zero record value at the end of a step
+*	- realizations of every stage of the system during the run
+*	- steps taken, attempted and rejected and realizations of the
+*	  integrator (setIntegrator), read at the end of the run
+*	- wall time from begin to end
+*	Added to the model like the other analyses (the model owns it); read
+*	its results before Model::removeAnalysis
+*/
+class IntegratorTelemetry : public Analysis
+{
+OpenSim_DECLARE_CONCRETE_OBJECT(IntegratorTelemetry, Analysis);
+public:
+	IntegratorTelemetry(Model* model = nullptr);
+
+	// integrator of the run, its counters are read at the end
+	void setIntegrator(const SimTK::Integrator* integrator) { m_integrator = integrator; }
+
+	int begin(SimTK::State& s);
+	int step(const SimTK::State& s, int stepNumber);
+	int end(SimTK::State& s);
+
+	int getNumSteps() const { return m_numSteps; }
+	// 0 without steps
+	double getMinStepSize() const { return m_minStep; }
+	double getMaxStepSize() const { return m_maxStep; }
+	double getContactTime() const { return m_contactTime; }
+	double getFreeTime() const { return m_freeTime; }
+	double getWallTime() const { return m_wallTime; }
+
+	/*
+	*	Counters, histogram and stage realizations to <fileName>
+	*/
+	void print(const string& fileName) const;
+	string getSummary() const;
+	/*
+	*	Append the counters of the run as the line of <sample> to the
+	*	campaign file <fileName> (labels first), safe from the workers
+	*/
+	void appendToFile(const string& fileName, int sample) const;
+
+	/*
+	*	Totals of a campaign file of appendToFile and its <numSlowest>
+	*	slowest samples
+	*/
+	static string summarizeFile(const string& fileName, int numSlowest = 5);
+
+	static const int BinsPerDecade = 4;
+	static const double MinBinStepSize;	// the first bin takes the smaller steps
+
+private:
+	void updateContact(const SimTK::State& s);
+
+	const SimTK::Integrator* m_integrator;
+	vector<int> m_contactForces;	// indices in the ForceSet
+
+	std::chrono::steady_clock::time_point m_start;
+	double m_wallTime;
+	double m_lastTime;
+	bool m_inContact;
+	int m_numSteps;
+	int m_numContactChanges;
+	double m_minStep;
+	double m_maxStep;
+	double m_contactTime;
+	double m_freeTime;
+	vector<long long> m_histogram;
+	vector<int> m_stageRealizations;	// Time to Acceleration, at begin then over the run
+
+	// of the integrator, -1 without one
+	long long m_stepsTaken;
+	long long m_stepsAttempted;
+	long long m_stepsRejected;
+	long long m_realizations;
+};
+
+#endif
@@ -0,0 +1,301 @@
+#include "KneeKinematicsTable.h"
+#include "ContinuationSweep.h"
+#include "MCEngine.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+const string KneeKinematicsTable::DefaultFileName = "../resources/knee_kinematics_r.sto";
+
+KneeKinematicsTable::KneeKinematicsTable(const vector<double>& angles, const vector<string>& names,
+	const vector<vector<double> >& values)
+	: m_angles(angles), m_names(names), m_values(values), m_spacing(0), m_fileVersion(FileVersion)
+{
+	computeSplines();
+}
+
+KneeKinematicsTable::KneeKinematicsTable(const string& fileName)
+	: m_spacing(0), m_fileVersion(1)
+{
+	Storage storage(fileName);
+	// knee_kinematics_v<version>, knee_kinematics for version 1
+	const string name = storage.getName();
+	const string::size_type v = name.rfind("_v");
+	if (v != string::npos && v + 2 < name.size())
+		m_fileVersion = std::atoi(name.c_str() + v + 2);
+	if (m_fileVersion > FileVersion)
+		throw OpenSim::Exception("KneeKinematicsTable: " + fileName + " is of version "
+			+ std::to_string((long long)m_fileVersion) + ", newer than this code");
+
+	Array<double> angles;
+	storage.getTimeColumn(angles);
+	for (int a=0; a<angles.getSize(); a++)
+		m_angles.push_back(angles[a]);
+
+	const Array<string>& labels = storage.getColumnLabels();
+	for (int c=1; c<labels.getSize(); c++)
+	{
+		Array<double> column;
+		storage.getDataColumn(labels[c], column);
+		m_names.push_back(labels[c]);
+		m_values.push_back(vector<double>(&column[0], &column[0] + column.getSize()));
+	}
+	computeSplines();
+}
+
+void KneeKinematicsTable::computeSplines()
+{
+	const int n = (int)m_angles.size();
+	if (n == 0)
+		throw OpenSim::Exception("KneeKinematicsTable: no angles");
+	for (int a=1; a<n; a++)
+		if (m_angles[a] <= m_angles[a - 1])
+			throw OpenSim::Exception("KneeKinematicsTable: the angles must be increasing");
+	for (unsigned int c=0; c<m_values.size(); c++)
+		if ((int)m_values[c].size() != n)
+			throw OpenSim::Exception("KneeKinematicsTable: " + m_names[c] + " has not a value per angle");
+
+	m_spacing = n > 1 ? m_angles[1] - m_angles[0] : 0;
+	for (int a=2; a<n && m_spacing > 0; a++)
+		if (std::fabs(m_angles[a] - m_angles[a - 1] - m_spacing) > 1.e-9 * m_spacing)
+			m_spacing = 0;
+
+	// natural spline: zero second derivatives at both ends, tridiagonal
+	// system for the inner ones
+	m_secondDerivatives.assign(m_values.size(), vector<double>(n, 0.0));
+	if (n < 3)
+		return;
+	for (unsigned int c=0; c<m_values.size(); c++)
+	{
+		const vector<double>& y = m_values[c];
+		vector<double>& m = m_secondDerivatives[c];
+		vector<double> diagonal(n, 0.0), rhs(n, 0.0);
+		for (int i=1; i<n-1; i++)
+		{
+			const double h0 = m_angles[i] - m_angles[i - 1], h1 = m_angles[i + 1] - m_angles[i];
+			diagonal[i] = 2 * (h0 + h1);
+			rhs[i] = 6 * ((y[i + 1] - y[i]) / h1 - (y[i] - y[i - 1]) / h0);
+			if (i > 1)
+			{
+				// eliminate the lower diagonal (h0)
+				const double factor = h0 / diagonal[i - 1];
+				diagonal[i] -= factor * h0;
+				rhs[i] -= factor * rhs[i - 1];
+			}
+		}
+		for (int i=n-2; i>=1; i--)
+		{
+			const double h1 = m_angles[i + 1] - m_angles[i];
+			m[i] = (rhs[i] - (i < n - 2 ? h1 * m[i + 1] : 0.0)) / diagonal[i];
+		}
+	}
+}
+
+int KneeKinematicsTable::getInterval(double angle) const
+{
+	const int n = (int)m_angles.size();
+	int i;
+	if (m_spacing > 0)
+		i = (int)((angle - m_angles[0]) / m_spacing);
+	else
+		i = (int)(std::upper_bound(m_angles.begin(), m_angles.end(), angle) - m_angles.begin()) - 1;
+	return std::max(0, std::min(i, n - 2));
+}
+
+double KneeKinematicsTable::getValue(int coordinate, double angle) const
+{
+	const vector<double>& y = m_values[coordinate];
+	if (m_angles.size() == 1 || angle <= m_angles.front())
+		return y.front();
+	if (angle >= m_angles.back())
+		return y.back();
+
+	const vector<double>& m = m_secondDerivatives[coordinate];
+	const int i = getInterval(angle);
+	const double h = m_angles[i + 1] - m_angles[i];
+	const double a = (m_angles[i + 1] - angle) / h, b = 1 - a;
+	return a * y[i] + b * y[i + 1] + ((a * a * a - a) * m[i] + (b * b * b - b) * m[i + 1]) * h * h / 6;
+}
+
+double KneeKinematicsTable::getValue(const string& name, double angle) const
+{
+	vector<string>::const_iterator it = std::find(m_names.begin(), m_names.end(), name);
+	if (it == m_names.end())
+		throw OpenSim::Exception("KneeKinematicsTable: no coordinate " + name);
+	return getValue((int)(it - m_names.begin()), angle);
+}
+
+void KneeKinematicsTable::apply(const Model& model, SimTK::State& s, double angle) const
+{
+	for (unsigned int c=0; c<m_names.size(); c++)
+	{
+		const Coordinate& coordinate = model.getCoordinateSet().get(m_names[c]);
+		const bool locked = coordinate.getLocked(s);
+		if (locked)
+			coordinate.setLocked(s, false);
+		coordinate.setValue(s, getValue(c, angle));
+		if (locked)
+			coordinate.setLocked(s, true);
+	}
+}
+
+void KneeKinematicsTable::print(const string& fileName) const
+{
+	Storage storage;
+	storage.setName("knee_kinematics_v" + std::to_string((long long)FileVersion));
+	Array<string> labels;
+	labels.append("time");
+	for (unsigned int c=0; c<m_names.size(); c++)
+		labels.append(m_names[c]);
+	storage.setColumnLabels(labels);
+
+	for (unsigned int a=0; a<m_angles.size(); a++)
+	{
+		vector<double> row;
+		for (unsigned int c=0; c<m_values.size(); c++)
+			row.push_back(m_values[c][a]);
+		storage.append(m_angles[a], (int)row.size(), row.empty() ? 0 : &row[0]);
+	}
+	storage.print(fileName);
+}
+
+const KneeKinematicsTable& KneeKinematicsTable::getDefault(const Model& model)
+{
+	static std::mutex tableMutex;
+	static std::unique_ptr<KneeKinematicsTable> table;
+
+	std::lock_guard<std::mutex> lock(tableMutex);
+	if (!table)
+	{
+		if (ifstream(DefaultFileName.c_str()).good())
+			table.reset(new KneeKinematicsTable(DefaultFileName));
+		if (table && table->getFileVersion() < FileVersion)
+		{
+			cout << "KneeKinematicsTable: " << DefaultFileName << " is of version " << table->getFileVersion()
+				<< ", generate it again; using the tuned poses" << endl;
+			table.reset();
+		}
+		if (!table)
+			table.reset(new KneeKinematicsTable(createTuned(model)));
+	}
+	return *table;
+}
+
+KneeKinematicsTable KneeKinematicsTable::createTuned(const Model& model)
+{
+	const char* names[] = {"knee_angle_r", "knee_adduction_r", "knee_rotation_r",
+		"knee_anterior_posterior_r", "knee_inferior_superior_r", "knee_medial_lateral_r"};
+	const double angles[] = {-120, -100, -90, -80, -60, -40, -30, -20, -15};
+	const double poses[][6] = {
+		{-2.09439510, -0.19163894, 0.02110966, 0.02843407, -0.41174209, -0.00329063},
+		{-1.74533, -0.23053779, 0.00044497, 0.0293309, -0.40140432, -0.00504724},
+		{-1.57079, -0.24, 0.008, 0.0275, -0.396, -0.005},
+		{-1.39626, -0.24427703, 0.01682137, 0.02661332, -0.39351699, -0.00483042},
+		{-1.0472, -0.29941123, -0.00183259, 0.02092232, -0.38597298, -0.00403978},
+		{-0.698132, -0.25397256, 0.03301188, 0.012679, -0.38227168, -0.00403308},
+		{-0.5235987, -0.27474878, 0.01870684, 0.008950625, -0.38234884, -0.00444654},
+		{-0.349066, -0.295525, 0.0044018, 0.00522225, -0.382426, -0.00486},
+		{-0.26179938, -0.279252, -0.03060429, 0.004, -0.384, -0.00391863}};
+
+	// extended knee: the default pose of the model
+	vector<double> tableAngles(angles, angles + 9);
+	tableAngles.push_back(0);
+	vector<vector<double> > values(6);
+	for (int c=0; c<6; c++)
+	{
+		for (int a=0; a<9; a++)
+			values[c].push_back(poses[a][c]);
+		values[c].push_back(model.getCoordinateSet().get(names[c]).getDefaultValue());
+	}
+	return KneeKinematicsTable(tableAngles, vector<string>(names, names + 6), values);
+}
+
+KneeKinematicsTable KneeKinematicsTable::generate(const Model& model, double minAngle, double maxAngle,
+	double increment, int numWorkers)
+{
+	if (increment <= 0 || maxAngle <= minAngle)
+		throw OpenSim::Exception("KneeKinematicsTable: empty range of angles");
+
+	// evenly spaced, both ends included
+	const int numIntervals = (int)std::ceil((maxAngle - minAngle) / increment - 1.e-9);
+	vector<double> angles;
+	for (int a=0; a<=numIntervals; a++)
+		angles.push_back(minAngle + a * (maxAngle - minAngle) / numIntervals);
+
+	vector<string> names(1, "knee_angle_r");
+	const CoordinateSet& knee = model.getJointSet().get("knee_r").getCoordinateSet();
+	for (int c=0; c<knee.getSize(); c++)
+		if (knee.get(c).getName() != names[0])
+			names.push_back(knee.get(c).getName());
+
+	const KneeKinematicsTable& seed = getDefault(model);
+
+	MCEngine engine(model, numWorkers);
+	engine.setWorkerSetup([](Model& model)
+	{
+		SimTK::State& s = model.initSystem();
+		model.updGravityForce().setGravityVector(s, SimTK::Vec3(0));
+		if (model.getForceSet().contains("prescribedForce"))
+			model.updForceSet().get("prescribedForce").setDisabled(s, true);
+	});
+
+	// contiguous blocks of angles, a few per worker to balance them
+	const int numBlocks = std::min((int)angles.size(), 2 * engine.getNumWorkers());
+	vector<vector<double> > blocks(numBlocks);
+	for (unsigned int a=0; a<angles.size(); a++)
+		blocks[a * numBlocks / angles.size()].push_back(angles[a]);
+	vector<int> samples;
+	for (int b=0; b<numBlocks; b++)
+		samples.push_back(b);
+
+	vector<vector<double> > values(names.size(), vector<double>(angles.size(), SimTK::NaN));
+	std::mutex valuesMutex;
+
+	engine.run(samples, [&](Model& model, SimTK::State& s, int b)
+	{
+		const vector<double>& blockAngles = blocks[b];
+		const Coordinate& kneeAngle = model.getCoordinateSet().get(names[0]);
+
+		seed.apply(model, s, blockAngles.front());
+		kneeAngle.setLocked(s, true);
+		for (unsigned int c=1; c<names.size(); c++)
+			model.getCoordinateSet().get(names[c]).setLocked(s, false);
+		model.equilibrateMuscles(s);
+
+		ContinuationSweep sweep(model);
+		for (unsigned int c=1; c<names.size(); c++)
+			sweep.updSolver().addCoordinate(names[c]);
+
+		int first = 0;
+		while (angles[first] != blockAngles.front())
+			first++;
+		int next = first;
+		sweep.run(s, blockAngles, [&](SimTK::State& s, double angle)
+		{
+			kneeAngle.setLocked(s, false);
+			kneeAngle.setValue(s, angle * SimTK::Pi / 180, false);
+			kneeAngle.setLocked(s, true);
+		},
+			[&](SimTK::State& s, double angle, const QuasiStaticResult& equilibrium)
+		{
+			std::lock_guard<std::mutex> lock(valuesMutex);
+			values[0][next] = angle * SimTK::Pi / 180;
+			for (unsigned int c=1; c<names.size(); c++)
+				values[c][next] = equilibrium.values[c - 1];
+			next++;
+		});
+
+		mcLog("Knee kinematics from " + std::to_string((long double)blockAngles.front()) + " to "
+			+ std::to_string((long double)blockAngles.back()) + " degrees: "
+			+ std::to_string((long long)sweep.getNumSolves()) + " solves");
+	});
+
+	if (!engine.getFailedSamples().empty())
+		throw OpenSim::Exception("KneeKinematicsTable: " + std::to_string((long long)engine.getFailedSamples().size())
+			+ " blocks of angles without equilibrium");
+
+	return KneeKinematicsTable(angles, names, values);
+}
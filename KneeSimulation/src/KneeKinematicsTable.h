@@ -0,0 +1,89 @@
+#ifndef KNEEKINEMATICSTABLE_H
+#define KNEEKINEMATICSTABLE_H
+
+#include <OpenSim/OpenSim.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace OpenSim;
+
+/*
+*	Knee coordinates as functions of the knee angle (degrees): a natural
+*	cubic spline per coordinate through the rows of the table, constant
+*	beyond the first and last angles. On evenly spaced angles (generated
+*	tables) the interval is found in constant time.
+*	Stored as a .sto file whose time column is the knee angle
+*/
+class KneeKinematicsTable
+{
+public:
+	KneeKinematicsTable() : m_spacing(0), m_fileVersion(FileVersion) {}
+	/*
+	*	<values>[c][a]: coordinate <names>[c] at <angles>[a] (increasing)
+	*/
+	KneeKinematicsTable(const vector<double>& angles, const vector<string>& names, const vector<vector<double> >& values);
+	/*
+	*	Read a table printed by print(), of any version
+	*/
+	KneeKinematicsTable(const string& fileName);
+
+	void print(const string& fileName) const;
+
+	bool isEmpty() const { return m_angles.empty(); }
+	double getMinAngle() const { return m_angles.front(); }
+	double getMaxAngle() const { return m_angles.back(); }
+	const vector<double>& getAngles() const { return m_angles; }
+	const vector<string>& getCoordinateNames() const { return m_names; }
+	// FileVersion of the file the table was read from, FileVersion if not read
+	int getFileVersion() const { return m_fileVersion; }
+
+	double getValue(int coordinate, double angle) const;
+	double getValue(const string& name, double angle) const;
+
+	/*
+	*	Set the coordinates of the table to their value at <angle> in <s>
+	*	(locked coordinates are moved and locked again)
+	*/
+	void apply(const Model& model, SimTK::State& s, double angle) const;
+
+	/*
+	*	Passive knee kinematics of the right knee: DefaultFileName if it
+	*	exists and is of the current FileVersion, else the poses tuned by
+	*	hand for ten knee angles (see createTuned). Read once per process
+	*/
+	static const KneeKinematicsTable& getDefault(const Model& model);
+	static KneeKinematicsTable createTuned(const Model& model);
+
+	/*
+	*	Solve the passive equilibrium of the secondary coordinates of knee_r
+	*	(adduction, rotation, translations) from <minAngle> to <maxAngle>
+	*	every <increment> degrees, unloaded and without gravity.
+	*	The range is split in blocks run on <numWorkers> workers (see
+	*	MCEngine), each block a continuation (see ContinuationSweep) from
+	*	the default table at its first angle
+	*/
+	static KneeKinematicsTable generate(const Model& model, double minAngle = -120, double maxAngle = 0,
+		double increment = 1, int numWorkers = 0);
+
+	static const string DefaultFileName;
+	/*
+	*	Version of the printed tables, in the name of the storage. 2 since
+	*	the equilibria of generate are solved on generalized forces (see
+	*	QuasiStaticSolver): the tables of version 1 are not equilibria
+	*/
+	static const int FileVersion = 2;
+
+private:
+	void computeSplines();
+	int getInterval(double angle) const;
+
+	vector<double> m_angles;
+	vector<string> m_names;
+	vector<vector<double> > m_values;
+	vector<vector<double> > m_secondDerivatives;
+	double m_spacing;	// of evenly spaced angles, 0 otherwise
+	int m_fileVersion;
+};
+
+#endif
@@ -0,0 +1,248 @@
+#include "MCCampaign.h"
+#include "MCEngine.h"
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+MCCampaign::MCCampaign(const string& directory, MCSamplerType samplerType, unsigned int seed,
+	int numSamples, const vector<string>& parameterNames)
+	: m_directory(directory), m_samplerType(samplerType), m_seed(seed),
+	m_numSamples(numSamples), m_parameterNames(parameterNames)
+{
+}
+
+string MCCampaign::getManifestFileName() const
+{
+	return m_directory + "manifest.txt";
+}
+
+void MCCampaign::open()
+{
+	ifstream test(getManifestFileName().c_str());
+	const bool exists = test.good();
+	test.close();
+
+	if (exists)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			readManifest();
+		}
+		mcLog("Resuming campaign " + getManifestFileName() + ": "
+			+ std::to_string((long long)getNumDone()) + " of "
+			+ std::to_string((long long)m_numSamples) + " samples done");
+	}
+	else
+	{
+		if (m_seed == 0)
+		{
+			random_device rd;
+			m_seed = rd();
+		}
+		writeHeader();
+	}
+
+	mcLog("Monte Carlo seed: " + std::to_string((unsigned long long)m_seed));
+}
+
+void MCCampaign::readManifest()
+{
+	ifstream file(getManifestFileName().c_str());
+	string line;
+
+	// header
+	string sampler, parameters;
+	unsigned int seed = 0;
+	int numSamples = 0;
+	int version = 1;	// without a version line
+	while (getline(file, line) && line != "endheader")
+	{
+		size_t eq = line.find('=');
+		if (eq == string::npos)
+			continue;
+		string key = line.substr(0, eq);
+		string value = line.substr(eq + 1);
+		if (key == "version")
+			version = std::stoi(value);
+		else if (key == "sampler")
+			sampler = value;
+		else if (key == "seed")
+			seed = (unsigned int)std::stoul(value);
+		else if (key == "samples")
+			numSamples = std::stoi(value);
+		else if (key == "parameters")
+			parameters = value;
+	}
+
+	string expectedParameters;
+	for (unsigned int p=0; p<m_parameterNames.size(); p++)
+		expectedParameters += (p ? "," : "") + m_parameterNames[p];
+
+	if (sampler != MCSampler::getTypeName(m_samplerType) || numSamples != m_numSamples
+		|| parameters != expectedParameters)
+		throw OpenSim::Exception("MCCampaign: " + getManifestFileName()
+			+ " describes a different campaign");
+	if (m_seed != 0 && m_seed != seed)
+		throw OpenSim::Exception("MCCampaign: " + getManifestFileName()
+			+ " was started with seed " + std::to_string((unsigned long long)seed));
+	m_seed = seed;
+
+	if (version > ManifestVersion)
+		throw OpenSim::Exception("MCCampaign: " + getManifestFileName() + " has the newer version "
+			+ std::to_string((long long)version));
+
+	// column labels, then one record per line; version 1 has a per-sample
+	// seed column that could not reproduce the sample, dropped
+	getline(file, line);
+	vector<string> records;
+	while (getline(file, line))
+	{
+		if (version == 1)
+		{
+			size_t first = line.find('\t');
+			size_t second = first == string::npos ? string::npos : line.find('\t', first + 1);
+			if (second == string::npos)
+				continue;
+			line.erase(first, second - first);
+		}
+		istringstream record(line);
+		int sample;
+		string status;
+		if (record >> sample >> status)
+		{
+			m_status[sample] = getStatusFromName(status);
+			records.push_back(line);
+		}
+	}
+	file.close();
+
+	if (version < ManifestVersion)
+	{
+		writeHeader();
+		ofstream upgraded(getManifestFileName().c_str(), ios::app);
+		for (unsigned int r=0; r<records.size(); r++)
+			upgraded << records[r] << endl;
+	}
+}
+
+unsigned int MCCampaign::readSeed(const string& directory)
+{
+	ifstream file((directory + "manifest.txt").c_str());
+	string line;
+	while (getline(file, line) && line != "endheader")
+		if (line.compare(0, 5, "seed=") == 0)
+			return (unsigned int)std::stoul(line.substr(5));
+	return 0;
+}
+
+void MCCampaign::writeHeader() const
+{
+	ofstream file(getManifestFileName().c_str());
+
+	file << "Monte Carlo campaign manifest" << endl;
+	file << "version=" << ManifestVersion << endl;
+	file << "sampler=" << MCSampler::getTypeName(m_samplerType) << endl;
+	file << "seed=" << m_seed << endl;
+	file << "samples=" << m_numSamples << endl;
+	file << "parameters=";
+	for (unsigned int p=0; p<m_parameterNames.size(); p++)
+		file << (p ? "," : "") << m_parameterNames[p];
+	file << endl;
+	file << "endheader" << endl;
+
+	file << "sample\tstatus";
+	for (unsigned int p=0; p<m_parameterNames.size(); p++)
+		file << "\t" << m_parameterNames[p];
+	file << endl;
+}
+
+void MCCampaign::append(int sample, MCSampleStatus status, const vector<double>& parameters)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// one flushed line per event, a crash loses at most the running samples
+	ofstream file(getManifestFileName().c_str(), ios::app);
+	file << sample << "\t" << getStatusName(status);
+	file << std::setprecision(17);
+	for (unsigned int p=0; p<parameters.size(); p++)
+		file << "\t" << parameters[p];
+	file << endl;
+
+	m_status[sample] = status;
+}
+
+void MCCampaign::markStarted(int sample, const vector<double>& parameters)
+{
+	append(sample, MCSampleStarted, parameters);
+}
+
+void MCCampaign::markDone(int sample, const vector<double>& parameters)
+{
+	append(sample, MCSampleDone, parameters);
+}
+
+void MCCampaign::markFailed(int sample, const vector<double>& parameters)
+{
+	append(sample, MCSampleFailed, parameters);
+}
+
+void MCCampaign::attach(MCEngine& engine, const std::function<vector<double>(int sample)>& getParameters)
+{
+	engine.setSampleStatusObserver([this, getParameters](int sample, MCSampleStatus status)
+	{
+		if (status != MCSamplePending)
+			append(sample, status, getParameters(sample));
+	});
+}
+
+MCSampleStatus MCCampaign::getStatus(int sample) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	map<int, MCSampleStatus>::const_iterator it = m_status.find(sample);
+	return it == m_status.end() ? MCSamplePending : it->second;
+}
+
+int MCCampaign::getNumDone() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	int done = 0;
+	for (map<int, MCSampleStatus>::const_iterator it = m_status.begin(); it != m_status.end(); ++it)
+		if (it->second == MCSampleDone)
+			done++;
+	return done;
+}
+
+vector<int> MCCampaign::getPendingSamples() const
+{
+	vector<int> pending;
+	for (int i=0; i<m_numSamples; i++)
+		if (getStatus(i) != MCSampleDone)
+			pending.push_back(i);
+	return pending;
+}
+
+string MCCampaign::getStatusName(MCSampleStatus status)
+{
+	switch (status)
+	{
+	case MCSampleStarted:
+		return "started";
+	case MCSampleDone:
+		return "done";
+	case MCSampleFailed:
+		return "failed";
+	default:
+		return "pending";
+	}
+}
+
+MCSampleStatus MCCampaign::getStatusFromName(const string& name)
+{
+	if (name == "started")
+		return MCSampleStarted;
+	else if (name == "done")
+		return MCSampleDone;
+	else if (name == "failed")
+		return MCSampleFailed;
+	return MCSamplePending;
+}
@@ -0,0 +1,90 @@
+#ifndef MCCAMPAIGN_H
+#define MCCAMPAIGN_H
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "MCEngine.h"
+#include "MCSampler.h"
+
+using namespace std;
+
+/*
+*	Manifest of a Monte Carlo campaign, kept in <directory>/manifest.txt.
+*
+*	The header records the manifest version, sampler, seed, number of
+*	samples and parameter names; then one line is appended every time a
+*	sample starts, completes or fails, with its parameter values. A sample
+*	is reproduced from the campaign seed and its index, the engine of
+*	getSampleRandomEngine(seed, sample). The last line of
+*	a sample gives its status, so a crashed campaign is resumed by opening
+*	the same manifest again: finished samples are skipped, interrupted ones
+*	are run again with the same parameters
+*/
+class MCCampaign
+{
+public:
+	MCCampaign(const string& directory, MCSamplerType samplerType, unsigned int seed,
+		int numSamples, const vector<string>& parameterNames);
+
+	/*
+	*	Create the manifest, or load it if it exists. An existing manifest
+	*	must describe the same campaign; its seed is used when resuming
+	*	with seed 0. A new campaign with seed 0 gets a random seed
+	*/
+	void open();
+
+	const string& getDirectory() const { return m_directory; }
+	string getManifestFileName() const;
+	unsigned int getSeed() const { return m_seed; }
+	int getNumSamples() const { return m_numSamples; }
+
+	MCSampleStatus getStatus(int sample) const;
+	int getNumDone() const;
+	// samples that are not done yet, in index order
+	vector<int> getPendingSamples() const;
+
+	/*
+	*	Format of the manifests written; older ones are rewritten in it
+	*	when resumed
+	*/
+	static const int ManifestVersion = 2;
+
+	/*
+	*	Seed of the campaign in <directory>, 0 if it has no manifest
+	*/
+	static unsigned int readSeed(const string& directory);
+
+	void markStarted(int sample, const vector<double>& parameters);
+	void markDone(int sample, const vector<double>& parameters);
+	void markFailed(int sample, const vector<double>& parameters);
+
+	/*
+	*	Mark the samples of <engine> as they start, complete or fail, with
+	*	the parameters of <getParameters>. The engine reports them from its
+	*	worker threads, or from the calling process only for worker
+	*	processes, so the manifest has a single writer
+	*/
+	void attach(MCEngine& engine, const std::function<vector<double>(int sample)>& getParameters);
+
+private:
+	void readManifest();
+	void writeHeader() const;
+	void append(int sample, MCSampleStatus status, const vector<double>& parameters);
+
+	static string getStatusName(MCSampleStatus status);
+	static MCSampleStatus getStatusFromName(const string& name);
+
+	string m_directory;
+	MCSamplerType m_samplerType;
+	unsigned int m_seed;
+	int m_numSamples;
+	vector<string> m_parameterNames;
+
+	map<int, MCSampleStatus> m_status;
+	mutable std::mutex m_mutex;
+};
+
+#endif
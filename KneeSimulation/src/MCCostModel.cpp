@@ -0,0 +1,144 @@
+#include "MCCostModel.h"
+#include "MCStatistics.h"
+#include <cmath>
+#include <fstream>
+
+MCCostModel::MCCostModel(int numDimensions)
+	: m_numDimensions(numDimensions), m_fitted(false)
+{
+}
+
+void MCCostModel::getFeatures(const vector<double>& u, vector<double>& features) const
+{
+	features.assign(1, 1.0);
+	for (int k=0; k<m_numDimensions && k<(int)u.size(); k++)
+	{
+		features.push_back(u[k]);
+		features.push_back(u[k] * u[k]);
+	}
+	features.resize(1 + 2 * m_numDimensions, 0.0);
+}
+
+void MCCostModel::add(const vector<double>& u, double seconds)
+{
+	if (!(seconds > 0))
+		return;
+
+	vector<double> features;
+	getFeatures(u, features);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_features.push_back(features);
+	m_logTimes.push_back(std::log(seconds));
+	m_fitted = false;
+}
+
+int MCCostModel::getNumObservations() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return (int)m_logTimes.size();
+}
+
+void MCCostModel::fit() const
+{
+	const int p = 1 + 2 * m_numDimensions;
+	const int n = (int)m_logTimes.size();
+	m_coefficients.assign(p, 0.0);
+	m_fitted = true;
+	if (n == 0)
+		return;
+
+	// mean only, until the fit is determined
+	if (n <= p)
+	{
+		for (int i=0; i<n; i++)
+			m_coefficients[0] += m_logTimes[i] / n;
+		return;
+	}
+
+	// normal equations with a small ridge term, solved by Cholesky
+	vector<vector<double> > a(p, vector<double>(p, 0.0));
+	vector<double> b(p, 0.0);
+	for (int i=0; i<n; i++)
+		for (int r=0; r<p; r++)
+		{
+			b[r] += m_features[i][r] * m_logTimes[i];
+			for (int c=0; c<p; c++)
+				a[r][c] += m_features[i][r] * m_features[i][c];
+		}
+	for (int r=0; r<p; r++)
+		a[r][r] += 1.e-6 * n;
+
+	for (int c=0; c<p; c++)
+	{
+		for (int k=0; k<c; k++)
+			a[c][c] -= a[c][k] * a[c][k];
+		a[c][c] = std::sqrt(std::max(a[c][c], 1.e-12));
+		for (int r=c+1; r<p; r++)
+		{
+			for (int k=0; k<c; k++)
+				a[r][c] -= a[r][k] * a[c][k];
+			a[r][c] /= a[c][c];
+		}
+	}
+	for (int r=0; r<p; r++)
+	{
+		for (int k=0; k<r; k++)
+			b[r] -= a[r][k] * b[k];
+		b[r] /= a[r][r];
+	}
+	for (int r=p-1; r>=0; r--)
+	{
+		for (int k=r+1; k<p; k++)
+			b[r] -= a[k][r] * b[k];
+		b[r] /= a[r][r];
+	}
+	m_coefficients = b;
+}
+
+double MCCostModel::predict(const vector<double>& u) const
+{
+	vector<double> features;
+	getFeatures(u, features);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_logTimes.empty())
+		return 1.0;
+	if (!m_fitted)
+		fit();
+
+	double logTime = 0;
+	for (unsigned int f=0; f<features.size(); f++)
+		logTime += m_coefficients[f] * features[f];
+	return std::exp(logTime);
+}
+
+void MCCostModel::addCampaign(const string& outputsFile, const MCSampler& sampler)
+{
+	if (!ifstream(outputsFile.c_str()).good())
+		return;
+
+	map<int, double> times = MCStatistics::readOutputs(outputsFile, "run_time");
+	vector<double> u;
+	for (map<int, double>::const_iterator it = times.begin(); it != times.end(); ++it)
+	{
+		sampler.getSample(it->first, u);
+		add(u, it->second);
+	}
+}
+
+void MCCostModel::attach(MCEngine& engine, const MCSampler& sampler)
+{
+	engine.setSampleCost([this, &sampler](int sample)
+	{
+		vector<double> u;
+		sampler.getSample(sample, u);
+		return predict(u);
+	});
+	engine.setSampleObserver([this, &sampler](int sample, double seconds)
+	{
+		vector<double> u;
+		sampler.getSample(sample, u);
+		add(u, seconds);
+	});
+}
@@ -0,0 +1,60 @@
+#ifndef MCCOSTMODEL_H
+#define MCCOSTMODEL_H
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include "MCEngine.h"
+#include "MCSampler.h"
+
+using namespace std;
+
+/*
+*	Learned run time of the samples of a campaign: least squares fit of
+*	log(run time) on the point of the sample in the unit hypercube (linear
+*	and quadratic terms per dimension). Samples bringing stiff contact into
+*	play (short ligaments, stiff cartilage) take several times longer than
+*	the others; ordering the campaign by this estimate keeps the workers
+*	busy until the end (see MCSampleQueue)
+*/
+class MCCostModel
+{
+public:
+	MCCostModel(int numDimensions);
+
+	void add(const vector<double>& u, double seconds);
+	/*
+	*	Expected run time (seconds) at <u>: the mean of the observations
+	*	until there are enough of them for the fit, 1 without any
+	*/
+	double predict(const vector<double>& u) const;
+	int getNumObservations() const;
+
+	/*
+	*	Add the run times of the finished samples of a campaign, the
+	*	run_time column of its outputs file (see MCStatistics), the
+	*	points are regenerated by <sampler>. Nothing is added if the file
+	*	does not exist yet
+	*/
+	void addCampaign(const string& outputsFile, const MCSampler& sampler);
+
+	/*
+	*	Order the samples of <engine> by this model and learn from the
+	*	samples it runs. The model and <sampler> must outlive the runs
+	*/
+	void attach(MCEngine& engine, const MCSampler& sampler);
+
+private:
+	void getFeatures(const vector<double>& u, vector<double>& features) const;
+	void fit() const;
+
+	int m_numDimensions;
+	vector<vector<double> > m_features;
+	vector<double> m_logTimes;
+
+	mutable vector<double> m_coefficients;
+	mutable bool m_fitted;
+	mutable std::mutex m_mutex;
+};
+
+#endif
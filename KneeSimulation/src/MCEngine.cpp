@@ -0,0 +1,489 @@
+#include "MCEngine.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <new>
+#include <thread>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+static std::mutex logMutex;
+
+MCSampleQueue::MCSampleQueue(const vector<int>& samples, int numWorkers, const MCSampleCost& cost)
+	: m_cost(cost), m_version(0), m_remaining((int)samples.size())
+{
+	for (int w=0; w<std::max(1, numWorkers); w++)
+		m_deques.push_back(std::unique_ptr<WorkerDeque>(new WorkerDeque()));
+
+	// longest first, dealt round robin so that every worker starts on a long sample
+	vector<int> ordered(samples);
+	if (m_cost)
+	{
+		WorkerDeque all;
+		all.samples.assign(samples.begin(), samples.end());
+		sortByCost(all);
+		ordered.assign(all.samples.begin(), all.samples.end());
+	}
+	for (unsigned int s=0; s<ordered.size(); s++)
+		m_deques[s % m_deques.size()]->samples.push_back(ordered[s]);
+
+	for (unsigned int w=0; w<m_deques.size(); w++)
+		m_deques[w]->version = 0;
+}
+
+void MCSampleQueue::sortByCost(WorkerDeque& samples)
+{
+	vector<pair<double, int> > costs;
+	for (unsigned int s=0; s<samples.samples.size(); s++)
+		costs.push_back(make_pair(-m_cost(samples.samples[s]), samples.samples[s]));
+	std::stable_sort(costs.begin(), costs.end(),
+		[](const pair<double, int>& a, const pair<double, int>& b) { return a.first < b.first; });
+
+	for (unsigned int s=0; s<costs.size(); s++)
+		samples.samples[s] = costs[s].second;
+	samples.version = m_version;
+}
+
+bool MCSampleQueue::popFront(WorkerDeque& samples, int& sample)
+{
+	std::lock_guard<std::mutex> lock(samples.mutex);
+	if (samples.samples.empty())
+		return false;
+
+	if (m_cost && samples.version != m_version)
+		sortByCost(samples);
+
+	sample = samples.samples.front();
+	samples.samples.pop_front();
+	m_remaining--;
+	return true;
+}
+
+bool MCSampleQueue::pop(int worker, int& sample)
+{
+	if (popFront(*m_deques[worker % m_deques.size()], sample))
+		return true;
+
+	// steal the longest sample of the fullest deque (samples last minutes,
+	// keeping the longest-first order matters more than contention)
+	while (m_remaining > 0)
+	{
+		int victim = -1;
+		size_t size = 0;
+		for (unsigned int w=0; w<m_deques.size(); w++)
+		{
+			std::lock_guard<std::mutex> lock(m_deques[w]->mutex);
+			if (m_deques[w]->samples.size() > size)
+			{
+				size = m_deques[w]->samples.size();
+				victim = w;
+			}
+		}
+		if (victim < 0)
+			return false;
+		if (popFront(*m_deques[victim], sample))
+			return true;
+	}
+	return false;
+}
+
+MCEngine::MCEngine(const Model& model, int numWorkers)
+	: m_numWorkers(numWorkers), m_processes(false), m_stopped(false)
+{
+	if (m_numWorkers <= 0)
+		m_numWorkers = getDefaultNumWorkers();
+
+	// copy the model here, in the calling thread, so that workers never
+	// touch the original model; worker copies are made when first needed
+	m_model = model.clone();
+	m_models.assign(m_numWorkers, nullptr);
+	m_baseStates.resize(m_numWorkers);
+	m_ready.assign(m_numWorkers, 0);
+}
+
+void MCEngine::setWorkerSetup(const MCWorkerSetup& setup)
+{
+	m_setup = setup;
+	m_ready.assign(m_numWorkers, 0);
+}
+
+void MCEngine::setProcessWorkers(bool processes, const MCSynchronize& synchronize)
+{
+#ifdef _WIN32
+	if (processes)
+		mcLog("Worker processes need fork(), running worker threads");
+	processes = false;
+#endif
+	m_processes = processes;
+	m_synchronize = synchronize;
+}
+
+MCEngine::~MCEngine()
+{
+	for (unsigned int w=0; w<m_models.size(); w++)
+		delete m_models[w];
+	delete m_model;
+}
+
+int MCEngine::getDefaultNumWorkers()
+{
+	int n = (int)std::thread::hardware_concurrency();
+	return n > 0 ? n : 1;
+}
+
+void MCEngine::run(const vector<int>& samples, const MCSampleTask& task)
+{
+	m_failed.clear();
+	m_stopped = false;
+
+	mcLog("Running " + std::to_string((long long)samples.size()) + " samples on "
+		+ std::to_string((long long)m_numWorkers) + (m_processes ? " worker processes" : " workers"));
+
+	// copies of the campaign model, in the calling thread
+	for (int w=0; w<(m_processes ? 1 : m_numWorkers); w++)
+		if (!m_models[w])
+			m_models[w] = m_model->clone();
+
+	if (m_processes)
+	{
+		runProcesses(samples, task);
+		return;
+	}
+
+	MCSampleQueue queue(samples, m_numWorkers, getQueueCost());
+
+	// a single worker runs in the calling thread
+	if (m_numWorkers == 1)
+	{
+		work(0, queue, task);
+		return;
+	}
+
+	vector<std::thread> workers;
+	for (int w=0; w<m_numWorkers; w++)
+		workers.push_back(std::thread(&MCEngine::work, this, w, std::ref(queue), std::cref(task)));
+
+	for (unsigned int w=0; w<workers.size(); w++)
+		workers[w].join();
+}
+
+bool MCEngine::setupWorker(int worker)
+{
+	// the system is built once per worker, samples only reset the state
+	if (m_ready[worker])
+		return true;
+
+	Model& model = *m_models[worker];
+	try
+	{
+		ProfileScope setup("worker_setup");
+		if (m_setup)
+			m_setup(model);
+		else
+			model.initSystem();
+	}
+	catch (const std::exception& ex)
+	{
+		mcLog("Setup of worker " + std::to_string((long long)worker) + " failed: " + ex.what());
+		return false;
+	}
+	m_baseStates[worker] = model.getWorkingState();
+	m_ready[worker] = 1;
+	return true;
+}
+
+bool MCEngine::runSample(int worker, const MCSampleTask& task, int sample, double& seconds)
+{
+	string error;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	try
+	{
+		ProfileScope scope("sample");
+		SimTK::State state(m_baseStates[worker]);
+		task(*m_models[worker], state, sample);
+	}
+	catch (const OpenSim::Exception& ex)
+	{
+		error = ex.getMessage();
+	}
+	catch (const SimTK::Exception::Base& ex)
+	{
+		error = ex.getMessage();
+	}
+	catch (const std::exception& ex)
+	{
+		error = ex.what();
+	}
+
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (error.empty())
+		return true;
+
+	mcLog("Sample " + std::to_string((long long)sample) + " failed on worker "
+		+ std::to_string((long long)worker) + ": " + error);
+
+	std::lock_guard<std::mutex> lock(m_failedMutex);
+	m_failed.push_back(sample);
+	return false;
+}
+
+void MCEngine::work(int worker, MCSampleQueue& queue, const MCSampleTask& task)
+{
+	if (!setupWorker(worker))
+		return;
+
+	int sample;
+	while (!shouldStop(queue) && queue.pop(worker, sample))
+	{
+		notifyStatus(sample, MCSampleStarted);
+		double seconds;
+		const bool done = runSample(worker, task, sample, seconds);
+		if (done && m_observer)
+		{
+			m_observer(sample, seconds);
+			queue.updateCosts();
+		}
+		notifyStatus(sample, done ? MCSampleDone : MCSampleFailed);
+	}
+}
+
+void MCEngine::notifyStatus(int sample, MCSampleStatus status)
+{
+	if (m_statusObserver)
+		m_statusObserver(sample, status);
+}
+
+#ifndef _WIN32
+/*
+*	Queue shared by the worker processes, in an anonymous shared mapping:
+*	the run time of each sample, the samples in execution order, then the
+*	status (MCSampleStatus) of each of them. A worker writes the run time
+*	before the final status
+*/
+struct alignas(double) MCSharedQueue
+{
+	std::atomic<int> next;
+	std::atomic<int> stop;
+	int numSamples;
+
+	double* getRunTimes() { return reinterpret_cast<double*>(this + 1); }
+	int* getSamples() { return reinterpret_cast<int*>(getRunTimes() + numSamples); }
+	int* getStatus() { return getSamples() + numSamples; }
+
+	static size_t getSize(int numSamples)
+	{
+		return sizeof(MCSharedQueue) + numSamples * (sizeof(double) + 2 * sizeof(int));
+	}
+};
+
+void MCEngine::runProcesses(const vector<int>& samples, const MCSampleTask& task)
+{
+	// the system is built once, in this process, and shared copy-on-write
+	if (!setupWorker(0))
+		return;
+
+	const int numSamples = (int)samples.size();
+	const size_t size = MCSharedQueue::getSize(numSamples);
+	void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED)
+		throw OpenSim::Exception("MCEngine: cannot map the shared sample queue");
+
+	MCSharedQueue* shared = new (memory) MCSharedQueue;
+	shared->next = 0;
+	shared->stop = 0;
+	shared->numSamples = numSamples;
+
+	// execution order of the cost estimate, longest first (see getQueueCost)
+	MCSampleQueue queue(samples, 1, getQueueCost());
+	for (int s=0; s<numSamples; s++)
+	{
+		queue.pop(0, shared->getSamples()[s]);
+		shared->getRunTimes()[s] = 0;
+		shared->getStatus()[s] = MCSamplePending;
+	}
+
+	// status read back so far, the observers run here
+	vector<int> reported(numSamples, MCSamplePending);
+	auto reportSamples = [&]()
+	{
+		std::atomic_thread_fence(std::memory_order_acquire);
+		for (int s=0; s<numSamples; s++)
+		{
+			const int status = shared->getStatus()[s];
+			if (status == reported[s])
+				continue;
+			const int sample = shared->getSamples()[s];
+			if (reported[s] == MCSamplePending)
+				notifyStatus(sample, MCSampleStarted);
+			if (status == MCSampleDone && m_observer)
+				m_observer(sample, shared->getRunTimes()[s]);
+			if (status != MCSampleStarted)
+				notifyStatus(sample, (MCSampleStatus)status);
+			reported[s] = status;
+		}
+	};
+
+	std::cout.flush();
+	// Profiler timings of each worker process, read back when it ends
+	map<pid_t, FILE*> profiles;
+	for (int w=0; w<m_numWorkers; w++)
+	{
+		FILE* profile = tmpfile();
+		pid_t pid = fork();
+		if (pid < 0)
+		{
+			mcLog("fork() failed, " + std::to_string((long long)w) + " worker processes");
+			if (profile)
+				fclose(profile);
+			break;
+		}
+		if (pid == 0)
+		{
+			// worker process: samples until the queue is empty or the campaign stops
+			Profiler::reset();
+			int slot, code = 0;
+			try
+			{
+				while (!shared->stop && (slot = shared->next++) < numSamples)
+				{
+					shared->getStatus()[slot] = MCSampleStarted;
+					double seconds;
+					const bool done = runSample(0, task, shared->getSamples()[slot], seconds);
+					shared->getRunTimes()[slot] = seconds;
+					std::atomic_thread_fence(std::memory_order_release);
+					shared->getStatus()[slot] = done ? MCSampleDone : MCSampleFailed;
+				}
+			}
+			catch (...)
+			{
+				code = 1;
+			}
+			if (profile)
+			{
+				const string timings = Profiler::serialize();
+				fwrite(timings.data(), 1, timings.size(), profile);
+				fflush(profile);
+			}
+			// never return into the caller's code
+			std::cout.flush();
+			_exit(code);
+		}
+		profiles[pid] = profile;
+	}
+
+	// the stop criterion is checked here, on the results read back from the workers
+	int running = (int)profiles.size();
+	while (running > 0)
+	{
+		int status;
+		pid_t pid = waitpid(-1, &status, WNOHANG);
+		if (pid < 0)
+			break;
+		if (pid > 0)
+		{
+			running--;
+			if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+				mcLog("Worker process " + std::to_string((long long)pid) + " ended abnormally");
+			map<pid_t, FILE*>::iterator profile = profiles.find(pid);
+			if (profile != profiles.end() && profile->second)
+			{
+				string timings;
+				char buffer[4096];
+				size_t read;
+				rewind(profile->second);
+				while ((read = fread(buffer, 1, sizeof(buffer), profile->second)) > 0)
+					timings.append(buffer, read);
+				fclose(profile->second);
+				profile->second = nullptr;
+				Profiler::merge(timings);
+			}
+			continue;
+		}
+
+		reportSamples();
+
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+		if (m_stop && !shared->stop)
+		{
+			if (m_synchronize)
+				m_synchronize();
+			if (m_stop())
+			{
+				shared->stop = 1;
+				m_stopped = true;
+				mcLog("Stop criterion met, " + std::to_string((long long)std::max(0, numSamples - shared->next))
+					+ " samples not run");
+			}
+		}
+	}
+
+	reportSamples();
+	for (map<pid_t, FILE*>::iterator profile = profiles.begin(); profile != profiles.end(); ++profile)
+		if (profile->second)
+			fclose(profile->second);
+
+	// started and never finished: the worker process crashed
+	for (int s=0; s<numSamples; s++)
+	{
+		int status = shared->getStatus()[s];
+		if (status == MCSampleStarted)
+			notifyStatus(shared->getSamples()[s], MCSampleFailed);
+		if (status == MCSampleFailed || status == MCSampleStarted)
+			m_failed.push_back(shared->getSamples()[s]);
+	}
+
+	shared->~MCSharedQueue();
+	munmap(memory, size);
+
+	if (m_synchronize)
+		m_synchronize();
+}
+#else
+void MCEngine::runProcesses(const vector<int>& samples, const MCSampleTask& task)
+{
+	MCSampleQueue queue(samples, 1, getQueueCost());
+	work(0, queue, task);
+}
+#endif
+
+MCSampleCost MCEngine::getQueueCost() const
+{
+	// the stop criterion sees the finished samples: ordered by cost, they
+	// would be the cheap region of the parameter space, not a prefix of
+	// the sequence
+	return m_stop ? MCSampleCost() : m_cost;
+}
+
+bool MCEngine::shouldStop(const MCSampleQueue& queue)
+{
+	if (m_stopped)
+		return true;
+	if (!m_stop || !m_stop())
+		return false;
+
+	// log once, whichever worker sees it first
+	if (!m_stopped.exchange(true))
+		mcLog("Stop criterion met, " + std::to_string((long long)queue.getNumRemaining())
+			+ " samples not run");
+	return true;
+}
+
+std::mt19937 getSampleRandomEngine(unsigned int seed, int sample)
+{
+	// seeded from the whole sequence as since the first campaigns, the
+	// campaign seed and the sample index keep reproducing the same samples
+	std::seed_seq seq{seed, (unsigned int)sample};
+	return std::mt19937(seq);
+}
+
+void mcLog(const string& message)
+{
+	std::lock_guard<std::mutex> lock(logMutex);
+	std::cout << message << std::endl;
+}
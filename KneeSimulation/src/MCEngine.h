@@ -0,0 +1,230 @@
+#ifndef MCENGINE_H
+#define MCENGINE_H
+
+#include <OpenSim/OpenSim.h>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace OpenSim;
+
+/*
+*	Called once per worker to build the system of the worker's model and
+*	prepare its working state (pose, loads, disabled muscles, ...).
+*	The working state left by the setup is the base state of every sample
+*/
+typedef std::function<void(Model& model)> MCWorkerSetup;
+
+/*
+*	Task executed by a Monte Carlo worker for sample <sample>.
+*	<model> is the worker's own copy of the campaign model and <state>
+*	a fresh copy of the worker's base state; sample parameters should be
+*	applied to <state> (see CustomLigament state parameters) so that the
+*	system is not rebuilt between samples
+*/
+typedef std::function<void(Model& model, SimTK::State& state, int sample)> MCSampleTask;
+
+/*
+*	Checked by the workers before every sample; when it returns true the
+*	remaining samples are not started (samples already running complete)
+*/
+typedef std::function<bool()> MCStopCriterion;
+
+/*
+*	Expected run time of sample <sample> (any unit), used to start the
+*	expected-long samples first (see MCCostModel)
+*/
+typedef std::function<double(int sample)> MCSampleCost;
+
+/*
+*	Called after sample <sample> ran, with its wall time: by the worker
+*	thread, or by the calling process for worker processes
+*/
+typedef std::function<void(int sample, double seconds)> MCSampleObserver;
+
+/*
+*	Status of a sample in a campaign
+*/
+enum MCSampleStatus
+{
+	MCSamplePending,
+	MCSampleStarted,
+	MCSampleDone,
+	MCSampleFailed
+};
+
+/*
+*	Called when sample <sample> starts, is done or fails (e.g. to keep the
+*	campaign manifest, see MCCampaign::attach): by the worker thread, or
+*	by the calling process for worker processes
+*/
+typedef std::function<void(int sample, MCSampleStatus status)> MCSampleStatusObserver;
+
+/*
+*	Called in the calling process to read back the results written by
+*	worker processes (see MCEngine::setProcessWorkers)
+*/
+typedef std::function<void()> MCSynchronize;
+
+/*
+*	Work stealing queue of sample indices: every worker owns a deque,
+*	takes its own samples first and steals from the fullest deque once
+*	its own is empty. With a cost estimate the deques are ordered by
+*	decreasing expected run time (longest processing time first), so a
+*	campaign does not end on a single long sample; they are re-ordered
+*	when the estimate is updated
+*/
+class MCSampleQueue
+{
+public:
+	MCSampleQueue(const vector<int>& samples, int numWorkers = 1, const MCSampleCost& cost = MCSampleCost());
+
+	// pop the next sample of <worker>, returns false when all the deques are empty
+	bool pop(int worker, int& sample);
+
+	int getNumRemaining() const { return m_remaining; }
+
+	/*
+	*	The cost estimate changed, the deques are re-ordered at their next pop
+	*/
+	void updateCosts() { m_version++; }
+
+private:
+	struct WorkerDeque
+	{
+		deque<int> samples;
+		unsigned int version;
+		std::mutex mutex;
+	};
+
+	void sortByCost(WorkerDeque& samples);
+	bool popFront(WorkerDeque& samples, int& sample);
+
+	vector<std::unique_ptr<WorkerDeque> > m_deques;
+	MCSampleCost m_cost;
+	std::atomic<unsigned int> m_version;
+	std::atomic<int> m_remaining;
+};
+
+/*
+*	Parallel Monte Carlo engine: a pool of workers, each one owning a copy of
+*	the model (and therefore its own State and integrator), pulling sample
+*	indices from a work stealing queue until it is empty
+*/
+class MCEngine
+{
+public:
+	/*
+	*	numWorkers <= 0 uses one worker per hardware thread
+	*/
+	MCEngine(const Model& model, int numWorkers = 0);
+	~MCEngine();
+
+	int getNumWorkers() const { return m_numWorkers; }
+
+	/*
+	*	Set the per worker setup. Without one, workers call initSystem().
+	*	The setup runs once per worker, before its first sample; later
+	*	calls to run() reuse the worker's base state
+	*/
+	void setWorkerSetup(const MCWorkerSetup& setup);
+
+	/*
+	*	Set a criterion to end the campaign before all samples are run
+	*	(e.g. MCStatistics::isConverged). The samples then start in the
+	*	order given, without the sample cost, so that the samples run
+	*	before the stop are the first ones and not the cheapest ones
+	*/
+	void setStopCriterion(const MCStopCriterion& stop) { m_stop = stop; }
+
+	/*
+	*	Start the samples with the longest expected run time first, unless
+	*	a stop criterion is set
+	*/
+	void setSampleCost(const MCSampleCost& cost) { m_cost = cost; }
+	/*
+	*	Observe the run time of every sample (e.g. to learn the sample cost);
+	*	the queue is re-ordered after every observation
+	*/
+	void setSampleObserver(const MCSampleObserver& observer) { m_observer = observer; }
+	/*
+	*	Observe the start and the end of every sample; a sample that fails,
+	*	or whose worker process crashes, ends as failed
+	*/
+	void setSampleStatusObserver(const MCSampleStatusObserver& observer) { m_statusObserver = observer; }
+
+	/*
+	*	Run the workers as processes forked from a single set up model
+	*	(POSIX only, threads elsewhere): the system, meshes and base state
+	*	are built once and shared copy-on-write, only the sample states are
+	*	private, and a crashing sample ends only its own process.
+	*	The task runs in the worker processes, so its results must go to
+	*	files; <synchronize> reads them back in the calling process before
+	*	the stop criterion is checked and when the run ends. The status and
+	*	run time of the samples come back through the shared queue, the
+	*	observers run in the calling process, and the Profiler timings of
+	*	every worker process are merged when it ends
+	*/
+	void setProcessWorkers(bool processes, const MCSynchronize& synchronize = MCSynchronize());
+	bool hasProcessWorkers() const { return m_processes; }
+
+	/*
+	*	Run <task> for every index in <samples> and block until all are done.
+	*	A sample that throws is reported and recorded as failed, the
+	*	campaign continues with the next one
+	*/
+	void run(const vector<int>& samples, const MCSampleTask& task);
+
+	const vector<int>& getFailedSamples() const { return m_failed; }
+	// true if the last run was ended by the stop criterion
+	bool wasStopped() const { return m_stopped; }
+
+	static int getDefaultNumWorkers();
+
+private:
+	bool setupWorker(int worker);
+	// false if the sample failed, <seconds> is its wall time
+	bool runSample(int worker, const MCSampleTask& task, int sample, double& seconds);
+	void notifyStatus(int sample, MCSampleStatus status);
+	void work(int worker, MCSampleQueue& queue, const MCSampleTask& task);
+	void runProcesses(const vector<int>& samples, const MCSampleTask& task);
+	bool shouldStop(const MCSampleQueue& queue);
+	MCSampleCost getQueueCost() const;
+
+	Model* m_model;			// unmodified copy of the campaign model
+	vector<Model*> m_models;	// worker copies
+	vector<SimTK::State> m_baseStates;
+	vector<int> m_ready;	// worker set up
+	int m_numWorkers;
+	MCWorkerSetup m_setup;
+	MCStopCriterion m_stop;
+	MCSampleCost m_cost;
+	MCSampleObserver m_observer;
+	MCSampleStatusObserver m_statusObserver;
+	bool m_processes;
+	MCSynchronize m_synchronize;
+	std::atomic<bool> m_stopped;
+
+	vector<int> m_failed;
+	std::mutex m_failedMutex;
+};
+
+/*
+*	Random engine for sample <sample> of a campaign with seed <seed>.
+*	Each sample owns its engine, so the parameters drawn for a sample
+*	do not depend on the number of workers or on the execution order
+*/
+std::mt19937 getSampleRandomEngine(unsigned int seed, int sample);
+
+/*
+*	Print <message> to the console without interleaving with other workers
+*/
+void mcLog(const string& message);
+
+#endif
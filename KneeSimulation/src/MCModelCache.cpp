@@ -0,0 +1,311 @@
+#include "MCModelCache.h"
+#include "KneeKinematicsTable.h"
+#include "MCEngine.h"
+#include "Profiler.h"
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <sys/stat.h>
+
+// snapshot files: magic, version, then the pose
+static const char PoseMagic[8] = {'M', 'C', 'P', 'O', 'S', 'E', 0, 0};
+static const unsigned int PoseVersion = 1;
+
+struct MCPose
+{
+	unsigned long long hash;	// of the model files it was solved with
+	double time;
+	vector<double> q, u, z;
+	vector<char> locks;	// per coordinate of the coordinate set
+};
+
+static std::mutex cacheMutex;
+static map<string, std::unique_ptr<Model> > models;
+static map<string, unsigned long long> hashes;
+static map<string, MCPose> poses;
+
+static const unsigned long long HashBasis = 14695981039346656037ull;
+
+/*
+*	FNV-1a hash of <text>
+*/
+static unsigned long long hashText(const string& text, unsigned long long hash)
+{
+	for (size_t i=0; i<text.size(); i++)
+	{
+		hash ^= (unsigned char)text[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+/*
+*	FNV-1a hash of the content of <filename> (of its name if it cannot be read)
+*/
+static unsigned long long hashFile(const string& filename, unsigned long long hash)
+{
+	ifstream file(filename.c_str(), ios::binary);
+	const string content = file.good()
+		? string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>()) : filename;
+	return hashText(content, hash);
+}
+
+/*
+*	Modification time and size of <filename>, empty if it does not exist:
+*	a file edited during the run is hashed again
+*/
+static string getFileStamp(const string& filename)
+{
+	struct stat status;
+	if (stat(filename.c_str(), &status) != 0)
+		return "";
+	return std::to_string((long long)status.st_mtime) + ":" + std::to_string((long long)status.st_size);
+}
+
+static string getDirectoryName(const string& filename)
+{
+	size_t slash = filename.find_last_of("/\\");
+	return slash == string::npos ? "./" : filename.substr(0, slash + 1);
+}
+
+/*
+*	Contact mesh files of <model>, named relative to the working directory
+*	or to the model
+*/
+static vector<string> getMeshFiles(const Model& model)
+{
+	vector<string> meshFiles;
+	const ContactGeometrySet& geometries = model.getContactGeometrySet();
+	for (int g=0; g<geometries.getSize(); g++)
+	{
+		const ContactMesh* mesh = dynamic_cast<const ContactMesh*>(&geometries.get(g));
+		if (!mesh)
+			continue;
+		string meshFile = mesh->getFilename();
+		if (!ifstream(meshFile.c_str()).good())
+			meshFile = getDirectoryName(model.getInputFileName()) + meshFile;
+		meshFiles.push_back(meshFile);
+	}
+	return meshFiles;
+}
+
+/*
+*	Names and stamps of the files hashed for a model, one per line: copies
+*	of a model with other meshes (e.g. of a lower fidelity, see
+*	MCFidelity) and edited files are other entries of the cache
+*/
+static string getFileList(const vector<string>& files)
+{
+	string list;
+	for (unsigned int f=0; f<files.size(); f++)
+		list += files[f] + "\t" + getFileStamp(files[f]) + "\n";
+	return list;
+}
+
+/*
+*	FNV-1a hash of the coordinates and knots of <table>, the one the poses
+*	of this process are solved with (an edited file is read by the next
+*	process)
+*/
+static unsigned long long getTableHash(const KneeKinematicsTable& table)
+{
+	std::ostringstream text;
+	text.precision(17);
+	const vector<string>& names = table.getCoordinateNames();
+	const vector<double>& angles = table.getAngles();
+	for (unsigned int c=0; c<names.size(); c++)
+	{
+		text << names[c];
+		for (unsigned int a=0; a<angles.size(); a++)
+			text << "\t" << angles[a] << "\t" << table.getValue(c, angles[a]);
+		text << "\n";
+	}
+	return hashText(text.str(), HashBasis);
+}
+
+const Model& MCModelCache::getModel(const string& modelFile)
+{
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	std::unique_ptr<Model>& model = models[modelFile];
+	if (!model)
+	{
+		mcLog("Loading model " + modelFile);
+		ProfileScope load("model_load");
+		model.reset(new Model(modelFile));
+	}
+	return *model;
+}
+
+unsigned long long MCModelCache::getHash(const Model& model)
+{
+	const string modelFile = model.getInputFileName();
+	if (modelFile.empty())
+		return 0;
+
+	const vector<string> meshFiles = getMeshFiles(model);
+	vector<string> files(1, modelFile);
+	files.insert(files.end(), meshFiles.begin(), meshFiles.end());
+	const string key = getFileList(files);
+	// the table is read once per process, its hash too
+	static const unsigned long long tableHash = getTableHash(KneeKinematicsTable::getDefault(model));
+
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	map<string, unsigned long long>::const_iterator it = hashes.find(key);
+	if (it != hashes.end())
+		return it->second;
+
+	unsigned long long hash = HashBasis;
+	for (unsigned int f=0; f<files.size(); f++)
+		hash = hashFile(files[f], hash);
+	// the poses are solved from the knee kinematics and by the setup code
+	hash = hashText(std::to_string(tableHash), hash);
+	hash = hashText(std::to_string((long long)PoseCodeVersion), hash);
+
+	hashes[key] = hash;
+	return hash;
+}
+
+/*
+*	Snapshot file of pose <name> of <model> with hash <hash>: the models of
+*	a directory and their versions have their own snapshots
+*/
+static string getPoseFileName(const Model& model, unsigned long long hash, const string& name)
+{
+	const string modelFile = model.getInputFileName();
+	const size_t slash = modelFile.find_last_of("/\\");
+	string modelName = modelFile.substr(slash == string::npos ? 0 : slash + 1);
+	modelName = modelName.substr(0, modelName.find_last_of('.'));
+
+	std::ostringstream filename;
+	filename << getDirectoryName(modelFile) << "cache/" << modelName << "_" << name << "_" << std::hex << hash << ".pose";
+	return filename.str();
+}
+
+static bool readPose(const string& filename, unsigned long long hash, MCPose& pose)
+{
+	ifstream file(filename.c_str(), ios::binary);
+	if (!file.good())
+		return false;
+
+	char magic[8];
+	unsigned int version, nq, nu, nz, nc;
+	unsigned long long fileHash;
+	file.read(magic, sizeof(magic));
+	file.read((char*)&version, sizeof(version));
+	file.read((char*)&fileHash, sizeof(fileHash));
+	file.read((char*)&nq, sizeof(nq));
+	file.read((char*)&nu, sizeof(nu));
+	file.read((char*)&nz, sizeof(nz));
+	file.read((char*)&nc, sizeof(nc));
+	if (!file.good() || std::string(magic, 8) != std::string(PoseMagic, 8)
+		|| version != PoseVersion || fileHash != hash)
+		return false;
+
+	pose.hash = fileHash;
+	pose.q.resize(nq);
+	pose.u.resize(nu);
+	pose.z.resize(nz);
+	pose.locks.resize(nc);
+	file.read((char*)&pose.time, sizeof(pose.time));
+	if (nq > 0) file.read((char*)&pose.q[0], nq * sizeof(double));
+	if (nu > 0) file.read((char*)&pose.u[0], nu * sizeof(double));
+	if (nz > 0) file.read((char*)&pose.z[0], nz * sizeof(double));
+	if (nc > 0) file.read(&pose.locks[0], nc);
+	return file.good();
+}
+
+static void writePose(const string& filename, unsigned long long hash, const MCPose& pose)
+{
+	// written aside then renamed, a concurrent reader never sees half a file
+	std::ostringstream tmp;
+	tmp << filename << "." << std::hash<std::thread::id>()(std::this_thread::get_id()) << ".tmp";
+
+	{
+		ofstream file(tmp.str().c_str(), ios::binary);
+		unsigned int nq = (unsigned int)pose.q.size(), nu = (unsigned int)pose.u.size();
+		unsigned int nz = (unsigned int)pose.z.size(), nc = (unsigned int)pose.locks.size();
+		file.write(PoseMagic, sizeof(PoseMagic));
+		file.write((const char*)&PoseVersion, sizeof(PoseVersion));
+		file.write((const char*)&hash, sizeof(hash));
+		file.write((const char*)&nq, sizeof(nq));
+		file.write((const char*)&nu, sizeof(nu));
+		file.write((const char*)&nz, sizeof(nz));
+		file.write((const char*)&nc, sizeof(nc));
+		file.write((const char*)&pose.time, sizeof(pose.time));
+		if (nq > 0) file.write((const char*)&pose.q[0], nq * sizeof(double));
+		if (nu > 0) file.write((const char*)&pose.u[0], nu * sizeof(double));
+		if (nz > 0) file.write((const char*)&pose.z[0], nz * sizeof(double));
+		if (nc > 0) file.write(&pose.locks[0], nc);
+		if (!file.good())
+			return;
+	}
+	std::remove(filename.c_str());
+	std::rename(tmp.str().c_str(), filename.c_str());
+}
+
+bool MCModelCache::loadPose(const Model& model, SimTK::State& state, const string& name)
+{
+	const unsigned long long hash = getHash(model);
+	if (hash == 0)
+		return false;
+
+	const string filename = getPoseFileName(model, hash, name);
+	MCPose pose;
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		map<string, MCPose>::const_iterator it = poses.find(filename);
+		if (it != poses.end() && it->second.hash == hash)
+			pose = it->second;
+		else if (readPose(filename, hash, pose))
+			poses[filename] = pose;
+		else
+			return false;
+	}
+
+	const CoordinateSet& coordinates = model.getCoordinateSet();
+	if ((int)pose.q.size() != state.getNQ() || (int)pose.u.size() != state.getNU()
+		|| (int)pose.z.size() != state.getNZ() || (int)pose.locks.size() != coordinates.getSize())
+		return false;
+
+	state.setTime(pose.time);
+	for (int i=0; i<state.getNQ(); i++)
+		state.updQ()[i] = pose.q[i];
+	for (int i=0; i<state.getNU(); i++)
+		state.updU()[i] = pose.u[i];
+	for (int i=0; i<state.getNZ(); i++)
+		state.updZ()[i] = pose.z[i];
+	for (int c=0; c<coordinates.getSize(); c++)
+		coordinates.get(c).setLocked(state, pose.locks[c] != 0);
+	return true;
+}
+
+void MCModelCache::savePose(const Model& model, const SimTK::State& state, const string& name)
+{
+	const unsigned long long hash = getHash(model);
+	if (hash == 0)
+		return;
+
+	MCPose pose;
+	pose.hash = hash;
+	pose.time = state.getTime();
+	for (int i=0; i<state.getNQ(); i++)
+		pose.q.push_back(state.getQ()[i]);
+	for (int i=0; i<state.getNU(); i++)
+		pose.u.push_back(state.getU()[i]);
+	for (int i=0; i<state.getNZ(); i++)
+		pose.z.push_back(state.getZ()[i]);
+	const CoordinateSet& coordinates = model.getCoordinateSet();
+	for (int c=0; c<coordinates.getSize(); c++)
+		pose.locks.push_back(coordinates.get(c).getLocked(state) ? 1 : 0);
+
+	const string filename = getPoseFileName(model, hash, name);
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	poses[filename] = pose;
+	IO::makeDir(getDirectoryName(filename));
+	writePose(filename, hash, pose);
+}
@@ -0,0 +1,61 @@
+#ifndef MCMODELCACHE_H
+#define MCMODELCACHE_H
+
+#include <OpenSim/OpenSim.h>
+#include <string>
+
+using namespace std;
+using namespace OpenSim;
+
+/*
+*	Cache of the startup work of the campaigns, keyed by a hash of the
+*	.osim file, of its contact meshes, of the knee kinematics table in use
+*	and of the version of the pose code so that changing any of them
+*	invalidates it:
+*	- models parsed once per process, later loads are copies
+*	- poses solved by the experiment setups (assembled knee angle,
+*	  equilibrated muscles, locked coordinates), kept in memory and in
+*	  versioned binary snapshots in <model directory>/cache/ so that the
+*	  workers and the later runs skip solving them
+*	The built Simbody system itself cannot be serialized, initSystem()
+*	still runs once per model copy
+*/
+class MCModelCache
+{
+public:
+	/*
+	*	<modelFile> parsed once per process, copy it to use it
+	*/
+	static const Model& getModel(const string& modelFile);
+
+	/*
+	*	Version of the code solving the cached poses (setKneeAngle, the
+	*	tuned knee kinematics, the experiment setups), to increment with
+	*	every change of the poses it solves
+	*/
+	static const unsigned int PoseCodeVersion = 1;
+
+	/*
+	*	Content hash of the input file of <model>, of its contact meshes
+	*	and of KneeKinematicsTable::getDefault, with PoseCodeVersion; 0 if
+	*	the model was not read from a file. Kept per input file and list
+	*	of mesh files, hashed again once one of them is edited; a copy
+	*	with other meshes has its own
+	*/
+	static unsigned long long getHash(const Model& model);
+
+	/*
+	*	Restore pose <name> of <model> in <state> (coordinates, speeds,
+	*	auxiliary states and coordinate locks). Returns false if there is
+	*	no snapshot of this pose for the current hash of the model. The
+	*	poses of the same name of other models of the directory, or with
+	*	other files, are kept apart
+	*/
+	static bool loadPose(const Model& model, SimTK::State& state, const string& name);
+	/*
+	*	Keep the pose of <state> as pose <name> of <model>
+	*/
+	static void savePose(const Model& model, const SimTK::State& state, const string& name);
+};
+
+#endif
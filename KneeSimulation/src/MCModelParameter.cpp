@@ -0,0 +1,113 @@
+#include "MCModelParameter.h"
+#include "CustomLigament.h"
+
+MCModelParameter::MCModelParameter(const string& aForceName, MCModelParameterType aType, double aLower, double aUpper)
+	: MCParameter(aForceName + "_" + getTypeName(aType), aLower, aUpper), forceName(aForceName), type(aType)
+{
+}
+
+bool MCModelParameter::needsRebuild() const
+{
+	return type == MCContactStiffness || type == MCContactDissipation;
+}
+
+void MCModelParameter::applyToState(const Model& model, SimTK::State& state, double value) const
+{
+	const CustomLigament* ligament = dynamic_cast<const CustomLigament*>(&model.getForceSet().get(forceName));
+	if (!ligament)
+		throw OpenSim::Exception("MCModelParameter: " + forceName + " is not a CustomLigament");
+
+	switch (type)
+	{
+	case MCRestingLength:
+		ligament->setRestingLength(state, value);
+		break;
+	case MCStiffness:
+		ligament->setStiffness(state, value);
+		break;
+	case MCDamping:
+		ligament->setDamping(state, value);
+		break;
+	default:
+		throw OpenSim::Exception("MCModelParameter: " + name + " is not a State parameter");
+	}
+}
+
+void MCModelParameter::applyToModel(Model& model, double value) const
+{
+	ElasticFoundationForce* contact = dynamic_cast<ElasticFoundationForce*>(&model.updForceSet().get(forceName));
+	if (!contact)
+		throw OpenSim::Exception("MCModelParameter: " + forceName + " is not an ElasticFoundationForce");
+
+	switch (type)
+	{
+	case MCContactStiffness:
+		contact->setStiffness(value);
+		break;
+	case MCContactDissipation:
+		contact->setDissipation(value);
+		break;
+	default:
+		throw OpenSim::Exception("MCModelParameter: " + name + " is not a model property");
+	}
+}
+
+MCModelParameterType MCModelParameter::getTypeFromName(const string& name)
+{
+	if (name == "resting_length")
+		return MCRestingLength;
+	else if (name == "stiffness")
+		return MCStiffness;
+	else if (name == "damping")
+		return MCDamping;
+	else if (name == "contact_stiffness")
+		return MCContactStiffness;
+	else if (name == "contact_dissipation")
+		return MCContactDissipation;
+
+	throw OpenSim::Exception("MCModelParameter: unknown parameter type '" + name + "'");
+}
+
+string MCModelParameter::getTypeName(MCModelParameterType type)
+{
+	switch (type)
+	{
+	case MCRestingLength:
+		return "resting_length";
+	case MCStiffness:
+		return "stiffness";
+	case MCDamping:
+		return "damping";
+	case MCContactStiffness:
+		return "contact_stiffness";
+	default:
+		return "contact_dissipation";
+	}
+}
+
+void applyModelParameters(const vector<MCModelParameter>& parameters, const vector<double>& values,
+	Model& model, SimTK::State& state, const MCWorkerSetup& setup)
+{
+	bool rebuild = false;
+	for (unsigned int p=0; p<parameters.size(); p++)
+	{
+		if (parameters[p].needsRebuild())
+		{
+			parameters[p].applyToModel(model, values[p]);
+			rebuild = true;
+		}
+	}
+
+	if (rebuild)
+	{
+		if (setup)
+			setup(model);
+		else
+			model.initSystem();
+		state = model.getWorkingState();
+	}
+
+	for (unsigned int p=0; p<parameters.size(); p++)
+		if (!parameters[p].needsRebuild())
+			parameters[p].applyToState(model, state, values[p]);
+}
@@ -0,0 +1,60 @@
+#ifndef MCMODELPARAMETER_H
+#define MCMODELPARAMETER_H
+
+#include <OpenSim/OpenSim.h>
+#include "MCEngine.h"
+#include "MCSampler.h"
+
+using namespace std;
+using namespace OpenSim;
+
+/*
+*	Model quantities that can be sampled in a Monte Carlo campaign
+*/
+enum MCModelParameterType
+{
+	MCRestingLength,		// CustomLigament resting length (State)
+	MCStiffness,			// CustomLigament stiffness (State)
+	MCDamping,				// CustomLigament damping (State)
+	MCContactStiffness,		// ElasticFoundationForce stiffness (property)
+	MCContactDissipation	// ElasticFoundationForce dissipation (property)
+};
+
+/*
+*	A sampled parameter bound to a force of the model, uniformly
+*	distributed in [lower, upper]. Ligament parameters live in the State
+*	and are applied to each sample's state; contact parameters are
+*	properties, so applying them needs the system to be rebuilt
+*/
+struct MCModelParameter : public MCParameter
+{
+	string forceName;
+	MCModelParameterType type;
+
+	MCModelParameter(const string& aForceName, MCModelParameterType aType, double aLower, double aUpper);
+
+	bool needsRebuild() const;
+
+	/*
+	*	Set <value> in <state> (ligament parameters)
+	*/
+	void applyToState(const Model& model, SimTK::State& state, double value) const;
+	/*
+	*	Set <value> in the properties of <model> (contact parameters),
+	*	effective after the next initSystem()
+	*/
+	void applyToModel(Model& model, double value) const;
+
+	static MCModelParameterType getTypeFromName(const string& name);
+	static string getTypeName(MCModelParameterType type);
+};
+
+/*
+*	Apply <values> of <parameters> to <model> and <state>. If a parameter
+*	needs a rebuild, <setup> is called again on the model (it must call
+*	initSystem()) and <state> is reset to the new working state first
+*/
+void applyModelParameters(const vector<MCModelParameter>& parameters, const vector<double>& values,
+	Model& model, SimTK::State& state, const MCWorkerSetup& setup);
+
+#endif
@@ -0,0 +1,83 @@
+#include "MCMultiFidelity.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+void MCFidelity::applyToModel(Model& model) const
+{
+	if (meshSuffix.empty())
+		return;
+
+	ContactGeometrySet& geometries = model.updContactGeometrySet();
+	for (int g=0; g<geometries.getSize(); g++)
+	{
+		ContactMesh* mesh = dynamic_cast<ContactMesh*>(&geometries.get(g));
+		if (!mesh)
+			continue;
+
+		string filename = mesh->getFilename();
+		size_t dot = filename.rfind(".obj");
+		if (dot != string::npos)
+			mesh->setFilename(filename.substr(0, dot) + meshSuffix + ".obj");
+	}
+}
+
+void MCFidelity::applyToIntegrator(SimTK::Integrator& integrator) const
+{
+	if (accuracy > 0)
+		integrator.setAccuracy(accuracy);
+}
+
+MCMultiFidelityEstimate estimateMultiFidelity(const vector<double>& high, const vector<double>& lowPaired,
+	const vector<double>& lowAll)
+{
+	if (high.size() != lowPaired.size() || high.size() < 2 || lowAll.size() < lowPaired.size())
+		throw OpenSim::Exception("estimateMultiFidelity: not enough paired samples");
+
+	MCMultiFidelityEstimate estimate;
+	const int n = (int)high.size();
+	estimate.numHigh = n;
+	estimate.numLow = (int)lowAll.size();
+
+	// moments of the paired samples
+	double meanHigh = 0, meanLow = 0;
+	for (int i=0; i<n; i++)
+	{
+		meanHigh += high[i] / n;
+		meanLow += lowPaired[i] / n;
+	}
+	double varHigh = 0, varLow = 0, cov = 0;
+	for (int i=0; i<n; i++)
+	{
+		varHigh += (high[i] - meanHigh) * (high[i] - meanHigh) / (n - 1);
+		varLow += (lowPaired[i] - meanLow) * (lowPaired[i] - meanLow) / (n - 1);
+		cov += (high[i] - meanHigh) * (lowPaired[i] - meanLow) / (n - 1);
+	}
+
+	double meanLowAll = 0;
+	for (unsigned int i=0; i<lowAll.size(); i++)
+		meanLowAll += lowAll[i] / lowAll.size();
+
+	estimate.highFidelityMean = meanHigh;
+	estimate.highFidelityVariance = varHigh / n;
+	estimate.alpha = varLow > 0 ? cov / varLow : 0;
+	estimate.correlation = varLow > 0 && varHigh > 0 ? cov / std::sqrt(varLow * varHigh) : 0;
+	estimate.mean = meanHigh + estimate.alpha * (meanLowAll - meanLow);
+
+	const double rho2 = estimate.correlation * estimate.correlation;
+	estimate.variance = varHigh / n * (1 - (1 - (double)n / estimate.numLow) * rho2);
+
+	return estimate;
+}
+
+int getOptimalNumLowFidelity(int numHigh, double correlation, double costHigh, double costLow)
+{
+	const double rho2 = correlation * correlation;
+	if (rho2 >= 1)
+		return INT_MAX;
+	if (!(costLow > 0) || !(costHigh > 0))
+		return numHigh;
+
+	double r = std::sqrt(costHigh * rho2 / (costLow * (1 - rho2)));
+	return std::max(numHigh, (int)std::ceil(r * numHigh));
+}
@@ -0,0 +1,70 @@
+#ifndef MCMULTIFIDELITY_H
+#define MCMULTIFIDELITY_H
+
+#include <OpenSim/OpenSim.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace OpenSim;
+
+/*
+*	Fidelity of the simulations of a Monte Carlo campaign. The default is
+*	the full fidelity experiment; a low fidelity campaign trades accuracy
+*	for time and keeps its outputs in <outputDir><name>/
+*/
+struct MCFidelity
+{
+	string name;			// empty for full fidelity
+	double accuracy;		// integrator accuracy, 0 for the integrator default
+	double finalTime;		// simulated horizon, 0 for the experiment default
+	string meshSuffix;		// contact meshes <name><meshSuffix>.obj (e.g. decimated copies)
+
+	MCFidelity() : accuracy(0), finalTime(0) {}
+	MCFidelity(const string& aName, double aAccuracy, double aFinalTime, const string& aMeshSuffix = "")
+		: name(aName), accuracy(aAccuracy), finalTime(aFinalTime), meshSuffix(aMeshSuffix) {}
+
+	bool isFull() const { return name.empty(); }
+	string getDirectory(const string& outputDir) const { return isFull() ? outputDir : outputDir + name + "/"; }
+	double getFinalTime(double defaultTime) const { return finalTime > 0 ? finalTime : defaultTime; }
+
+	/*
+	*	Switch the contact meshes of <model> to the reduced ones, before initSystem()
+	*/
+	void applyToModel(Model& model) const;
+	void applyToIntegrator(SimTK::Integrator& integrator) const;
+};
+
+/*
+*	Two fidelity control variate estimate of the mean of an output
+*	(multi-fidelity Monte Carlo, Peherstorfer et al. 2016):
+*		mean = mean(Y_hi) + alpha (mean(Y_lo, all) - mean(Y_lo, paired))
+*	with alpha = cov(Y_hi, Y_lo) / var(Y_lo) from the paired samples
+*/
+struct MCMultiFidelityEstimate
+{
+	double mean;
+	double variance;			// estimator variance
+	double highFidelityMean;	// high fidelity samples only
+	double highFidelityVariance;
+	double alpha;
+	double correlation;
+	int numHigh;
+	int numLow;
+};
+
+/*
+*	<high> and <lowPaired> are the outputs of the same samples at both
+*	fidelities, <lowAll> all the low fidelity outputs (a superset)
+*/
+MCMultiFidelityEstimate estimateMultiFidelity(const vector<double>& high, const vector<double>& lowPaired,
+	const vector<double>& lowAll);
+
+/*
+*	Number of low fidelity samples minimizing the estimator variance for
+*	a fixed cost, r = sqrt(costHigh rho^2 / (costLow (1 - rho^2))) per
+*	high fidelity sample
+*/
+int getOptimalNumLowFidelity(int numHigh, double correlation, double costHigh, double costLow);
+
+#endif
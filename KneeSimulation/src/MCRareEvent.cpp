@@ -0,0 +1,362 @@
+#include "MCRareEvent.h"
+#include "MCEngine.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <random>
+
+/*
+*	Seed of the estimation, a random one for seed 0
+*/
+static unsigned int getEstimationSeed(unsigned int seed)
+{
+	if (seed == 0)
+	{
+		random_device rd;
+		seed = rd();
+	}
+	mcLog("Rare event seed: " + std::to_string((unsigned long long)seed));
+	return seed;
+}
+
+/*
+*	Evaluate a batch, failed evaluations (NaN) count as no exceedance
+*/
+static void evaluate(const MCBatchResponse& response, const vector<vector<double> >& z,
+	vector<double>& g, MCRareEventResult& result)
+{
+	g.assign(z.size(), SimTK::NaN);
+	response(z, g);
+
+	result.numEvaluations += (int)z.size();
+	for (unsigned int i=0; i<g.size(); i++)
+	{
+		if (!SimTK::isFinite(g[i]))
+		{
+			g[i] = -SimTK::Infinity;
+			result.numFailedEvaluations++;
+		}
+	}
+}
+
+void getUniformFromNormal(const vector<double>& z, vector<double>& u)
+{
+	u.resize(z.size());
+	for (unsigned int i=0; i<z.size(); i++)
+		u[i] = 0.5 * std::erfc(-z[i] / std::sqrt(2.0));
+}
+
+//=============================================================================
+// IMPORTANCE SAMPLING
+//=============================================================================
+MCRareEventResult estimateByImportanceSampling(const MCBatchResponse& response, int numDimensions,
+	double threshold, const MCRareEventSettings& settings)
+{
+	MCRareEventResult result;
+	const unsigned int seed = getEstimationSeed(settings.seed);
+	const int n = settings.samplesPerLevel;
+	std::normal_distribution<double> normal(0.0, 1.0);
+
+	// likelihood ratio phi(z) / phi(z - mu)
+	vector<double> mu(numDimensions, 0.0);
+	auto getWeight = [&](const vector<double>& z)
+	{
+		double exponent = 0;
+		for (int k=0; k<numDimensions; k++)
+			exponent += -mu[k] * z[k] + 0.5 * mu[k] * mu[k];
+		return std::exp(exponent);
+	};
+
+	// cross entropy levels
+	for (int level=0; level<settings.maxLevels; level++)
+	{
+		std::mt19937 gen = getSampleRandomEngine(seed, level);
+		vector<vector<double> > z(n, vector<double>(numDimensions));
+		for (int i=0; i<n; i++)
+			for (int k=0; k<numDimensions; k++)
+				z[i][k] = mu[k] + normal(gen);
+
+		vector<double> g;
+		evaluate(response, z, g, result);
+
+		// intermediate threshold: the (1-rho) quantile, capped at the threshold
+		vector<double> sorted(g);
+		std::sort(sorted.begin(), sorted.end());
+		double gamma = sorted[std::min(n - 1, (int)std::floor((1 - settings.levelProbability) * n))];
+		const bool reached = gamma >= threshold;
+		if (reached)
+			gamma = threshold;
+		result.levels.push_back(gamma);
+
+		mcLog("Importance sampling level " + std::to_string((long long)level) + ": " + std::to_string(gamma));
+
+		// weighted mean of the elite samples
+		vector<double> newMu(numDimensions, 0.0);
+		double weights = 0;
+		for (int i=0; i<n; i++)
+		{
+			if (g[i] < gamma)
+				continue;
+			double w = getWeight(z[i]);
+			for (int k=0; k<numDimensions; k++)
+				newMu[k] += w * z[i][k];
+			weights += w;
+		}
+		if (weights > 0)
+			for (int k=0; k<numDimensions; k++)
+				mu[k] = newMu[k] / weights;
+
+		if (reached)
+			break;
+	}
+	result.designPoint = mu;
+
+	// final batches from N(mu, I) until the CoV target
+	double sum = 0, sumSquares = 0;
+	int count = 0;
+	for (int batch=0; count<settings.maxSamples; batch++)
+	{
+		std::mt19937 gen = getSampleRandomEngine(seed, settings.maxLevels + batch);
+		const int size = std::min(n, settings.maxSamples - count);
+		vector<vector<double> > z(size, vector<double>(numDimensions));
+		for (int i=0; i<size; i++)
+			for (int k=0; k<numDimensions; k++)
+				z[i][k] = mu[k] + normal(gen);
+
+		vector<double> g;
+		evaluate(response, z, g, result);
+
+		for (int i=0; i<size; i++)
+		{
+			double value = g[i] > threshold ? getWeight(z[i]) : 0.0;
+			sum += value;
+			sumSquares += value * value;
+		}
+		count += size;
+
+		result.probability = sum / count;
+		result.variance = count > 1
+			? (sumSquares / count - result.probability * result.probability) / (count - 1) : SimTK::NaN;
+		result.cov = result.probability > 0 ? std::sqrt(result.variance) / result.probability : SimTK::Infinity;
+
+		mcLog("Importance sampling: P = " + std::to_string(result.probability) + ", CoV = "
+			+ std::to_string(result.cov) + " (" + std::to_string((long long)count) + " samples)");
+
+		if (result.cov <= settings.targetCoV)
+			break;
+	}
+
+	return result;
+}
+
+//=============================================================================
+// SUBSET SIMULATION
+//=============================================================================
+MCRareEventResult estimateBySubsetSimulation(const MCBatchResponse& response, int numDimensions,
+	double threshold, const MCRareEventSettings& settings)
+{
+	MCRareEventResult result;
+	const unsigned int seed = getEstimationSeed(settings.seed);
+	const int n = settings.samplesPerLevel;
+	const double p0 = settings.levelProbability;
+	const int numChains = std::max(1, (int)(p0 * n));
+	const int chainLength = n / numChains;
+	std::normal_distribution<double> normal(0.0, 1.0);
+	std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+	// level 0: direct Monte Carlo
+	std::mt19937 gen = getSampleRandomEngine(seed, 0);
+	vector<vector<double> > z(n, vector<double>(numDimensions));
+	for (int i=0; i<n; i++)
+		for (int k=0; k<numDimensions; k++)
+			z[i][k] = normal(gen);
+
+	vector<double> g;
+	evaluate(response, z, g, result);
+
+	// samples are grouped by chain: chain c holds samples c*chainLength ... (level 0: independent)
+	double probability = 1, cov2 = 0;
+	bool independent = true;
+
+	for (int level=0; ; level++)
+	{
+		// samples sorted by decreasing response
+		vector<int> order(g.size());
+		for (unsigned int i=0; i<order.size(); i++)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [&](int a, int b) { return g[a] > g[b]; });
+
+		double b = 0.5 * (g[order[numChains - 1]] + g[order[std::min(numChains, (int)g.size() - 1)]]);
+		const bool last = b >= threshold || level + 1 >= settings.maxLevels;
+		if (last)
+			b = threshold;
+
+		// conditional probability of this level and its CoV
+		int exceed = 0;
+		vector<int> indicator(g.size());
+		for (unsigned int i=0; i<g.size(); i++)
+		{
+			indicator[i] = g[i] > b ? 1 : 0;
+			exceed += indicator[i];
+		}
+		const int numSamples = (int)g.size();
+		const double p = (double)exceed / numSamples;
+
+		double gammaFactor = 0;
+		if (!independent && p > 0 && p < 1)
+		{
+			// correlation of the indicator along the chains
+			const int chains = numSamples / chainLength;
+			double r0 = p * (1 - p);
+			for (int k=1; k<chainLength; k++)
+			{
+				double rk = 0;
+				for (int c=0; c<chains; c++)
+					for (int l=0; l<chainLength-k; l++)
+						rk += indicator[c*chainLength + l] * indicator[c*chainLength + l + k];
+				rk = rk / (numSamples - k * chains) - p * p;
+				gammaFactor += 2 * (1 - (double)k / chainLength) * rk / r0;
+			}
+		}
+		if (p > 0)
+			cov2 += (1 - p) / (p * numSamples) * (1 + gammaFactor);
+
+		probability *= p;
+		result.levels.push_back(b);
+		mcLog("Subset simulation level " + std::to_string((long long)level) + ": threshold "
+			+ std::to_string(b) + ", P = " + std::to_string(probability));
+
+		if (last || p == 0)
+			break;
+
+		// seeds: the samples above the level, then modified Metropolis chains
+		vector<vector<double> > chainZ(numChains);
+		vector<double> chainG(numChains);
+		for (int c=0; c<numChains; c++)
+		{
+			chainZ[c] = z[order[c]];
+			chainG[c] = g[order[c]];
+		}
+
+		vector<vector<double> > nextZ(numChains * chainLength);
+		vector<double> nextG(numChains * chainLength);
+		for (int c=0; c<numChains; c++)
+		{
+			nextZ[c*chainLength] = chainZ[c];
+			nextG[c*chainLength] = chainG[c];
+		}
+
+		gen = getSampleRandomEngine(seed, level + 1);
+		for (int step=1; step<chainLength; step++)
+		{
+			// componentwise proposals, accepted against the standard normal density
+			vector<vector<double> > candidates(numChains);
+			vector<bool> moved(numChains, false);
+			for (int c=0; c<numChains; c++)
+			{
+				candidates[c] = chainZ[c];
+				for (int k=0; k<numDimensions; k++)
+				{
+					double xi = chainZ[c][k] + normal(gen);
+					double ratio = std::exp(0.5 * (chainZ[c][k] * chainZ[c][k] - xi * xi));
+					if (uniform(gen) < ratio)
+					{
+						candidates[c][k] = xi;
+						moved[c] = true;
+					}
+				}
+			}
+
+			// one parallel batch per step, over the chains that moved
+			vector<vector<double> > batch;
+			vector<int> batchChains;
+			for (int c=0; c<numChains; c++)
+				if (moved[c])
+				{
+					batch.push_back(candidates[c]);
+					batchChains.push_back(c);
+				}
+
+			vector<double> batchG;
+			if (!batch.empty())
+				evaluate(response, batch, batchG, result);
+
+			for (unsigned int j=0; j<batchChains.size(); j++)
+			{
+				int c = batchChains[j];
+				if (batchG[j] > b)
+				{
+					chainZ[c] = candidates[c];
+					chainG[c] = batchG[j];
+				}
+			}
+
+			for (int c=0; c<numChains; c++)
+			{
+				nextZ[c*chainLength + step] = chainZ[c];
+				nextG[c*chainLength + step] = chainG[c];
+			}
+		}
+
+		z = nextZ;
+		g = nextG;
+		independent = false;
+	}
+
+	result.probability = probability;
+	result.cov = std::sqrt(cov2);
+	result.variance = (result.cov * probability) * (result.cov * probability);
+	if (probability == 0)
+		result.cov = SimTK::Infinity;
+
+	return result;
+}
+
+MCRareEventResult estimateRareEvent(MCRareEventMethod method, const MCBatchResponse& response,
+	int numDimensions, double threshold, const MCRareEventSettings& settings)
+{
+	if (method == MCSubsetSimulation)
+		return estimateBySubsetSimulation(response, numDimensions, threshold, settings);
+	return estimateByImportanceSampling(response, numDimensions, threshold, settings);
+}
+
+MCRareEventMethod getRareEventMethodFromName(const string& name)
+{
+	if (name == "importance_sampling")
+		return MCImportanceSampling;
+	else if (name == "subset_simulation")
+		return MCSubsetSimulation;
+
+	throw OpenSim::Exception("MCRareEvent: unknown method '" + name + "'");
+}
+
+string getRareEventMethodName(MCRareEventMethod method)
+{
+	return method == MCSubsetSimulation ? "subset_simulation" : "importance_sampling";
+}
+
+void printRareEventResult(const MCRareEventResult& result, const string& filename)
+{
+	ofstream file(filename.c_str());
+
+	file << setprecision(10);
+	file << "probability\t" << result.probability << endl;
+	file << "variance\t" << result.variance << endl;
+	file << "cov\t" << result.cov << endl;
+	file << "evaluations\t" << result.numEvaluations << endl;
+	file << "failed_evaluations\t" << result.numFailedEvaluations << endl;
+	file << "levels";
+	for (unsigned int l=0; l<result.levels.size(); l++)
+		file << "\t" << result.levels[l];
+	file << endl;
+	if (!result.designPoint.empty())
+	{
+		file << "design_point";
+		for (unsigned int k=0; k<result.designPoint.size(); k++)
+			file << "\t" << result.designPoint[k];
+		file << endl;
+	}
+
+	file.close();
+}
@@ -0,0 +1,87 @@
+#ifndef MCRAREEVENT_H
+#define MCRAREEVENT_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+*	Evaluate the response g(z) at a batch of points <z> of the standard
+*	normal space (one vector per point); the points of a batch can run in
+*	parallel. A failed evaluation returns NaN and counts as no exceedance
+*/
+typedef std::function<void(const vector<vector<double> >& z, vector<double>& g)> MCBatchResponse;
+
+/*
+*	Rare event estimators of P[g(Z) > threshold], Z standard normal.
+*	Uniform parameters u are mapped with u = Phi(z) (see getUniformFromNormal)
+*/
+enum MCRareEventMethod
+{
+	MCImportanceSampling,	// cross entropy adapted Gaussian importance density
+	MCSubsetSimulation		// Au and Beck subset simulation, modified Metropolis
+};
+
+struct MCRareEventSettings
+{
+	int samplesPerLevel;	// samples per adaptation or subset level (and per final batch)
+	double levelProbability;	// rho of the cross entropy levels, p0 of subset simulation
+	int maxLevels;
+	double targetCoV;		// importance sampling: stop adding final batches below this CoV
+	int maxSamples;			// importance sampling: maximum final samples
+	unsigned int seed;
+
+	MCRareEventSettings()
+		: samplesPerLevel(100), levelProbability(0.1), maxLevels(10),
+		targetCoV(0.1), maxSamples(1000), seed(0) {}
+};
+
+struct MCRareEventResult
+{
+	double probability;
+	double variance;		// estimator variance
+	double cov;				// coefficient of variation, sqrt(variance) / probability
+	int numEvaluations;
+	int numFailedEvaluations;
+	vector<double> levels;	// intermediate thresholds
+	vector<double> designPoint;	// importance sampling: mean of the importance density
+
+	MCRareEventResult()
+		: probability(0), variance(0), cov(0), numEvaluations(0), numFailedEvaluations(0) {}
+};
+
+/*
+*	Cross entropy importance sampling: a few levels of samples from
+*	N(mu, I) move mu towards the failure domain, then batches of the final
+*	density are added until the CoV of the estimate reaches the target
+*/
+MCRareEventResult estimateByImportanceSampling(const MCBatchResponse& response, int numDimensions,
+	double threshold, const MCRareEventSettings& settings);
+
+/*
+*	Subset simulation: P = p0^m * P[g > threshold | level m], each level
+*	populated by Markov chains started from the samples above the previous
+*	level. CoV from the chain correlation (Au and Beck 2001)
+*/
+MCRareEventResult estimateBySubsetSimulation(const MCBatchResponse& response, int numDimensions,
+	double threshold, const MCRareEventSettings& settings);
+
+MCRareEventResult estimateRareEvent(MCRareEventMethod method, const MCBatchResponse& response,
+	int numDimensions, double threshold, const MCRareEventSettings& settings);
+
+MCRareEventMethod getRareEventMethodFromName(const string& name);
+string getRareEventMethodName(MCRareEventMethod method);
+
+/*
+*	u = Phi(z), componentwise
+*/
+void getUniformFromNormal(const vector<double>& z, vector<double>& u);
+
+/*
+*	Print the result of a rare event estimation
+*/
+void printRareEventResult(const MCRareEventResult& result, const string& filename);
+
+#endif
@@ -0,0 +1,253 @@
+#include "MCSampler.h"
+#include "MCEngine.h"
+#include "MCStatistics.h"
+#include <algorithm>
+#include <cmath>
+
+// first primes, one Halton base per dimension
+static const int HaltonBases[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53};
+
+// Joe-Kuo primitive polynomials (degree s, coefficients a) and initial
+// direction numbers m_i for dimensions 2..16 (new-joe-kuo-6.21201)
+struct SobolPolynomial { int s; int a; int m[6]; };
+static const SobolPolynomial SobolPolynomials[] = {
+	{1, 0,  {1}},
+	{2, 1,  {1, 3}},
+	{3, 1,  {1, 3, 1}},
+	{3, 2,  {1, 1, 1}},
+	{4, 1,  {1, 1, 3, 3}},
+	{4, 4,  {1, 3, 5, 13}},
+	{5, 2,  {1, 1, 5, 5, 17}},
+	{5, 4,  {1, 1, 5, 5, 5}},
+	{5, 7,  {1, 1, 7, 11, 19}},
+	{5, 11, {1, 1, 5, 1, 1}},
+	{5, 13, {1, 1, 1, 3, 11}},
+	{5, 14, {1, 3, 5, 5, 31}},
+	{6, 1,  {1, 3, 3, 9, 7, 49}},
+	{6, 13, {1, 1, 1, 15, 21, 21}},
+	{6, 16, {1, 3, 1, 13, 27, 49}}
+};
+
+static const int SobolBits = 32;
+
+//=============================================================================
+// MCSampler
+//=============================================================================
+MCSampler::MCSampler(int numDimensions, unsigned int seed)
+	: m_numDimensions(numDimensions), m_seed(seed)
+{
+}
+
+MCSampler* MCSampler::create(MCSamplerType type, int numDimensions, int numSamples, unsigned int seed)
+{
+	switch (type)
+	{
+	case MCLatinHypercube:
+		return new MCLatinHypercubeSampler(numDimensions, numSamples, seed);
+	case MCHalton:
+		return new MCHaltonSampler(numDimensions);
+	case MCSobol:
+		return new MCSobolSampler(numDimensions);
+	default:
+		return new MCPseudoRandomSampler(numDimensions, seed);
+	}
+}
+
+MCSamplerType MCSampler::getTypeFromName(const string& name)
+{
+	if (name == "latin_hypercube")
+		return MCLatinHypercube;
+	else if (name == "halton")
+		return MCHalton;
+	else if (name == "sobol")
+		return MCSobol;
+	else if (name == "random")
+		return MCPseudoRandom;
+
+	throw OpenSim::Exception("MCSampler: unknown sampler '" + name + "'");
+}
+
+string MCSampler::getTypeName(MCSamplerType type)
+{
+	switch (type)
+	{
+	case MCLatinHypercube:
+		return "latin_hypercube";
+	case MCHalton:
+		return "halton";
+	case MCSobol:
+		return "sobol";
+	default:
+		return "random";
+	}
+}
+
+//=============================================================================
+// PSEUDO-RANDOM
+//=============================================================================
+MCPseudoRandomSampler::MCPseudoRandomSampler(int numDimensions, unsigned int seed)
+	: MCSampler(numDimensions, seed)
+{
+}
+
+void MCPseudoRandomSampler::getSample(int index, vector<double>& u) const
+{
+	std::mt19937 gen = getSampleRandomEngine(m_seed, index);
+	std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+	u.resize(m_numDimensions);
+	for (int d=0; d<m_numDimensions; d++)
+		u[d] = uniform(gen);
+}
+
+//=============================================================================
+// LATIN HYPERCUBE
+//=============================================================================
+MCLatinHypercubeSampler::MCLatinHypercubeSampler(int numDimensions, int numSamples, unsigned int seed)
+	: MCSampler(numDimensions, seed), m_numSamples(numSamples)
+{
+	// an independent random permutation of the strata for every dimension
+	m_strata.resize(numDimensions);
+	for (int d=0; d<numDimensions; d++)
+	{
+		m_strata[d].resize(numSamples);
+		for (int i=0; i<numSamples; i++)
+			m_strata[d][i] = i;
+
+		std::seed_seq seq{seed, (unsigned int)d, 0x4c48u};
+		std::mt19937 gen(seq);
+		for (int i=numSamples-1; i>0; i--)
+		{
+			std::uniform_int_distribution<int> pick(0, i);
+			std::swap(m_strata[d][i], m_strata[d][pick(gen)]);
+		}
+	}
+}
+
+void MCLatinHypercubeSampler::getSample(int index, vector<double>& u) const
+{
+	if (index < 0 || index >= m_numSamples)
+		throw OpenSim::Exception("MCLatinHypercubeSampler: sample index out of range");
+
+	// random position inside the stratum
+	std::mt19937 gen = getSampleRandomEngine(m_seed, index);
+	std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+	u.resize(m_numDimensions);
+	for (int d=0; d<m_numDimensions; d++)
+		u[d] = (m_strata[d][index] + uniform(gen)) / m_numSamples;
+}
+
+//=============================================================================
+// HALTON
+//=============================================================================
+MCHaltonSampler::MCHaltonSampler(int numDimensions)
+	: MCSampler(numDimensions, 0)
+{
+	if (numDimensions > (int)(sizeof(HaltonBases) / sizeof(HaltonBases[0])))
+		throw OpenSim::Exception("MCHaltonSampler: too many dimensions");
+}
+
+void MCHaltonSampler::getSample(int index, vector<double>& u) const
+{
+	u.resize(m_numDimensions);
+	for (int d=0; d<m_numDimensions; d++)
+	{
+		// radical inverse of index+1 (the origin is skipped)
+		const int base = HaltonBases[d];
+		double f = 1.0, r = 0.0;
+		for (long long n = (long long)index + 1; n > 0; n /= base)
+		{
+			f /= base;
+			r += f * (n % base);
+		}
+		u[d] = r;
+	}
+}
+
+//=============================================================================
+// SOBOL
+//=============================================================================
+MCSobolSampler::MCSobolSampler(int numDimensions)
+	: MCSampler(numDimensions, 0)
+{
+	if (numDimensions > getMaxNumDimensions())
+		throw OpenSim::Exception("MCSobolSampler: too many dimensions");
+
+	m_directions.resize(numDimensions, vector<unsigned int>(SobolBits));
+
+	// first dimension is the van der Corput sequence in base 2
+	if (numDimensions > 0)
+		for (int k=0; k<SobolBits; k++)
+			m_directions[0][k] = 1u << (SobolBits - 1 - k);
+
+	for (int d=1; d<numDimensions; d++)
+	{
+		const SobolPolynomial& p = SobolPolynomials[d-1];
+		vector<unsigned int>& v = m_directions[d];
+
+		for (int k=0; k<p.s && k<SobolBits; k++)
+			v[k] = (unsigned int)p.m[k] << (SobolBits - 1 - k);
+
+		for (int k=p.s; k<SobolBits; k++)
+		{
+			v[k] = v[k-p.s] ^ (v[k-p.s] >> p.s);
+			for (int j=1; j<p.s; j++)
+				v[k] ^= ((p.a >> (p.s - 1 - j)) & 1) * v[k-j];
+		}
+	}
+}
+
+int MCSobolSampler::getMaxNumDimensions()
+{
+	return 1 + (int)(sizeof(SobolPolynomials) / sizeof(SobolPolynomials[0]));
+}
+
+void MCSobolSampler::getSample(int index, vector<double>& u) const
+{
+	// point index+1 of the sequence (the origin is skipped), from its gray code
+	const unsigned int n = (unsigned int)index + 1;
+	const unsigned int gray = n ^ (n >> 1);
+
+	u.resize(m_numDimensions);
+	for (int d=0; d<m_numDimensions; d++)
+	{
+		unsigned int x = 0;
+		for (int k=0; k<SobolBits; k++)
+			if ((gray >> k) & 1u)
+				x ^= m_directions[d][k];
+		u[d] = x / 4294967296.0;
+	}
+}
+
+//=============================================================================
+// PARAMETER
+//=============================================================================
+double MCParameter::getValue(double u) const
+{
+	if (distribution == MCUniform)
+		return lower + u * (upper - lower);
+
+	// truncated normal: u mapped to [Phi(a), Phi(b)], then the normal quantile
+	auto cdf = [](double z) { return 0.5 * std::erfc(-z / std::sqrt(2.0)); };
+	const double a = cdf((lower - mean) / deviation);
+	const double b = cdf((upper - mean) / deviation);
+	const double p = a + u * (b - a);
+	const double z = getNormalQuantile(std::fabs(2 * p - 1));
+	return std::min(upper, std::max(lower, mean + deviation * (p < 0.5 ? -z : z)));
+}
+
+MCDistribution MCParameter::getDistributionFromName(const string& name)
+{
+	if (name == "uniform")
+		return MCUniform;
+	else if (name == "normal")
+		return MCNormal;
+
+	throw OpenSim::Exception("MCParameter: unknown distribution '" + name + "'");
+}
+
+string MCParameter::getDistributionName(MCDistribution distribution)
+{
+	return distribution == MCNormal ? "normal" : "uniform";
+}
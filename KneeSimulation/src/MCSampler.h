@@ -0,0 +1,126 @@
+#ifndef MCSAMPLER_H
+#define MCSAMPLER_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+*	Available sampling strategies for Monte Carlo campaigns
+*/
+enum MCSamplerType
+{
+	MCPseudoRandom,		// seeded pseudo-random numbers
+	MCLatinHypercube,	// one sample per stratum in every dimension
+	MCHalton,			// Halton low discrepancy sequence
+	MCSobol				// Sobol low discrepancy sequence (Joe-Kuo direction numbers)
+};
+
+/*
+*	Generates the points of a campaign in the unit hypercube [0,1)^d.
+*	Every point is addressable by its sample index, so a sample can be
+*	regenerated (or run by any worker) without drawing the previous ones
+*/
+class MCSampler
+{
+public:
+	MCSampler(int numDimensions, unsigned int seed);
+	virtual ~MCSampler() {}
+
+	int getNumDimensions() const { return m_numDimensions; }
+	unsigned int getSeed() const { return m_seed; }
+
+	/*
+	*	Point of sample <index> in [0,1)^d
+	*/
+	virtual void getSample(int index, vector<double>& u) const = 0;
+
+	/*
+	*	Create a sampler of type <type>. <numSamples> is the size of the
+	*	campaign, needed by the latin hypercube to build its strata
+	*/
+	static MCSampler* create(MCSamplerType type, int numDimensions, int numSamples, unsigned int seed);
+
+	static MCSamplerType getTypeFromName(const string& name);
+	static string getTypeName(MCSamplerType type);
+
+protected:
+	int m_numDimensions;
+	unsigned int m_seed;
+};
+
+class MCPseudoRandomSampler : public MCSampler
+{
+public:
+	MCPseudoRandomSampler(int numDimensions, unsigned int seed);
+	void getSample(int index, vector<double>& u) const;
+};
+
+class MCLatinHypercubeSampler : public MCSampler
+{
+public:
+	MCLatinHypercubeSampler(int numDimensions, int numSamples, unsigned int seed);
+	void getSample(int index, vector<double>& u) const;
+
+private:
+	int m_numSamples;
+	// stratum of each sample, per dimension
+	vector<vector<int> > m_strata;
+};
+
+class MCHaltonSampler : public MCSampler
+{
+public:
+	MCHaltonSampler(int numDimensions);
+	void getSample(int index, vector<double>& u) const;
+};
+
+class MCSobolSampler : public MCSampler
+{
+public:
+	MCSobolSampler(int numDimensions);
+	void getSample(int index, vector<double>& u) const;
+
+	static int getMaxNumDimensions();
+
+private:
+	// direction numbers per dimension, scaled to 32 bits
+	vector<vector<unsigned int> > m_directions;
+};
+
+/*
+*	Distributions of a sampled parameter
+*/
+enum MCDistribution
+{
+	MCUniform,	// uniform in [lower, upper]
+	MCNormal	// normal (mean, deviation) truncated to [lower, upper]
+};
+
+/*
+*	A sampled parameter, uniformly distributed in [lower, upper] unless
+*	a normal distribution is set
+*/
+struct MCParameter
+{
+	string name;
+	double lower;
+	double upper;
+	MCDistribution distribution;
+	double mean;
+	double deviation;
+
+	MCParameter(const string& aName, double aLower, double aUpper)
+		: name(aName), lower(aLower), upper(aUpper), distribution(MCUniform), mean(0), deviation(0) {}
+
+	void setNormal(double aMean, double aDeviation) { distribution = MCNormal; mean = aMean; deviation = aDeviation; }
+
+	// map a coordinate of the unit hypercube to the parameter range (inverse cdf)
+	double getValue(double u) const;
+
+	static MCDistribution getDistributionFromName(const string& name);
+	static string getDistributionName(MCDistribution distribution);
+};
+
+#endif
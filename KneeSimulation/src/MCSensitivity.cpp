@@ -0,0 +1,207 @@
+#include "MCSensitivity.h"
+#include "osimutils.h"
+#include <fstream>
+#include <iomanip>
+
+void addPeakOutputs(Storage& storage, MCOutputs& outputs)
+{
+	const Array<string>& labels = storage.getColumnLabels();
+	for (int c=0; c<labels.getSize(); c++)
+		if (labels[c] != "time")
+			outputs.add(labels[c], getPeakValue(storage, labels[c], true));
+}
+
+MCSensitivity::MCSensitivity(const Model& model, const vector<MCModelParameter>& parameters, int numWorkers)
+	: m_parameters(parameters), m_engine(model, numWorkers), m_numBaseSamples(0)
+{
+	if (2 * getNumParameters() > MCSobolSampler::getMaxNumDimensions())
+		throw OpenSim::Exception("MCSensitivity: too many parameters for the Sobol sequence");
+
+	// A in the first d dimensions, B in the last d
+	m_sampler.reset(new MCSobolSampler(2 * getNumParameters()));
+}
+
+void MCSensitivity::setWorkerSetup(const MCWorkerSetup& setup)
+{
+	m_setup = setup;
+	m_engine.setWorkerSetup(setup);
+}
+
+void MCSensitivity::getDesignPoint(const MCSampler& sampler, int evaluation, vector<double>& point)
+{
+	const int d = sampler.getNumDimensions() / 2;
+	const int base = evaluation / (d + 2);
+	const int matrix = evaluation % (d + 2);	// 0: A, 1: B, 2+i: AB_i
+
+	vector<double> u;
+	sampler.getSample(base, u);
+
+	point.resize(d);
+	for (int p=0; p<d; p++)
+	{
+		bool fromB = matrix == 1 || matrix == 2 + p;
+		point[p] = u[fromB ? d + p : p];
+	}
+}
+
+void MCSensitivity::getParameterValues(int evaluation, vector<double>& values) const
+{
+	getDesignPoint(*m_sampler, evaluation, values);
+	for (int p=0; p<getNumParameters(); p++)
+		values[p] = m_parameters[p].getValue(values[p]);
+}
+
+void MCSensitivity::run(int numBaseSamples, const MCOutputTask& task)
+{
+	m_numBaseSamples = numBaseSamples;
+	m_outputNames.clear();
+	m_results.assign(getNumEvaluations(), vector<double>());
+
+	vector<int> evaluations;
+	for (int e=0; e<getNumEvaluations(); e++)
+		evaluations.push_back(e);
+
+	mcLog("Sensitivity analysis: " + std::to_string((long long)getNumParameters()) + " parameters, "
+		+ std::to_string((long long)getNumEvaluations()) + " simulations");
+
+	m_engine.run(evaluations, [&](Model& model, SimTK::State& state, int e)
+	{
+		vector<double> values;
+		getParameterValues(e, values);
+		applyModelParameters(m_parameters, values, model, state, m_setup);
+
+		MCOutputs outputs;
+		task(model, state, e, outputs);
+
+		std::lock_guard<std::mutex> lock(m_resultsMutex);
+		if (m_outputNames.empty())
+			m_outputNames = outputs.names;
+		else if (outputs.names != m_outputNames)
+			throw OpenSim::Exception("MCSensitivity: evaluation " + std::to_string((long long)e)
+				+ " returned different outputs");
+		m_results[e] = outputs.values;
+	});
+
+	computeIndices();
+}
+
+int MCSensitivity::estimateIndices(int numParameters, const vector<double>& y, vector<double>& firstOrder,
+	vector<double>& total)
+{
+	const int d = numParameters;
+	const int numBaseSamples = (int)y.size() / (d + 2);
+
+	firstOrder.assign(d, SimTK::NaN);
+	total.assign(d, SimTK::NaN);
+
+	// base samples with all d+2 evaluations available
+	vector<int> valid;
+	for (int j=0; j<numBaseSamples; j++)
+	{
+		bool ok = true;
+		for (int k=0; k<d+2 && ok; k++)
+			ok = SimTK::isFinite(y[j*(d+2) + k]);
+		if (ok)
+			valid.push_back(j);
+	}
+	if (valid.size() < 2)
+		return (int)valid.size();
+
+	// variance of the output over A and B
+	double mean = 0, m2 = 0;
+	int n = 0;
+	for (unsigned int v=0; v<valid.size(); v++)
+	{
+		for (int k=0; k<2; k++)
+		{
+			double value = y[valid[v]*(d+2) + k];
+			n++;
+			double delta = value - mean;
+			mean += delta / n;
+			m2 += delta * (value - mean);
+		}
+	}
+	const double variance = m2 / (n - 1);
+	if (!(variance > 0))
+		return (int)valid.size();
+
+	for (int p=0; p<d; p++)
+	{
+		double first = 0, sum = 0;
+		for (unsigned int v=0; v<valid.size(); v++)
+		{
+			const int offset = valid[v]*(d+2);
+			double yA = y[offset];
+			double yB = y[offset + 1];
+			double yAB = y[offset + 2 + p];
+			first += yB * (yAB - yA);
+			sum += (yA - yAB) * (yA - yAB);
+		}
+		firstOrder[p] = first / valid.size() / variance;
+		total[p] = sum / (2.0 * valid.size()) / variance;
+	}
+	return (int)valid.size();
+}
+
+void MCSensitivity::computeIndices()
+{
+	const int numOutputs = (int)m_outputNames.size();
+
+	m_firstOrder.assign(numOutputs, vector<double>());
+	m_total.assign(numOutputs, vector<double>());
+	m_numValid.assign(numOutputs, 0);
+
+	for (int o=0; o<numOutputs; o++)
+	{
+		// NaN for the evaluations that failed
+		vector<double> y(getNumEvaluations(), SimTK::NaN);
+		for (int e=0; e<getNumEvaluations(); e++)
+			if ((int)m_results[e].size() == numOutputs)
+				y[e] = m_results[e][o];
+
+		m_numValid[o] = estimateIndices(getNumParameters(), y, m_firstOrder[o], m_total[o]);
+	}
+}
+
+void MCSensitivity::printIndices(const string& filename) const
+{
+	ofstream file(filename.c_str());
+
+	// Labels
+	file << "output\tparameter\tfirst_order\ttotal\tsamples" << endl;
+	for (unsigned int o=0; o<m_outputNames.size(); o++)
+		for (int p=0; p<getNumParameters(); p++)
+			file << m_outputNames[o] << "\t" << m_parameters[p].name << "\t" << m_firstOrder[o][p]
+				<< "\t" << m_total[o][p] << "\t" << m_numValid[o] << endl;
+
+	file.close();
+}
+
+void MCSensitivity::printEvaluations(const string& filename) const
+{
+	ofstream file(filename.c_str());
+
+	// Labels
+	file << "evaluation";
+	for (int p=0; p<getNumParameters(); p++)
+		file << "\t" << m_parameters[p].name;
+	for (unsigned int o=0; o<m_outputNames.size(); o++)
+		file << "\t" << m_outputNames[o];
+	file << endl;
+
+	file << setprecision(17);
+	for (int e=0; e<getNumEvaluations(); e++)
+	{
+		vector<double> values;
+		getParameterValues(e, values);
+
+		file << e;
+		for (unsigned int p=0; p<values.size(); p++)
+			file << "\t" << values[p];
+		for (unsigned int o=0; o<m_outputNames.size(); o++)
+			file << "\t" << (o < m_results[e].size() ? m_results[e][o] : SimTK::NaN);
+		file << endl;
+	}
+
+	file.close();
+}
@@ -0,0 +1,119 @@
+#ifndef MCSENSITIVITY_H
+#define MCSENSITIVITY_H
+
+#include "MCEngine.h"
+#include "MCModelParameter.h"
+#include <memory>
+
+using namespace std;
+using namespace OpenSim;
+
+/*
+*	Named scalar outputs of one simulation
+*/
+struct MCOutputs
+{
+	vector<string> names;
+	vector<double> values;
+
+	void add(const string& name, double value) { names.push_back(name); values.push_back(value); }
+};
+
+/*
+*	Add the peak magnitude of every column of <storage> (except time) to
+*	<outputs>, e.g. every output channel of a CustomAnalysis
+*/
+void addPeakOutputs(Storage& storage, MCOutputs& outputs);
+
+/*
+*	Simulation of one evaluation of a sensitivity analysis. The sampled
+*	parameters are already applied to <model> and <state>; the task runs
+*	the simulation and fills <outputs>, with the same names every time
+*/
+typedef std::function<void(Model& model, SimTK::State& state, int evaluation, MCOutputs& outputs)> MCOutputTask;
+
+/*
+*	Variance-based global sensitivity analysis (Sobol indices) over a set
+*	of model parameters, with the Saltelli sampling scheme.
+*
+*	Two independent N x d matrices A and B are taken from a 2d Sobol
+*	sequence and, for every parameter i, AB_i is A with column i from B.
+*	The N(d+2) simulations run in parallel on an MCEngine. For every output
+*	the first order index (Saltelli 2010) and the total index (Jansen 1999)
+*	of each parameter are estimated:
+*		S_i  = mean(f(B) (f(AB_i) - f(A))) / V
+*		ST_i = mean((f(A) - f(AB_i))^2) / 2V
+*/
+class MCSensitivity
+{
+public:
+	MCSensitivity(const Model& model, const vector<MCModelParameter>& parameters, int numWorkers = 0);
+
+	/*
+	*	Per worker setup, see MCEngine. Called again for evaluations that
+	*	change parameters needing a rebuild
+	*/
+	void setWorkerSetup(const MCWorkerSetup& setup);
+
+	/*
+	*	Run the N = <numBaseSamples> x (d+2) simulations and compute the indices
+	*/
+	void run(int numBaseSamples, const MCOutputTask& task);
+
+	int getNumEvaluations() const { return m_numBaseSamples * (getNumParameters() + 2); }
+	int getNumParameters() const { return (int)m_parameters.size(); }
+	const vector<string>& getOutputNames() const { return m_outputNames; }
+
+	double getFirstOrderIndex(int output, int parameter) const { return m_firstOrder[output][parameter]; }
+	double getTotalIndex(int output, int parameter) const { return m_total[output][parameter]; }
+	// number of base samples whose d+2 evaluations all succeeded for <output>
+	int getNumValidSamples(int output) const { return m_numValid[output]; }
+
+	/*
+	*	Parameter values of evaluation <evaluation>
+	*/
+	void getParameterValues(int evaluation, vector<double>& values) const;
+
+	/*
+	*	Point in [0,1)^d of evaluation <evaluation>, from the point of its
+	*	base sample in the 2d Sobol sequence <sampler>
+	*/
+	static void getDesignPoint(const MCSampler& sampler, int evaluation, vector<double>& point);
+	/*
+	*	First order and total indices of the d parameters from the values <y>
+	*	of one output at every evaluation of the design. Base samples with a
+	*	value that is not finite are left out; the indices are NaN with
+	*	fewer than two base samples left or without variance. Returns the
+	*	number of base samples used
+	*/
+	static int estimateIndices(int numParameters, const vector<double>& y, vector<double>& firstOrder,
+		vector<double>& total);
+
+	/*
+	*	Print the indices, one line per output and parameter
+	*/
+	void printIndices(const string& filename) const;
+	/*
+	*	Print the parameters and outputs of every evaluation
+	*/
+	void printEvaluations(const string& filename) const;
+
+private:
+	void computeIndices();
+
+	vector<MCModelParameter> m_parameters;
+	MCEngine m_engine;
+	MCWorkerSetup m_setup;
+	std::unique_ptr<MCSampler> m_sampler;
+	int m_numBaseSamples;
+
+	vector<string> m_outputNames;
+	vector<vector<double> > m_results;	// per evaluation, per output
+	std::mutex m_resultsMutex;
+
+	vector<vector<double> > m_firstOrder;	// per output, per parameter
+	vector<vector<double> > m_total;
+	vector<int> m_numValid;
+};
+
+#endif
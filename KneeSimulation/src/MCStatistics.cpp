@@ -0,0 +1,402 @@
+#include "MCStatistics.h"
+#include "MCEngine.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+// quantiles estimated for every output
+static const double OutputQuantiles[] = {0.05, 0.5, 0.95};
+
+//=============================================================================
+// P-SQUARE QUANTILE
+//=============================================================================
+MCP2Quantile::MCP2Quantile(double p)
+	: m_p(p), m_count(0)
+{
+	for (int i=0; i<5; i++)
+		m_q[i] = m_n[i] = 0;
+
+	m_np[0] = 1; m_np[1] = 1 + 2*p; m_np[2] = 1 + 4*p; m_np[3] = 3 + 2*p; m_np[4] = 5;
+	m_dn[0] = 0; m_dn[1] = p/2; m_dn[2] = p; m_dn[3] = (1 + p)/2; m_dn[4] = 1;
+}
+
+void MCP2Quantile::add(double x)
+{
+	// the first five values initialize the markers
+	if (m_count < 5)
+	{
+		m_q[m_count++] = x;
+		if (m_count == 5)
+		{
+			std::sort(m_q, m_q + 5);
+			for (int i=0; i<5; i++)
+				m_n[i] = i + 1;
+		}
+		return;
+	}
+
+	// cell of x, extending the extreme markers if needed
+	int k;
+	if (x < m_q[0])
+	{
+		m_q[0] = x;
+		k = 0;
+	}
+	else if (x >= m_q[4])
+	{
+		m_q[4] = x;
+		k = 3;
+	}
+	else
+	{
+		k = 0;
+		while (x >= m_q[k+1])
+			k++;
+	}
+
+	for (int i=k+1; i<5; i++)
+		m_n[i]++;
+	for (int i=0; i<5; i++)
+		m_np[i] += m_dn[i];
+	m_count++;
+
+	// move the middle markers towards their desired positions
+	for (int i=1; i<4; i++)
+	{
+		double d = m_np[i] - m_n[i];
+		if ((d >= 1 && m_n[i+1] - m_n[i] > 1) || (d <= -1 && m_n[i-1] - m_n[i] < -1))
+		{
+			d = d > 0 ? 1 : -1;
+			double q = getParabolic(i, d);
+			if (m_q[i-1] < q && q < m_q[i+1])
+				m_q[i] = q;
+			else
+				m_q[i] = getLinear(i, d);
+			m_n[i] += d;
+		}
+	}
+}
+
+double MCP2Quantile::getParabolic(int i, double d) const
+{
+	return m_q[i] + d / (m_n[i+1] - m_n[i-1])
+		* ((m_n[i] - m_n[i-1] + d) * (m_q[i+1] - m_q[i]) / (m_n[i+1] - m_n[i])
+		+ (m_n[i+1] - m_n[i] - d) * (m_q[i] - m_q[i-1]) / (m_n[i] - m_n[i-1]));
+}
+
+double MCP2Quantile::getLinear(int i, double d) const
+{
+	int j = i + (int)d;
+	return m_q[i] + d * (m_q[j] - m_q[i]) / (m_n[j] - m_n[i]);
+}
+
+double MCP2Quantile::getValue() const
+{
+	if (m_count >= 5)
+		return m_q[2];
+	if (m_count == 0)
+		return std::numeric_limits<double>::quiet_NaN();
+
+	// too few values for the markers, nearest rank
+	double sorted[5];
+	std::copy(m_q, m_q + m_count, sorted);
+	std::sort(sorted, sorted + m_count);
+	return sorted[(int)std::floor(m_p * (m_count - 1) + 0.5)];
+}
+
+//=============================================================================
+// OUTPUT STATISTICS
+//=============================================================================
+MCOutputStatistics::MCOutputStatistics(const string& name)
+	: m_name(name), m_count(0), m_mean(0), m_m2(0),
+	m_min(std::numeric_limits<double>::quiet_NaN()), m_max(std::numeric_limits<double>::quiet_NaN())
+{
+	for (unsigned int q=0; q<sizeof(OutputQuantiles) / sizeof(OutputQuantiles[0]); q++)
+		m_quantiles.push_back(MCP2Quantile(OutputQuantiles[q]));
+}
+
+void MCOutputStatistics::add(double x)
+{
+	m_count++;
+	double delta = x - m_mean;
+	m_mean += delta / m_count;
+	m_m2 += delta * (x - m_mean);
+
+	if (m_count == 1 || x < m_min)
+		m_min = x;
+	if (m_count == 1 || x > m_max)
+		m_max = x;
+
+	for (unsigned int q=0; q<m_quantiles.size(); q++)
+		m_quantiles[q].add(x);
+}
+
+double MCOutputStatistics::getVariance() const
+{
+	return m_count > 1 ? m_m2 / (m_count - 1) : std::numeric_limits<double>::quiet_NaN();
+}
+
+double MCOutputStatistics::getStdDev() const
+{
+	return std::sqrt(getVariance());
+}
+
+double MCOutputStatistics::getConfidenceWidth(double z) const
+{
+	if (m_count < 2)
+		return std::numeric_limits<double>::infinity();
+	return 2 * z * getStdDev() / std::sqrt((double)m_count);
+}
+
+//=============================================================================
+// CAMPAIGN STATISTICS
+//=============================================================================
+MCStatistics::MCStatistics(const vector<string>& outputNames)
+	: m_targets(outputNames.size(), 0.0), m_minNumSamples(20)
+{
+	for (unsigned int o=0; o<outputNames.size(); o++)
+		m_outputs.push_back(MCOutputStatistics(outputNames[o]));
+
+	setConfidenceLevel(0.95);
+}
+
+void MCStatistics::setTargets(const MCConvergenceTargets& targets, MCSamplerType samplerType)
+{
+	if (!targets.empty() && samplerType != MCPseudoRandom && samplerType != MCLatinHypercube)
+		throw OpenSim::Exception("MCStatistics: convergence targets need independent samples, not the "
+			+ MCSampler::getTypeName(samplerType) + " sequence");
+
+	std::fill(m_targets.begin(), m_targets.end(), 0.0);
+	for (MCConvergenceTargets::const_iterator it = targets.begin(); it != targets.end(); ++it)
+		m_targets[getOutputIndex(it->first)] = it->second;
+}
+
+void MCStatistics::setConfidenceLevel(double level)
+{
+	if (level <= 0 || level >= 1)
+		throw OpenSim::Exception("MCStatistics: confidence level must be in (0, 1)");
+
+	m_level = level;
+	m_z = getNormalQuantile(level);
+}
+
+int MCStatistics::getOutputIndex(const string& name) const
+{
+	for (unsigned int o=0; o<m_outputs.size(); o++)
+		if (m_outputs[o].getName() == name)
+			return o;
+
+	throw OpenSim::Exception("MCStatistics: unknown output '" + name + "'");
+}
+
+void MCStatistics::setOutputFile(const string& filename)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_filename = filename;
+
+	ifstream test(m_filename.c_str());
+	const bool exists = test.good();
+	test.close();
+
+	if (exists)
+	{
+		readOutputFile();
+		return;
+	}
+
+	// Labels
+	ofstream file(m_filename.c_str());
+	file << "sample";
+	for (unsigned int o=0; o<m_outputs.size(); o++)
+		file << "\t" << m_outputs[o].getName();
+	file << endl;
+}
+
+void MCStatistics::reload()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_filename.empty())
+		return;
+
+	for (unsigned int o=0; o<m_outputs.size(); o++)
+		m_outputs[o] = MCOutputStatistics(m_outputs[o].getName());
+	readOutputFile();
+}
+
+void MCStatistics::readOutputFile()
+{
+	ifstream file(m_filename.c_str());
+	string line;
+
+	// column labels must match the outputs
+	getline(file, line);
+	istringstream labels(line);
+	string label;
+	labels >> label;
+	for (unsigned int o=0; o<m_outputs.size(); o++)
+		if (!(labels >> label) || label != m_outputs[o].getName())
+			throw OpenSim::Exception("MCStatistics: " + m_filename + " has different outputs");
+
+	while (getline(file, line))
+	{
+		istringstream record(line);
+		int sample;
+		if (!(record >> sample))
+			continue;
+
+		for (unsigned int o=0; o<m_outputs.size(); o++)
+		{
+			// non finite values are written as nan/inf, not parsed by >>
+			string token;
+			if (!(record >> token))
+				break;
+			double x = std::strtod(token.c_str(), nullptr);
+			if (std::isfinite(x))
+				m_outputs[o].add(x);
+		}
+	}
+}
+
+map<int, double> MCStatistics::readOutputs(const string& filename, const string& outputName)
+{
+	ifstream file(filename.c_str());
+	if (!file.good())
+		throw OpenSim::Exception("MCStatistics: cannot read " + filename);
+
+	// column of the output
+	string line, label;
+	getline(file, line);
+	istringstream labels(line);
+	int column = -1;
+	for (int c=0; labels >> label; c++)
+		if (label == outputName)
+			column = c;
+	if (column < 1)
+		throw OpenSim::Exception("MCStatistics: no output " + outputName + " in " + filename);
+
+	map<int, double> values;
+	while (getline(file, line))
+	{
+		istringstream record(line);
+		string token;
+		int sample = 0;
+		for (int c=0; c<=column && record >> token; c++)
+		{
+			if (c == 0)
+				sample = std::atoi(token.c_str());
+			else if (c == column)
+			{
+				double x = std::strtod(token.c_str(), nullptr);
+				if (std::isfinite(x))
+					values[sample] = x;
+			}
+		}
+	}
+	return values;
+}
+
+void MCStatistics::add(int sample, const vector<double>& values)
+{
+	if (values.size() != m_outputs.size())
+		throw OpenSim::Exception("MCStatistics: wrong number of outputs");
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (unsigned int o=0; o<m_outputs.size(); o++)
+		if (std::isfinite(values[o]))
+			m_outputs[o].add(values[o]);
+
+	if (m_filename.empty())
+		return;
+
+	ofstream file(m_filename.c_str(), ios::app);
+	file << sample << std::setprecision(17);
+	for (unsigned int o=0; o<values.size(); o++)
+		file << "\t" << values[o];
+	file << endl;
+}
+
+bool MCStatistics::hasTargets() const
+{
+	for (unsigned int o=0; o<m_targets.size(); o++)
+		if (m_targets[o] > 0)
+			return true;
+	return false;
+}
+
+bool MCStatistics::isConverged() const
+{
+	if (!hasTargets())
+		return false;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (unsigned int o=0; o<m_outputs.size(); o++)
+	{
+		if (m_targets[o] <= 0)
+			continue;
+		if (m_outputs[o].getNumSamples() < m_minNumSamples
+			|| !(m_outputs[o].getConfidenceWidth(m_z) <= m_targets[o]))
+			return false;
+	}
+	return true;
+}
+
+MCOutputStatistics MCStatistics::getOutput(int o) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_outputs[o];
+}
+
+string MCStatistics::getSummaryText() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	ostringstream text;
+
+	text << "output\tn\tmean\tstd\tci_width_" << m_level << "\ttarget\tmin\tmax";
+	for (unsigned int q=0; q<sizeof(OutputQuantiles) / sizeof(OutputQuantiles[0]); q++)
+		text << "\tq" << OutputQuantiles[q];
+	text << endl;
+
+	for (unsigned int o=0; o<m_outputs.size(); o++)
+	{
+		const MCOutputStatistics& output = m_outputs[o];
+		text << output.getName() << "\t" << output.getNumSamples() << "\t" << output.getMean()
+			<< "\t" << output.getStdDev() << "\t" << output.getConfidenceWidth(m_z)
+			<< "\t" << m_targets[o] << "\t" << output.getMin() << "\t" << output.getMax();
+		for (int q=0; q<output.getNumQuantiles(); q++)
+			text << "\t" << output.getQuantile(q).getValue();
+		text << endl;
+	}
+	return text.str();
+}
+
+void MCStatistics::printSummary(const string& filename) const
+{
+	ofstream file(filename.c_str());
+	file << getSummaryText();
+	file.close();
+}
+
+void MCStatistics::logSummary() const
+{
+	mcLog(getSummaryText());
+}
+
+double getNormalQuantile(double level)
+{
+	// solve P(|Z| < z) = level by bisection, P(|Z| < z) = erf(z/sqrt(2))
+	double lower = 0, upper = 10;
+	for (int i=0; i<100; i++)
+	{
+		double z = 0.5 * (lower + upper);
+		if (std::erf(z / std::sqrt(2.0)) < level)
+			lower = z;
+		else
+			upper = z;
+	}
+	return 0.5 * (lower + upper);
+}
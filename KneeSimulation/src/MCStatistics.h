@@ -0,0 +1,154 @@
+#ifndef MCSTATISTICS_H
+#define MCSTATISTICS_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "MCSampler.h"
+
+using namespace std;
+
+/*
+*	Streaming estimate of the <p> quantile with the P-square algorithm
+*	(Jain and Chlamtac): five markers, constant memory, one update per value
+*/
+class MCP2Quantile
+{
+public:
+	MCP2Quantile(double p);
+
+	void add(double x);
+	double getValue() const;
+	double getProbability() const { return m_p; }
+
+private:
+	double getParabolic(int i, double d) const;
+	double getLinear(int i, double d) const;
+
+	double m_p;
+	int m_count;
+	double m_q[5];	// marker heights
+	double m_n[5];	// marker positions
+	double m_np[5];	// desired marker positions
+	double m_dn[5];	// increments of the desired positions
+};
+
+/*
+*	Running statistics of one Monte Carlo output: mean and variance
+*	(Welford), extrema and a few streaming quantiles
+*/
+class MCOutputStatistics
+{
+public:
+	MCOutputStatistics(const string& name);
+
+	void add(double x);
+
+	const string& getName() const { return m_name; }
+	int getNumSamples() const { return m_count; }
+	double getMean() const { return m_mean; }
+	double getVariance() const;
+	double getStdDev() const;
+	double getMin() const { return m_min; }
+	double getMax() const { return m_max; }
+
+	// width of the <z> confidence interval of the mean, 2*z*sd/sqrt(n)
+	double getConfidenceWidth(double z) const;
+
+	int getNumQuantiles() const { return (int)m_quantiles.size(); }
+	const MCP2Quantile& getQuantile(int q) const { return m_quantiles[q]; }
+
+private:
+	string m_name;
+	int m_count;
+	double m_mean;
+	double m_m2;
+	double m_min;
+	double m_max;
+	vector<MCP2Quantile> m_quantiles;
+};
+
+/*
+*	Target width of the confidence interval of the mean, per output name
+*/
+typedef map<string, double> MCConvergenceTargets;
+
+/*
+*	Statistics of the outputs of a Monte Carlo campaign, updated by the
+*	workers as samples complete. The campaign has converged when every
+*	output with a target has at least getMinNumSamples() values and a
+*	confidence interval narrower than its target. The interval assumes
+*	independent samples: the targets are refused for the low discrepancy
+*	sequences, whose deterministic points give no valid interval
+*/
+class MCStatistics
+{
+public:
+	MCStatistics(const vector<string>& outputNames);
+
+	/*
+	*	Stop targets of a campaign drawn by a <samplerType> sampler, only
+	*	MCPseudoRandom or MCLatinHypercube when not empty
+	*/
+	void setTargets(const MCConvergenceTargets& targets, MCSamplerType samplerType);
+	void setConfidenceLevel(double level);
+	double getConfidenceLevel() const { return m_level; }
+	void setMinNumSamples(int n) { m_minNumSamples = n; }
+	int getMinNumSamples() const { return m_minNumSamples; }
+
+	/*
+	*	Keep the outputs of every sample in <filename>. The values of an
+	*	existing file (a resumed campaign) are added to the statistics
+	*/
+	void setOutputFile(const string& filename);
+	/*
+	*	Statistics of the values of the output file only, e.g. after
+	*	worker processes appended to it (see MCEngine::setProcessWorkers)
+	*/
+	void reload();
+
+	/*
+	*	Add the outputs of sample <sample>, one value per output name.
+	*	Thread safe; values that are not finite are left out
+	*/
+	void add(int sample, const vector<double>& values);
+
+	bool hasTargets() const;
+	bool isConverged() const;
+
+	int getNumOutputs() const { return (int)m_outputs.size(); }
+	MCOutputStatistics getOutput(int o) const;
+
+	/*
+	*	Print n, mean, standard deviation, confidence width, extrema and
+	*	quantiles of every output
+	*/
+	void printSummary(const string& filename) const;
+	void logSummary() const;
+
+	/*
+	*	Finite values of output <outputName> in output file <filename>, by sample
+	*/
+	static map<int, double> readOutputs(const string& filename, const string& outputName);
+
+private:
+	int getOutputIndex(const string& name) const;
+	void readOutputFile();
+	string getSummaryText() const;
+
+	vector<MCOutputStatistics> m_outputs;
+	vector<double> m_targets;	// per output, <= 0 when not targeted
+	double m_level;
+	double m_z;
+	int m_minNumSamples;
+	string m_filename;
+	mutable std::mutex m_mutex;
+};
+
+/*
+*	Two sided standard normal quantile for confidence level <level>
+*/
+double getNormalQuantile(double level);
+
+#endif
@@ -0,0 +1,158 @@
+#include "MCStudy.h"
+
+//=============================================================================
+// PARAMETER
+//=============================================================================
+MCStudyParameter::MCStudyParameter()
+{
+	constructProperties();
+}
+
+void MCStudyParameter::constructProperties()
+{
+	constructProperty_force_name("");
+	constructProperty_type("resting_length");
+	constructProperty_lower(0.0);
+	constructProperty_upper(1.0);
+	constructProperty_distribution("uniform");
+	constructProperty_mean(0.0);
+	constructProperty_standard_deviation(0.0);
+}
+
+MCModelParameter MCStudyParameter::getParameter() const
+{
+	MCModelParameter parameter(get_force_name(), MCModelParameter::getTypeFromName(get_type()), get_lower(), get_upper());
+	if (MCParameter::getDistributionFromName(get_distribution()) == MCNormal)
+		parameter.setNormal(get_mean(), get_standard_deviation());
+	return parameter;
+}
+
+//=============================================================================
+// STUDY
+//=============================================================================
+MCStudy::MCStudy()
+{
+	constructProperties();
+}
+
+MCStudy::MCStudy(const string& fileName)
+	: Object(fileName, false)
+{
+	constructProperties();
+	updateFromXMLDocument();
+}
+
+void MCStudy::constructProperties()
+{
+	constructProperty_model_file("");
+	constructProperty_experiment("anterior_tibial_loads");
+	constructProperty_task("monte_carlo");
+	constructProperty_results_directory("");
+	constructProperty_knee_angle(-60.0);
+	constructProperty_final_time(0.0);
+	constructProperty_solver("forward_dynamics");
+	constructProperty_steady_state(true);
+	constructProperty_reduce_model(false);
+	constructProperty_integrator("runge_kutta_merson");
+	constructProperty_accuracy(0.0);
+	constructProperty_sampler("sobol");
+	constructProperty_num_samples(100);
+	constructProperty_num_workers(0);
+	constructProperty_worker_processes(false);
+	constructProperty_seed(0);
+	constructProperty_parameters();
+	constructProperty_outputs();
+	constructProperty_target_widths();
+	constructProperty_rare_event_method("subset_simulation");
+	constructProperty_threshold(0.0);
+}
+
+string MCStudy::getResultsDirectory() const
+{
+	string directory = get_results_directory();
+	if (directory.empty())
+		directory = "../outputs/" + getName();
+	if (directory[directory.size() - 1] != '/')
+		directory += "/";
+	return directory;
+}
+
+MCSamplerType MCStudy::getSamplerType() const
+{
+	return MCSampler::getTypeFromName(get_sampler());
+}
+
+vector<MCModelParameter> MCStudy::getParameters() const
+{
+	vector<MCModelParameter> parameters;
+	for (int p=0; p<getProperty_parameters().size(); p++)
+		parameters.push_back(get_parameters(p).getParameter());
+	return parameters;
+}
+
+vector<string> MCStudy::getOutputNames() const
+{
+	vector<string> outputNames;
+	for (int o=0; o<getProperty_outputs().size(); o++)
+		outputNames.push_back(get_outputs(o));
+	return outputNames;
+}
+
+MCConvergenceTargets MCStudy::getTargets() const
+{
+	MCConvergenceTargets targets;
+	for (int o=0; o<getProperty_target_widths().size() && o<getProperty_outputs().size(); o++)
+		targets[get_outputs(o)] = get_target_widths(o);
+	return targets;
+}
+
+MCRareEventMethod MCStudy::getRareEventMethod() const
+{
+	return getRareEventMethodFromName(get_rare_event_method());
+}
+
+MCRareEventSettings MCStudy::getRareEventSettings() const
+{
+	MCRareEventSettings settings;
+	settings.samplesPerLevel = get_num_samples();
+	settings.seed = (unsigned int)get_seed();
+	return settings;
+}
+
+void MCStudy::validate() const
+{
+	const string prefix = "MCStudy '" + getName() + "': ";
+
+	if (get_model_file().empty())
+		throw OpenSim::Exception(prefix + "no model_file");
+	if (get_experiment() != "anterior_tibial_loads" && get_experiment() != "flexion")
+		throw OpenSim::Exception(prefix + "unknown experiment '" + get_experiment() + "'");
+	if (get_solver() != "forward_dynamics" && get_solver() != "quasi_static")
+		throw OpenSim::Exception(prefix + "unknown solver '" + get_solver() + "'");
+	if (get_solver() == "quasi_static" && get_experiment() != "anterior_tibial_loads")
+		throw OpenSim::Exception(prefix + "the quasi_static solver is only available for anterior_tibial_loads");
+	if (get_integrator() != "runge_kutta_merson" && get_integrator() != "implicit_knee"
+		&& get_integrator() != "multirate_knee")
+		throw OpenSim::Exception(prefix + "unknown integrator '" + get_integrator() + "'");
+	if (get_task() != "monte_carlo" && get_task() != "sensitivity" && get_task() != "rare_event")
+		throw OpenSim::Exception(prefix + "unknown task '" + get_task() + "'");
+	if (getProperty_parameters().size() == 0)
+		throw OpenSim::Exception(prefix + "no parameters");
+	if (get_num_samples() <= 0)
+		throw OpenSim::Exception(prefix + "num_samples must be positive");
+	if (get_task() != "sensitivity" && getProperty_outputs().size() == 0)
+		throw OpenSim::Exception(prefix + "the outputs are needed by task " + get_task());
+	if (getProperty_target_widths().size() > getProperty_outputs().size())
+		throw OpenSim::Exception(prefix + "more target_widths than outputs");
+
+	// names are checked by the conversions
+	getSamplerType();
+	getParameters();
+	getRareEventMethod();
+}
+
+void MCStudy::registerTypes()
+{
+	Object::registerType(MCStudyParameter());
+	Object::registerType(MCStudy());
+}
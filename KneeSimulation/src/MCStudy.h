@@ -0,0 +1,141 @@
+#ifndef MCSTUDY_H
+#define MCSTUDY_H
+
+#include <OpenSim/OpenSim.h>
+#include "MCSampler.h"
+#include "MCStatistics.h"
+#include "MCModelParameter.h"
+#include "MCRareEvent.h"
+
+using namespace std;
+using namespace OpenSim;
+
+/*
+*	A sampled parameter of a study file:
+*
+*	<MCStudyParameter name="aACL_R_resting_length">
+*		<force_name>aACL_R</force_name>
+*		<type>resting_length</type>
+*		<lower>0.0285</lower>
+*		<upper>0.0335</upper>
+*	</MCStudyParameter>
+*/
+class MCStudyParameter : public Object
+{
+OpenSim_DECLARE_CONCRETE_OBJECT(MCStudyParameter, Object);
+public:
+	OpenSim_DECLARE_PROPERTY(force_name, std::string,
+		"Name of the force of the model the parameter belongs to.");
+	OpenSim_DECLARE_PROPERTY(type, std::string,
+		"resting_length, stiffness, damping, contact_stiffness or contact_dissipation.");
+	OpenSim_DECLARE_PROPERTY(lower, double,
+		"Lower bound of the parameter.");
+	OpenSim_DECLARE_PROPERTY(upper, double,
+		"Upper bound of the parameter.");
+	OpenSim_DECLARE_PROPERTY(distribution, std::string,
+		"uniform in [lower, upper], or normal (mean, standard_deviation) truncated to [lower, upper].");
+	OpenSim_DECLARE_PROPERTY(mean, double,
+		"Mean of a normal distribution.");
+	OpenSim_DECLARE_PROPERTY(standard_deviation, double,
+		"Standard deviation of a normal distribution.");
+
+	MCStudyParameter();
+
+	MCModelParameter getParameter() const;
+
+private:
+	void constructProperties();
+};
+
+/*
+*	Declarative description of a study: the experiment and task to run,
+*	the sampled parameters, the outputs and the parallelism. Study files
+*	are read and written like OpenSim setup files:
+*
+*	<OpenSimDocument Version="30000">
+*		<MCStudy name="acl_lengths">
+*			<model_file>../resources/knee.osim</model_file>
+*			<experiment>anterior_tibial_loads</experiment>
+*			<task>monte_carlo</task>
+*			<num_samples>200</num_samples>
+*			<parameters> <MCStudyParameter> ... </MCStudyParameter> </parameters>
+*			<outputs>aACL_R_force pACL_R_force APT</outputs>
+*		</MCStudy>
+*	</OpenSimDocument>
+*/
+class MCStudy : public Object
+{
+OpenSim_DECLARE_CONCRETE_OBJECT(MCStudy, Object);
+public:
+	OpenSim_DECLARE_PROPERTY(model_file, std::string,
+		"Model (.osim) of the study; studies of the same model share its loading.");
+	OpenSim_DECLARE_PROPERTY(experiment, std::string,
+		"anterior_tibial_loads or flexion.");
+	OpenSim_DECLARE_PROPERTY(task, std::string,
+		"monte_carlo, sensitivity or rare_event.");
+	OpenSim_DECLARE_PROPERTY(results_directory, std::string,
+		"Directory of the results, defaults to ../outputs/<name>/.");
+	OpenSim_DECLARE_PROPERTY(knee_angle, double,
+		"Knee angle (degrees) of the anterior tibial loads experiment.");
+	OpenSim_DECLARE_PROPERTY(final_time, double,
+		"Simulated horizon, 0 for the experiment default.");
+	OpenSim_DECLARE_PROPERTY(solver, std::string,
+		"forward_dynamics or quasi_static (anterior tibial loads only: static equilibrium of the free knee coordinates).");
+	OpenSim_DECLARE_PROPERTY(steady_state, bool,
+		"Anterior tibial loads: stop each simulation once the tibia settled.");
+	OpenSim_DECLARE_PROPERTY(reduce_model, bool,
+		"Simulate a reduced model: only the right knee coordinates free, the muscles of the experiment and "
+		"the bodies and forces the knee needs (see reduceModel).");
+	OpenSim_DECLARE_PROPERTY(integrator, std::string,
+		"runge_kutta_merson, implicit_knee (knee contact and ligament forces integrated implicitly, for stiff contact) "
+		"or multirate_knee (knee coordinates subcycled inside the steps of the muscle states).");
+	OpenSim_DECLARE_PROPERTY(accuracy, double,
+		"Integrator accuracy, 0 for the integrator default.");
+	OpenSim_DECLARE_PROPERTY(sampler, std::string,
+		"random, latin_hypercube, halton or sobol.");
+	OpenSim_DECLARE_PROPERTY(num_samples, int,
+		"Samples of a Monte Carlo campaign (maximum with convergence targets), "
+		"base samples of a sensitivity analysis, samples per level of a rare event estimation.");
+	OpenSim_DECLARE_PROPERTY(num_workers, int,
+		"Parallel workers, 0 for one per hardware thread.");
+	OpenSim_DECLARE_PROPERTY(worker_processes, bool,
+		"Monte Carlo: fork worker processes sharing the model built once, instead of threads (POSIX only).");
+	OpenSim_DECLARE_PROPERTY(seed, int,
+		"Seed of the study, 0 for a random one.");
+	OpenSim_DECLARE_LIST_PROPERTY(parameters, MCStudyParameter,
+		"Sampled parameters.");
+	OpenSim_DECLARE_LIST_PROPERTY(outputs, std::string,
+		"CustomAnalysis columns whose peak value is an output; all columns if empty.");
+	OpenSim_DECLARE_LIST_PROPERTY(target_widths, double,
+		"Monte Carlo: confidence interval width of each output, the campaign stops once reached (random or latin_hypercube sampler only).");
+	OpenSim_DECLARE_PROPERTY(rare_event_method, std::string,
+		"Rare event: importance_sampling or subset_simulation.");
+	OpenSim_DECLARE_PROPERTY(threshold, double,
+		"Rare event: threshold of the first output.");
+
+	MCStudy();
+	MCStudy(const string& fileName);
+
+	string getResultsDirectory() const;
+	MCSamplerType getSamplerType() const;
+	vector<MCModelParameter> getParameters() const;
+	vector<string> getOutputNames() const;
+	MCConvergenceTargets getTargets() const;
+	MCRareEventMethod getRareEventMethod() const;
+	MCRareEventSettings getRareEventSettings() const;
+
+	/*
+	*	Throw an OpenSim::Exception if the study is not runnable
+	*/
+	void validate() const;
+
+	/*
+	*	Register the study classes, before reading study files
+	*/
+	static void registerTypes();
+
+private:
+	void constructProperties();
+};
+
+#endif
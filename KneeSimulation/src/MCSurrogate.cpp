@@ -0,0 +1,483 @@
+#include "MCSurrogate.h"
+#include "MCEngine.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <sstream>
+
+/*
+*	Legendre polynomial of degree <n> at <x> in [-1,1]
+*/
+static double legendre(int n, double x)
+{
+	if (n == 0)
+		return 1;
+
+	double p0 = 1, p1 = x;
+	for (int k=2; k<=n; k++)
+	{
+		double p2 = ((2*k - 1) * x * p1 - (k - 1) * p0) / k;
+		p0 = p1;
+		p1 = p2;
+	}
+	return p1;
+}
+
+/*
+*	Inverse of the symmetric positive definite <n> x <n> matrix <m> (row
+*	major) by Cholesky factorization, false if it is not positive definite
+*/
+static bool invertSPD(vector<double> m, int n, vector<double>& inverse)
+{
+	// m = L L', L in the lower triangle of m
+	for (int j=0; j<n; j++)
+	{
+		double d = m[j*n + j];
+		for (int k=0; k<j; k++)
+			d -= m[j*n + k] * m[j*n + k];
+		if (!(d > 0))
+			return false;
+		m[j*n + j] = std::sqrt(d);
+
+		for (int i=j+1; i<n; i++)
+		{
+			double s = m[i*n + j];
+			for (int k=0; k<j; k++)
+				s -= m[i*n + k] * m[j*n + k];
+			m[i*n + j] = s / m[j*n + j];
+		}
+	}
+
+	// solve L L' X = I column by column
+	inverse.assign(n*n, 0.0);
+	vector<double> z(n);
+	for (int c=0; c<n; c++)
+	{
+		for (int i=0; i<n; i++)
+		{
+			double s = i == c ? 1.0 : 0.0;
+			for (int k=0; k<i; k++)
+				s -= m[i*n + k] * z[k];
+			z[i] = s / m[i*n + i];
+		}
+		for (int i=n-1; i>=0; i--)
+		{
+			double s = z[i];
+			for (int k=i+1; k<n; k++)
+				s -= m[k*n + i] * inverse[k*n + c];
+			inverse[i*n + c] = s / m[i*n + i];
+		}
+	}
+	return true;
+}
+
+/*
+*	Read a tab separated table with column labels, after "endheader" if
+*	the file has a header. Returns the rows by sample (first column),
+*	later rows replace earlier ones
+*/
+static void readSampleTable(const string& filename, vector<string>& labels, map<int, vector<string> >& rows)
+{
+	ifstream file(filename.c_str());
+	if (!file.good())
+		throw OpenSim::Exception("MCSurrogate: cannot read " + filename);
+
+	string line;
+	streampos start = file.tellg();
+	while (getline(file, line))
+		if (line == "endheader")
+		{
+			start = file.tellg();
+			break;
+		}
+	file.clear();
+	file.seekg(start);
+
+	labels.clear();
+	getline(file, line);
+	istringstream labelLine(line);
+	string label;
+	while (labelLine >> label)
+		labels.push_back(label);
+
+	while (getline(file, line))
+	{
+		istringstream record(line);
+		vector<string> values;
+		string value;
+		while (record >> value)
+			values.push_back(value);
+		if (!values.empty())
+			rows[std::atoi(values[0].c_str())] = values;
+	}
+}
+
+static int getColumn(const vector<string>& labels, const string& name, const string& filename)
+{
+	for (unsigned int c=0; c<labels.size(); c++)
+		if (labels[c] == name)
+			return c;
+
+	throw OpenSim::Exception("MCSurrogate: no column '" + name + "' in " + filename);
+}
+
+MCSurrogate::MCSurrogate(int degree)
+	: m_degree(degree), m_numTrainingSamples(0),
+	m_trainingError(SimTK::NaN), m_looError(SimTK::NaN), m_looQ2(SimTK::NaN)
+{
+}
+
+void MCSurrogate::setInputBounds(const vector<double>& lower, const vector<double>& upper)
+{
+	m_lower = lower;
+	m_upper = upper;
+}
+
+void MCSurrogate::buildTerms()
+{
+	// all multi-indices with total degree <= m_degree, by increasing degree
+	m_terms.clear();
+	const int d = getNumInputs();
+	vector<int> alpha(d, 0);
+	for (int total=0; total<=m_degree; total++)
+	{
+		// enumerate compositions of <total> into d parts
+		std::function<void(int, int)> fill = [&](int input, int remaining)
+		{
+			if (input == d - 1)
+			{
+				alpha[input] = remaining;
+				m_terms.push_back(alpha);
+				return;
+			}
+			for (int k=remaining; k>=0; k--)
+			{
+				alpha[input] = k;
+				fill(input + 1, remaining - k);
+			}
+		};
+		if (d > 0)
+			fill(0, total);
+	}
+}
+
+void MCSurrogate::evalBasis(const vector<double>& x, vector<double>& a) const
+{
+	const int d = getNumInputs();
+
+	// Legendre values per input and degree
+	vector<vector<double> > p(d, vector<double>(m_degree + 1));
+	for (int i=0; i<d; i++)
+	{
+		double xi = 2 * (x[i] - m_lower[i]) / (m_upper[i] - m_lower[i]) - 1;
+		for (int k=0; k<=m_degree; k++)
+			p[i][k] = legendre(k, xi);
+	}
+
+	a.assign(m_terms.size(), 1.0);
+	for (unsigned int t=0; t<m_terms.size(); t++)
+		for (int i=0; i<d; i++)
+			a[t] *= p[i][m_terms[t][i]];
+}
+
+void MCSurrogate::fit(const vector<string>& inputNames, const string& outputName,
+	const vector<vector<double> >& x, const vector<double>& y)
+{
+	m_inputNames = inputNames;
+	m_outputName = outputName;
+	const int d = getNumInputs();
+	const int n = (int)x.size();
+
+	if ((int)y.size() != n)
+		throw OpenSim::Exception("MCSurrogate: inputs and outputs differ in size");
+
+	// bounds from the training inputs if not given
+	if ((int)m_lower.size() != d || (int)m_upper.size() != d)
+	{
+		m_lower.assign(d, SimTK::Infinity);
+		m_upper.assign(d, -SimTK::Infinity);
+		for (int s=0; s<n; s++)
+			for (int i=0; i<d; i++)
+			{
+				m_lower[i] = std::min(m_lower[i], x[s][i]);
+				m_upper[i] = std::max(m_upper[i], x[s][i]);
+			}
+	}
+	for (int i=0; i<d; i++)
+		if (!(m_upper[i] > m_lower[i]))
+			throw OpenSim::Exception("MCSurrogate: input " + m_inputNames[i] + " has an empty range");
+
+	buildTerms();
+	const int p = getNumTerms();
+	if (n <= p)
+		throw OpenSim::Exception("MCSurrogate: " + std::to_string((long long)n) + " samples are not enough for "
+			+ std::to_string((long long)p) + " terms");
+
+	// normal equations A'A c = A'y
+	vector<vector<double> > A(n);
+	vector<double> AtA(p*p, 0.0), Aty(p, 0.0);
+	for (int s=0; s<n; s++)
+	{
+		evalBasis(x[s], A[s]);
+		for (int j=0; j<p; j++)
+		{
+			Aty[j] += A[s][j] * y[s];
+			for (int k=0; k<p; k++)
+				AtA[j*p + k] += A[s][j] * A[s][k];
+		}
+	}
+
+	// tiny ridge for (nearly) collinear inputs
+	double trace = 0;
+	for (int j=0; j<p; j++)
+		trace += AtA[j*p + j];
+	for (int j=0; j<p; j++)
+		AtA[j*p + j] += 1e-12 * trace / p;
+
+	if (!invertSPD(AtA, p, m_informationInverse))
+		throw OpenSim::Exception("MCSurrogate: singular least squares problem");
+
+	m_coefficients.assign(p, 0.0);
+	for (int j=0; j<p; j++)
+		for (int k=0; k<p; k++)
+			m_coefficients[j] += m_informationInverse[j*p + k] * Aty[k];
+
+	// training and analytic leave-one-out errors, e_i / (1 - h_i)
+	double mean = 0;
+	for (int s=0; s<n; s++)
+		mean += y[s] / n;
+
+	double sse = 0, loo = 0, variance = 0;
+	for (int s=0; s<n; s++)
+	{
+		double prediction = 0, leverage = 0;
+		for (int j=0; j<p; j++)
+		{
+			prediction += m_coefficients[j] * A[s][j];
+			double row = 0;
+			for (int k=0; k<p; k++)
+				row += m_informationInverse[j*p + k] * A[s][k];
+			leverage += A[s][j] * row;
+		}
+		double e = y[s] - prediction;
+		sse += e * e;
+		loo += e * e / ((1 - leverage) * (1 - leverage));
+		variance += (y[s] - mean) * (y[s] - mean);
+	}
+
+	m_numTrainingSamples = n;
+	m_trainingError = std::sqrt(sse / n);
+	m_looError = std::sqrt(loo / n);
+	m_looQ2 = variance > 0 ? 1 - loo / variance : SimTK::NaN;
+
+	mcLog("Surrogate of " + m_outputName + ": " + std::to_string((long long)p) + " terms, "
+		+ std::to_string((long long)n) + " samples, leave-one-out error " + std::to_string(m_looError)
+		+ ", Q2 " + std::to_string(m_looQ2));
+}
+
+double MCSurrogate::predict(const vector<double>& x) const
+{
+	if ((int)x.size() != getNumInputs())
+		throw OpenSim::Exception("MCSurrogate: wrong number of inputs");
+
+	vector<double> a;
+	evalBasis(x, a);
+
+	double y = 0;
+	for (unsigned int t=0; t<a.size(); t++)
+		y += m_coefficients[t] * a[t];
+	return y;
+}
+
+vector<int> MCSurrogate::selectSamples(const vector<vector<double> >& candidates, int count) const
+{
+	const int p = getNumTerms();
+	vector<double> inverse = m_informationInverse;
+	vector<bool> taken(candidates.size(), false);
+	vector<int> selected;
+
+	vector<vector<double> > basis(candidates.size());
+	for (unsigned int c=0; c<candidates.size(); c++)
+		evalBasis(candidates[c], basis[c]);
+
+	while ((int)selected.size() < count && selected.size() < candidates.size())
+	{
+		// candidate of largest leverage
+		int best = -1;
+		double bestLeverage = -1;
+		vector<double> bestRow;
+		for (unsigned int c=0; c<candidates.size(); c++)
+		{
+			if (taken[c])
+				continue;
+
+			vector<double> row(p, 0.0);
+			double leverage = 0;
+			for (int j=0; j<p; j++)
+			{
+				for (int k=0; k<p; k++)
+					row[j] += inverse[j*p + k] * basis[c][k];
+				leverage += basis[c][j] * row[j];
+			}
+			if (leverage > bestLeverage)
+			{
+				best = c;
+				bestLeverage = leverage;
+				bestRow = row;
+			}
+		}
+
+		// add it to the design, Sherman-Morrison update of (A'A)^-1
+		for (int j=0; j<p; j++)
+			for (int k=0; k<p; k++)
+				inverse[j*p + k] -= bestRow[j] * bestRow[k] / (1 + bestLeverage);
+
+		taken[best] = true;
+		selected.push_back(best);
+	}
+	return selected;
+}
+
+void MCSurrogate::save(const string& filename) const
+{
+	ofstream file(filename.c_str());
+	const int p = getNumTerms();
+
+	file << "Polynomial chaos surrogate" << endl;
+	file << "output=" << m_outputName << endl;
+	file << "inputs=";
+	for (int i=0; i<getNumInputs(); i++)
+		file << (i ? "," : "") << m_inputNames[i];
+	file << endl;
+	file << "degree=" << m_degree << endl;
+	file << "terms=" << p << endl;
+	file << "training_samples=" << m_numTrainingSamples << endl;
+	file << "training_error=" << m_trainingError << endl;
+	file << "loo_error=" << m_looError << endl;
+	file << "loo_q2=" << m_looQ2 << endl;
+	file << "endheader" << endl;
+
+	file << setprecision(17);
+	for (int i=0; i<getNumInputs(); i++)
+		file << m_inputNames[i] << "\t" << m_lower[i] << "\t" << m_upper[i] << endl;
+
+	// one term per line, degree per input then coefficient
+	for (int t=0; t<p; t++)
+	{
+		for (int i=0; i<getNumInputs(); i++)
+			file << m_terms[t][i] << "\t";
+		file << m_coefficients[t] << endl;
+	}
+
+	// (A'A)^-1, needed for active learning
+	for (int j=0; j<p; j++)
+	{
+		for (int k=0; k<p; k++)
+			file << (k ? "\t" : "") << m_informationInverse[j*p + k];
+		file << endl;
+	}
+}
+
+void MCSurrogate::load(const string& filename)
+{
+	ifstream file(filename.c_str());
+	if (!file.good())
+		throw OpenSim::Exception("MCSurrogate: cannot read " + filename);
+
+	string line, inputs;
+	int p = 0;
+	while (getline(file, line) && line != "endheader")
+	{
+		size_t eq = line.find('=');
+		if (eq == string::npos)
+			continue;
+		string key = line.substr(0, eq);
+		string value = line.substr(eq + 1);
+		if (key == "output")
+			m_outputName = value;
+		else if (key == "inputs")
+			inputs = value;
+		else if (key == "degree")
+			m_degree = std::atoi(value.c_str());
+		else if (key == "terms")
+			p = std::atoi(value.c_str());
+		else if (key == "training_samples")
+			m_numTrainingSamples = std::atoi(value.c_str());
+		else if (key == "training_error")
+			m_trainingError = std::strtod(value.c_str(), nullptr);
+		else if (key == "loo_error")
+			m_looError = std::strtod(value.c_str(), nullptr);
+		else if (key == "loo_q2")
+			m_looQ2 = std::strtod(value.c_str(), nullptr);
+	}
+
+	m_inputNames.clear();
+	istringstream names(inputs);
+	string name;
+	while (getline(names, name, ','))
+		m_inputNames.push_back(name);
+
+	const int d = getNumInputs();
+	m_lower.resize(d);
+	m_upper.resize(d);
+	for (int i=0; i<d; i++)
+		file >> name >> m_lower[i] >> m_upper[i];
+
+	m_terms.assign(p, vector<int>(d));
+	m_coefficients.resize(p);
+	for (int t=0; t<p; t++)
+	{
+		for (int i=0; i<d; i++)
+			file >> m_terms[t][i];
+		file >> m_coefficients[t];
+	}
+
+	m_informationInverse.resize(p*p);
+	for (int j=0; j<p*p; j++)
+		file >> m_informationInverse[j];
+
+	if (!file)
+		throw OpenSim::Exception("MCSurrogate: " + filename + " is incomplete");
+}
+
+void MCSurrogate::readCampaign(const string& directory, const vector<string>& inputNames,
+	const string& outputName, vector<vector<double> >& x, vector<double>& y)
+{
+	const string manifestFile = directory + "manifest.txt";
+	const string outputsFile = directory + "outputs.txt";
+
+	vector<string> manifestLabels, outputLabels;
+	map<int, vector<string> > manifest, outputs;
+	readSampleTable(manifestFile, manifestLabels, manifest);
+	readSampleTable(outputsFile, outputLabels, outputs);
+
+	const int statusColumn = getColumn(manifestLabels, "status", manifestFile);
+	vector<int> inputColumns;
+	for (unsigned int i=0; i<inputNames.size(); i++)
+		inputColumns.push_back(getColumn(manifestLabels, inputNames[i], manifestFile));
+	const int outputColumn = getColumn(outputLabels, outputName, outputsFile);
+
+	x.clear();
+	y.clear();
+	for (map<int, vector<string> >::const_iterator it = outputs.begin(); it != outputs.end(); ++it)
+	{
+		map<int, vector<string> >::const_iterator record = manifest.find(it->first);
+		if (record == manifest.end() || record->second[statusColumn] != "done"
+			|| (int)it->second.size() <= outputColumn)
+			continue;
+
+		double value = std::strtod(it->second[outputColumn].c_str(), nullptr);
+		if (!SimTK::isFinite(value))
+			continue;
+
+		vector<double> input;
+		for (unsigned int i=0; i<inputColumns.size(); i++)
+			input.push_back(std::strtod(record->second[inputColumns[i]].c_str(), nullptr));
+		x.push_back(input);
+		y.push_back(value);
+	}
+}
@@ -0,0 +1,86 @@
+#ifndef MCSURROGATE_H
+#define MCSURROGATE_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+*	Polynomial chaos expansion of a campaign output over uniformly
+*	distributed inputs: a total degree Legendre polynomial of the inputs
+*	scaled to [-1,1], fitted by least squares to the finished samples.
+*	Evaluating it costs a few polynomial evaluations (microseconds),
+*	instead of a forward dynamics simulation
+*/
+class MCSurrogate
+{
+public:
+	MCSurrogate(int degree = 3);
+
+	/*
+	*	Range of each input, scaled to [-1,1]. Without bounds the range of
+	*	the training inputs is used
+	*/
+	void setInputBounds(const vector<double>& lower, const vector<double>& upper);
+
+	/*
+	*	Fit the expansion to outputs <y> at inputs <x> (one vector per sample)
+	*/
+	void fit(const vector<string>& inputNames, const string& outputName,
+		const vector<vector<double> >& x, const vector<double>& y);
+
+	double predict(const vector<double>& x) const;
+
+	int getDegree() const { return m_degree; }
+	int getNumInputs() const { return (int)m_inputNames.size(); }
+	int getNumTerms() const { return (int)m_terms.size(); }
+	int getNumTrainingSamples() const { return m_numTrainingSamples; }
+	const vector<string>& getInputNames() const { return m_inputNames; }
+	const string& getOutputName() const { return m_outputName; }
+
+	// root mean square errors on the training samples and leave-one-out
+	double getTrainingError() const { return m_trainingError; }
+	double getLeaveOneOutError() const { return m_looError; }
+	// 1 - leave-one-out mean square error / output variance
+	double getLeaveOneOutQ2() const { return m_looQ2; }
+
+	/*
+	*	Active learning: choose <count> of <candidates> to simulate next.
+	*	Candidates are taken greedily where the expansion is least
+	*	determined (largest leverage a(x)' (A'A)^-1 a(x), D-optimal design),
+	*	updating the design after every choice. Returns candidate indices
+	*/
+	vector<int> selectSamples(const vector<vector<double> >& candidates, int count) const;
+
+	void save(const string& filename) const;
+	void load(const string& filename);
+
+	/*
+	*	Read the inputs <inputNames> (parameters in the manifest) and the
+	*	output <outputName> (outputs.txt) of the finished samples of the
+	*	campaign in <directory>
+	*/
+	static void readCampaign(const string& directory, const vector<string>& inputNames,
+		const string& outputName, vector<vector<double> >& x, vector<double>& y);
+
+private:
+	void buildTerms();
+	void evalBasis(const vector<double>& x, vector<double>& a) const;
+
+	int m_degree;
+	vector<string> m_inputNames;
+	string m_outputName;
+	vector<double> m_lower;
+	vector<double> m_upper;
+	vector<vector<int> > m_terms;	// multi-index (degree per input) of each term
+	vector<double> m_coefficients;
+	vector<double> m_informationInverse;	// (A'A)^-1, row major, for active learning
+
+	int m_numTrainingSamples;
+	double m_trainingError;
+	double m_looError;
+	double m_looQ2;
+};
+
+#endif
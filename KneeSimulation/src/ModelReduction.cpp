@@ -0,0 +1,246 @@
+#include "ModelReduction.h"
+#include <algorithm>
+#include <map>
+#include <set>
+#include <sstream>
+
+/*
+*	Every string property value of <object> and of the objects it holds
+*	(body names of path points, contact geometries, coordinates...)
+*/
+static void collectNames(const Object& object, set<string>& names)
+{
+	for (int p=0; p<object.getNumProperties(); p++)
+	{
+		const AbstractProperty& property = object.getPropertyByIndex(p);
+		for (int i=0; i<property.size(); i++)
+		{
+			if (property.isObjectProperty())
+				collectNames(property.getValueAsObject(i), names);
+			else if (property.getTypeName() == "string")
+				names.insert(property.getValue<string>(i));
+		}
+	}
+
+	// properties not converted to the new property system yet
+	const PropertySet& deprecated = object.getPropertySet();
+	for (int p=0; p<deprecated.getSize(); p++)
+	{
+		const Property_Deprecated* property = deprecated.get(p);
+		if (property->getType() == Property_Deprecated::Str)
+			names.insert(property->getValueStr());
+		else if (property->getType() == Property_Deprecated::Obj)
+			collectNames(property->getValueObj(), names);
+		else if (property->getType() == Property_Deprecated::ObjPtr && property->getValueObjPtr())
+			collectNames(*property->getValueObjPtr(), names);
+	}
+}
+
+/*
+*	Bodies <object> acts on, directly or through coordinates and contact
+*	geometries. Empty if none is known
+*/
+static set<string> getReferencedBodies(const Model& model, const Object& object,
+	const map<string, string>& coordinateBodies)
+{
+	set<string> names, bodies;
+	collectNames(object, names);
+	const ContactGeometrySet& geometries = model.getContactGeometrySet();
+	for (set<string>::const_iterator name = names.begin(); name != names.end(); ++name)
+	{
+		map<string, string>::const_iterator coordinate = coordinateBodies.find(*name);
+		if (model.getBodySet().contains(*name))
+			bodies.insert(*name);
+		else if (coordinate != coordinateBodies.end())
+			bodies.insert(coordinate->second);
+		else if (geometries.contains(*name))
+			bodies.insert(geometries.get(*name).getBodyName());
+	}
+	return bodies;
+}
+
+static bool contains(const vector<string>& names, const string& name)
+{
+	return std::find(names.begin(), names.end(), name) != names.end();
+}
+
+static bool anyOf(const set<string>& names, const set<string>& among)
+{
+	for (set<string>::const_iterator name = names.begin(); name != names.end(); ++name)
+		if (among.count(*name))
+			return true;
+	return false;
+}
+
+string ModelReductionReport::getSummary() const
+{
+	std::ostringstream summary;
+	summary << "Reduced model " << fileName << ": " << lockedCoordinates.size() << " coordinates locked, "
+		<< removedBodies.size() << " bodies, " << removedForces.size() << " forces and "
+		<< removedConstraints.size() << " constraints removed";
+	return summary.str();
+}
+
+string getReducedModelFileName(const Model& model, const string& suffix)
+{
+	const string input = model.getInputFileName();
+	if (input.empty())
+		throw OpenSim::Exception("reduceModel: the model was not read from a file");
+	const size_t dot = input.rfind('.');
+	const size_t slash = input.find_last_of("/\\");
+	const string stem = dot == string::npos || (slash != string::npos && dot < slash) ? input : input.substr(0, dot);
+	return stem + "_" + suffix + ".osim";
+}
+
+Model reduceModel(const Model& model, const ModelReductionSettings& settings, const string& fileName,
+	ModelReductionReport* report)
+{
+	ModelReductionReport result;
+	result.fileName = fileName;
+
+	// the views of the copy (joints, coordinates) are stale once bodies
+	// are removed, they are only used before
+	Model reduced(model);
+	const JointSet& joints = reduced.getJointSet();
+	if (!joints.contains(settings.targetJoint))
+		throw OpenSim::Exception("reduceModel: no joint " + settings.targetJoint);
+
+	// tree of the bodies
+	map<string, string> parents, coordinateBodies;
+	for (int j=0; j<joints.getSize(); j++)
+	{
+		const Joint& joint = joints.get(j);
+		parents[joint.getBody().getName()] = joint.getParentName();
+		for (int c=0; c<joint.getCoordinateSet().getSize(); c++)
+			coordinateBodies[joint.getCoordinateSet().get(c).getName()] = joint.getBody().getName();
+	}
+
+	// free coordinates, closed over the constraints coupling them
+	CoordinateSet& coordinates = reduced.updCoordinateSet();
+	set<string> free;
+	const CoordinateSet& target = joints.get(settings.targetJoint).getCoordinateSet();
+	for (int c=0; c<target.getSize(); c++)
+		free.insert(target.get(c).getName());
+	for (unsigned int c=0; c<settings.freeCoordinates.size(); c++)
+	{
+		if (!coordinates.contains(settings.freeCoordinates[c]))
+			throw OpenSim::Exception("reduceModel: no coordinate " + settings.freeCoordinates[c]);
+		free.insert(settings.freeCoordinates[c]);
+	}
+	const ConstraintSet& constraints = reduced.getConstraintSet();
+	for (size_t previous = 0; previous != free.size(); )
+	{
+		previous = free.size();
+		for (int c=0; c<constraints.getSize(); c++)
+		{
+			set<string> names;
+			collectNames(constraints.get(c), names);
+			if (!anyOf(names, free))
+				continue;
+			for (set<string>::const_iterator name = names.begin(); name != names.end(); ++name)
+				if (coordinates.contains(*name))
+					free.insert(*name);
+		}
+	}
+	for (int c=0; c<coordinates.getSize(); c++)
+		if (!free.count(coordinates.get(c).getName()) && !coordinates.get(c).getDefaultLocked())
+		{
+			coordinates.get(c).setDefaultLocked(true);
+			result.lockedCoordinates.push_back(coordinates.get(c).getName());
+		}
+
+	// moving bodies: a free coordinate between them and ground
+	set<string> moving;
+	for (map<string, string>::const_iterator coordinate = coordinateBodies.begin();
+		coordinate != coordinateBodies.end(); ++coordinate)
+		if (free.count(coordinate->first))
+			moving.insert(coordinate->second);
+	for (size_t previous = 0; previous != moving.size(); )
+	{
+		previous = moving.size();
+		for (map<string, string>::const_iterator body = parents.begin(); body != parents.end(); ++body)
+			if (moving.count(body->second))
+				moving.insert(body->first);
+	}
+
+	// actuators and inert forces
+	set<string> removedActuators, needed;
+	ForceSet& forces = reduced.updForceSet();
+	for (unsigned int a=0; a<settings.activeActuators.size(); a++)
+		if (!forces.contains(settings.activeActuators[a]))
+			throw OpenSim::Exception("reduceModel: no actuator " + settings.activeActuators[a]);
+	for (int f=forces.getSize()-1; f>=0; f--)
+	{
+		const Force& force = forces.get(f);
+		const bool actuator = dynamic_cast<const Actuator*>(&force) != nullptr;
+		const set<string> bodies = getReferencedBodies(reduced, force, coordinateBodies);
+		const bool inactive = actuator && !settings.keepActuators && !contains(settings.activeActuators, force.getName());
+		const bool inert = !bodies.empty() && !anyOf(bodies, moving);
+		if (inactive || inert)
+		{
+			if (actuator)
+				removedActuators.insert(force.getName());
+			result.removedForces.push_back(force.getName());
+			forces.remove(f);
+		}
+		else
+			needed.insert(bodies.begin(), bodies.end());
+	}
+	const ControllerSet& controllers = reduced.getControllerSet();
+	for (int c=0; c<controllers.getSize(); c++)
+	{
+		set<string> names;
+		collectNames(controllers.get(c), names);
+		if (anyOf(names, removedActuators))
+			throw OpenSim::Exception("reduceModel: controller " + controllers.get(c).getName()
+				+ " drives removed actuators, reduce the model before adding it");
+	}
+
+	ConstraintSet& updConstraints = reduced.updConstraintSet();
+	for (int c=updConstraints.getSize()-1; c>=0; c--)
+	{
+		const set<string> bodies = getReferencedBodies(reduced, updConstraints.get(c), coordinateBodies);
+		if (!bodies.empty() && !anyOf(bodies, moving))
+		{
+			result.removedConstraints.push_back(updConstraints.get(c).getName());
+			updConstraints.remove(c);
+		}
+		else
+			needed.insert(bodies.begin(), bodies.end());
+	}
+
+	// kept bodies: moving (carried by a moving body included) or needed,
+	// and the bodies between them and ground
+	set<string> kept(needed);
+	kept.insert(moving.begin(), moving.end());
+	kept.insert(reduced.getGroundBody().getName());
+	vector<string> pending(kept.begin(), kept.end());
+	while (!pending.empty())
+	{
+		map<string, string>::const_iterator parent = parents.find(pending.back());
+		pending.pop_back();
+		if (parent != parents.end() && kept.insert(parent->second).second)
+			pending.push_back(parent->second);
+	}
+
+	ContactGeometrySet& geometries = reduced.updContactGeometrySet();
+	for (int g=geometries.getSize()-1; g>=0; g--)
+		if (!kept.count(geometries.get(g).getBodyName()))
+			geometries.remove(g);
+	MarkerSet& markers = reduced.updMarkerSet();
+	for (int m=markers.getSize()-1; m>=0; m--)
+		if (!kept.count(markers.get(m).getBodyName()))
+			markers.remove(m);
+	BodySet& bodies = reduced.updBodySet();
+	for (int b=bodies.getSize()-1; b>=0; b--)
+		if (!kept.count(bodies.get(b).getName()))
+		{
+			result.removedBodies.push_back(bodies.get(b).getName());
+			bodies.remove(b);
+		}
+
+	reduced.print(fileName);
+	if (report)
+		*report = result;
+	return Model(fileName);
+}
@@ -0,0 +1,54 @@
+#ifndef MODELREDUCTION_H
+#define MODELREDUCTION_H
+
+#include <OpenSim/OpenSim.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace OpenSim;
+
+struct ModelReductionSettings
+{
+	string targetJoint;
+	vector<string> freeCoordinates;	// kept free besides the coordinates of the target joint
+	vector<string> activeActuators;	// the other actuators are removed ...
+	bool keepActuators;				// ... unless this is set
+
+	ModelReductionSettings(const string& aTargetJoint = "knee_r") : targetJoint(aTargetJoint), keepActuators(false) {}
+};
+
+struct ModelReductionReport
+{
+	string fileName;
+	vector<string> lockedCoordinates;
+	vector<string> removedBodies;
+	vector<string> removedForces;
+	vector<string> removedConstraints;
+
+	string getSummary() const;
+};
+
+/*
+*	Reduce <model> to what the dynamics of the target joint need:
+*	- every coordinate other than the ones of the target joint and
+*	  <freeCoordinates> (and the ones constrained with them) is locked
+*	- the actuators not in <activeActuators> are removed
+*	- the forces and constraints acting only on bodies that no longer move
+*	  (no free coordinate between them and ground) are removed
+*	- the bodies that do not move, carry no moving body and no remaining
+*	  force or constraint are removed with their joints, contact
+*	  geometries and markers
+*	The reduced model is printed to <fileName> (next to the original one,
+*	the contact meshes are named relative to it) and loaded back from it.
+*	Reduce before adding controllers: an actuator of a controller cannot
+*	be removed
+*/
+Model reduceModel(const Model& model, const ModelReductionSettings& settings, const string& fileName,
+	ModelReductionReport* report = nullptr);
+/*
+*	<model> input file name with <suffix> before its extension
+*/
+string getReducedModelFileName(const Model& model, const string& suffix);
+
+#endif
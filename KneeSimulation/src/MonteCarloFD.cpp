@@ -4,6 +4,31 @@
 #include "ACLsimulatorimpl.h"
 #include <math.h>
 #include "osimutils.h"
+#include "MCEngine.h"
+#include "MCSampler.h"
+#include "MCCampaign.h"
+#include "MCStatistics.h"
+#include "MCSensitivity.h"
+#include "MCSurrogate.h"
+#include "MCRareEvent.h"
+#include "MCMultiFidelity.h"
+#include "MCCostModel.h"
+#include "MCModelCache.h"
+#include "SteadyStateHandler.h"
+#include "QuasiStaticSolver.h"
+#include "IntegratorBenchmark.h"
+#include "ImplicitKneeIntegrator.h"
+#include "MultiRateKneeIntegrator.h"
+#include "ModelReduction.h"
+#include "Profiler.h"
+#include "ForceCostProfiler.h"
+#include "IntegratorTelemetry.h"
+#include "WatchdogHandler.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <memory>
 
 using namespace OpenSim;
 using namespace SimTK;
@@ -19,225 +44,1220 @@ template<typename T> std::string changeToString(
     }     oss << value;     return oss.str();
 }
 
-void performMCFD_flexion(Model model, int iterations)
+/*
+*	Create <outputDir> and the directories of the per sample results
+*/
+static void makeOutputDirectories(const string& outputDir)
 {
-    std::default_random_engine gen;
-	random_device rd;
-    gen.seed(rd());
-	//std::uniform_real_distribution<double> random_stiff(5*1.e8, 5*1.e9);
-	//std::uniform_real_distribution<double> random_diss(0.0, 20.0);
-	//std::uniform_real_distribution<double> random_aPCL_force(4800, 6200);
-	std::uniform_real_distribution<double> random_PCL_length_range(0, 0.01); // length diff
+	IO::makeDir(outputDir);
+	IO::makeDir(outputDir + "states");
+	IO::makeDir(outputDir + "ForceReporter");
+	IO::makeDir(outputDir + "CustomReporter");
+	IO::makeDir(outputDir + "Telemetry");
+	IO::makeDir(outputDir + "Failed");
+}
 
-	// flexion controller 
-	addFlexionController(model);
+/*
+*	Integrator telemetry of the samples of the campaign in <outputDir>
+*	(telemetry.txt) to telemetry_summary.txt and the log
+*/
+static void summarizeTelemetry(const string& outputDir)
+{
+	const string summary = IntegratorTelemetry::summarizeFile(outputDir + "telemetry.txt");
+	ofstream file((outputDir + "telemetry_summary.txt").c_str());
+	file << summary << endl;
+	mcLog(summary);
+}
+
+/*
+*	If the watchdog stopped the integration of sample <i>: print its last
+*	state and contacts to <outputDir>Failed/ and throw, the engine records
+*	the sample as failed
+*/
+static void checkWatchdog(const Model& model, const SimTK::State& si, const string& outputDir, int i)
+{
+	WatchdogHandler* watchdog = WatchdogHandler::get(model);
+	if (!watchdog || !watchdog->isTriggered())
+		return;
+
+	watchdog->printDiagnostics(si, outputDir + "Failed/" + changeToString(i));
+	throw OpenSim::Exception("Sample " + changeToString(i) + " stopped by the watchdog: " + watchdog->getReason());
+}
+
+/*
+*	Samples of <campaign> to run: the pending ones, or the pending
+*	ones of <samples> if it is not empty
+*/
+static vector<int> getRequestedSamples(const MCCampaign& campaign, const vector<int>& samples)
+{
+	if (samples.empty())
+		return campaign.getPendingSamples();
+
+	vector<int> requested;
+	for (unsigned int s=0; s<samples.size(); s++)
+		if (campaign.getStatus(samples[s]) != MCSampleDone)
+			requested.push_back(samples[s]);
+	return requested;
+}
+
+static const string AtlOutputDir = "../outputs/MC_anterior_loads/MC_AclLength_Atl_v6/";
+
+/*
+*	Worker setup of the anterior tibial loads experiment at <kneeAngle>,
+*	the integration stops once the tibia settled (see SteadyStateHandler)
+*	or out of the <watchdog> budgets
+*/
+static void setupAnteriorTibialLoads(Model& model, double kneeAngle, const MCFidelity& fidelity = MCFidelity(),
+	const SteadyStateSettings& steadyState = SteadyStateSettings(), const WatchdogSettings& watchdog = WatchdogSettings(false))
+{
+	fidelity.applyToModel(model);
+
+	// edit prescribed force for anterior tibial load
+	addTibialLoads(model, kneeAngle);
 
 	// init system
-	std::time_t result = std::time(nullptr);
-	std::cout << "\nBefore initSystem() " << std::asctime(std::localtime(&result)) << endl;
-	SimTK::State& si = model.initSystem();
-	result = std::time(nullptr);
-	std::cout << "\nAfter initSystem() " << std::asctime(std::localtime(&result)) << endl;
-	
+	ProfileScope initSystem("initSystem");
+	model.buildSystem();
+	SteadyStateHandler::add(model, steadyState);
+	WatchdogHandler::add(model, watchdog);
+	SimTK::State& si = model.initializeState();
+	initSystem.stop();
+
+	// set gravity	
+	model.updGravityForce().setGravityVector(si, Vec3(0,0,0));
+
+	// pose of an earlier run, unless the model files, the kinematics table or the pose code changed
+	const string pose = "atl_" + changeToString(kneeAngle);
+	if (MCModelCache::loadPose(model, si, pose))
+		return;
+
+	setKneeAngle(model, si, kneeAngle, true, true);
+	ProfileScope equilibrate("equilibrateMuscles");
+	model.equilibrateMuscles( si);
+	equilibrate.stop();
+	MCModelCache::savePose(model, si, pose);
+}
+
+static const string FlexionOutputDir = "../outputs/MC_flexion/MC_PclLength_Flexion_v6/";
+
+/*
+*	Sampled parameters of the flexion campaign: aPCL and pPCL resting
+*	lengths at the point <u> of the unit hypercube
+*/
+static vector<double> getFlexionParameters(const vector<double>& u)
+{
+	// sampled parameters
+	//MCParameter random_stiff("stiffness", 5*1.e8, 5*1.e9);
+	//MCParameter random_diss("dissipation", 0.0, 20.0);
+	//MCParameter random_aPCL_force("aPCL_stiffness", 4800, 6200);
+	MCParameter random_PCL_length_range("PCL_length_diff", 0, 0.01); // length diff
+
+	//double this_random_stiff = random_stiff.getValue(u[..]);
+	//double this_random_diss = random_diss.getValue(u[..]);
+	//double this_random_aPCL = random_aPCL_force.getValue(u[..]);
+	//double this_random_pPCL = this_random_aPCL * 0.8363;
+	double this_random_PCL_diff = random_PCL_length_range.getValue(u[0]);
+
+	vector<double> parameters;
+	parameters.push_back((0.031 - 0.005) + this_random_PCL_diff);	// aPCL length
+	parameters.push_back((0.030 - 0.005) + this_random_PCL_diff);	// pPCL length
+	return parameters;
+}
+
+/*
+*	Parameters of sample <i> of the flexion campaign
+*/
+static vector<double> getFlexionParameters(const MCSampler& sampler, int i)
+{
+	vector<double> u;
+	sampler.getSample(i, u);
+	return getFlexionParameters(u);
+}
+
+static vector<string> getFlexionParameterNames()
+{
+	vector<string> parameterNames;
+	parameterNames.push_back("aPCL_length");
+	parameterNames.push_back("pPCL_length");
+	return parameterNames;
+}
+
+static vector<string> getFlexionOutputNames()
+{
+	vector<string> outputNames;
+	outputNames.push_back("aPCL_peak_force");
+	outputNames.push_back("pPCL_peak_force");
+	outputNames.push_back("peak_APT");
+	outputNames.push_back("run_time");
+	return outputNames;
+}
+
+/*
+*	Muscles enabled in the active knee flexion experiment: hamstrings,
+*	gastrocnemii, gracilis and sartorius (driven by the flexion
+*	controller) and quadriceps
+*/
+static vector<string> getFlexionActuatorNames()
+{
+	const char* names[] = {"bifemlh_r", "bifemsh_r", "grac_r", "lat_gas_r", "med_gas_r", "sar_r", "semimem_r",
+		"semiten_r", "rect_fem_r", "vas_med_r", "vas_int_r", "vas_lat_r"};
+	return vector<string>(names, names + 12);
+}
+
+/*
+*	Worker setup of the active knee flexion experiment, the integration
+*	stops out of the <watchdog> budgets
+*/
+static void setupFlexion(Model& model, const MCFidelity& fidelity, const WatchdogSettings& watchdog = WatchdogSettings(false))
+{
+	fidelity.applyToModel(model);
+
+	// init system
+	ProfileScope initSystem("initSystem");
+	model.buildSystem();
+	WatchdogHandler::add(model, watchdog);
+	SimTK::State& si = model.initializeState();
+	initSystem.stop();
+
 	// disable muscles
-	string muscle_name;
+	const vector<string> active = getFlexionActuatorNames();
 	for (int i=0; i<model.getActuators().getSize(); i++)
-	{
-		muscle_name = model.getActuators().get(i).getName();
+		model.getActuators().get(i).setDisabled(si,
+			std::find(active.begin(), active.end(), model.getActuators().get(i).getName()) == active.end());
 
-		model.getActuators().get(i).setDisabled(si, true);
+	// pose of an earlier run, unless the model files, the kinematics table or the pose code changed
+	if (MCModelCache::loadPose(model, si, "flexion"))
+		return;
 
-		if (muscle_name == "bifemlh_r" || muscle_name == "bifemsh_r" || muscle_name == "grac_r" \
-			|| muscle_name == "lat_gas_r" || muscle_name == "med_gas_r" || muscle_name == "sar_r" \
-			|| muscle_name == "semimem_r" || muscle_name == "semiten_r" \
-			|| muscle_name == "rect_fem_r" || muscle_name == "vas_med_r" || muscle_name == "vas_int_r" || muscle_name == "vas_lat_r" )
-				model.getActuators().get(i).setDisabled(si, false);
-	}
+	setHipAngle(model, si, 90);
+	setKneeAngle(model, si, 0, false, false);
+	ProfileScope equilibrate("equilibrateMuscles");
 	model.equilibrateMuscles( si);
+	equilibrate.stop();
+	MCModelCache::savePose(model, si, "flexion");
+}
 
-	Array<double> samplingArray1;
-	Array<double> samplingArray2;	
+void performMCFD_flexion(Model model, int iterations, int numWorkers, unsigned int seed, MCSamplerType samplerType,
+	const MCConvergenceTargets& targets, const vector<int>& samples, const MCFidelity& fidelity, bool workerProcesses,
+	const WatchdogSettings& watchdog)
+{
+	const string outputDir = fidelity.getDirectory(FlexionOutputDir);
+	makeOutputDirectories(outputDir);
 
-    for (int i = 50; i < iterations; i++)
-    {
-		// Add reporters
-		ForceReporter* forceReporter = new ForceReporter(&model);
-		model.addAnalysis(forceReporter);
-		CustomAnalysis* customReporter = new CustomAnalysis(&model, "r");
-		model.addAnalysis(customReporter);
+	// flexion controller 
+	addFlexionController(model);
+
+	// resume the campaign if its manifest exists
+	MCCampaign campaign(outputDir, samplerType, seed, iterations, getFlexionParameterNames());
+	campaign.open();
+
+	std::unique_ptr<MCSampler> sampler(MCSampler::create(samplerType, 1, iterations, campaign.getSeed()));
+
+	// outputs statistics, the campaign stops once their confidence intervals reach the targets
+	MCStatistics statistics(getFlexionOutputNames());
+	statistics.setTargets(targets, samplerType);
+	statistics.setOutputFile(outputDir + "outputs.txt");
+
+	auto getParameters = [&](int i) { return getFlexionParameters(*sampler, i); };
+
+	MCEngine engine(model, numWorkers);
+	campaign.attach(engine, getParameters);
+	// without targets the samples keep the cost order
+	if (statistics.hasTargets())
+		engine.setStopCriterion([&]() { return statistics.isConverged(); });
+	// worker processes append to the outputs file, the statistics are read back from it
+	engine.setProcessWorkers(workerProcesses, [&]() { statistics.reload(); });
+	engine.setWorkerSetup([&](Model& model) { setupFlexion(model, fidelity, watchdog); });
+
+	// expected-long samples first (not with targets), run times learned from the finished samples and while running
+	MCCostModel costModel(sampler->getNumDimensions());
+	costModel.addCampaign(outputDir + "outputs.txt", *sampler);
+	costModel.attach(engine, *sampler);
+
+	engine.run(getRequestedSamples(campaign, samples), [&](Model& model, SimTK::State& si, int i)
+	{
+		vector<double> parameters = getParameters(i);
+		double this_random_aPCL_length = parameters[0];
+		double this_random_pPCL_length = parameters[1];
+
+		// Add reporters, removed from the model of the worker however the sample ends
+		AnalysisGuard analyses(model);
+		ForceReporter* forceReporter = analyses.add(new ForceReporter(&model));
+		CustomAnalysis* customReporter = analyses.add(new CustomAnalysis(&model, "r"));
+		IntegratorTelemetry* telemetry = analyses.add(new IntegratorTelemetry(&model));
 
         //string outputFile = changeToString(i) + "_fd_.sto";
-		//double this_random_stiff = random_stiff(gen);
-		//double this_random_diss = random_diss(gen);
-		//double this_random_aPCL = random_aPCL_force(gen);
-		//double this_random_pPCL = this_random_aPCL * 0.8363;
-		double this_random_PCL_diff = random_PCL_length_range(gen);
-		double this_random_aPCL_length = (0.031 - 0.005) + this_random_PCL_diff;
-		double this_random_pPCL_length = (0.030 - 0.005) + this_random_PCL_diff;
 
+		// ElasticFoundationForce parameters are properties, changing them needs initSystem()
 		//static_cast<OpenSim::ElasticFoundationForce&>( model.updForceSet().get("femur_lat_meniscii_r")).setStiffness(this_random_stiff);
 		//static_cast<OpenSim::ElasticFoundationForce&>( model.updForceSet().get("femur_med_meniscii_r")).setStiffness(this_random_stiff);
 		//static_cast<OpenSim::ElasticFoundationForce&>( model.updForceSet().get("femur_lat_meniscii_r")).setDissipation(this_random_diss);
 		//static_cast<OpenSim::ElasticFoundationForce&>( model.updForceSet().get("femur_med_meniscii_r")).setDissipation(this_random_diss);
-		//static_cast<OpenSim::CustomLigament&>( model.updForceSet().get("aPCL_R")).set_stiffness(this_random_aPCL);
-		//static_cast<OpenSim::CustomLigament&>( model.updForceSet().get("pPCL_R")).set_stiffness(this_random_pPCL);
-		static_cast<OpenSim::CustomLigament&>( model.updForceSet().get("aPCL_R")).setRestingLength(this_random_aPCL_length);
-		static_cast<OpenSim::CustomLigament&>( model.updForceSet().get("pPCL_R")).setRestingLength(this_random_pPCL_length);
-
-		samplingArray1.append(this_random_aPCL_length);
-		samplingArray2.append(this_random_pPCL_length);
-
-		setHipAngle(model, si, 90);
-		setKneeAngle(model, si, 0, false, false);
-		si = model.initSystem();
-		
+		//static_cast<const OpenSim::CustomLigament&>( model.getForceSet().get("aPCL_R")).setStiffness(si, this_random_aPCL);
+		//static_cast<const OpenSim::CustomLigament&>( model.getForceSet().get("pPCL_R")).setStiffness(si, this_random_pPCL);
+		static_cast<const OpenSim::CustomLigament&>( model.getForceSet().get("aPCL_R")).setRestingLength(si, this_random_aPCL_length);
+		static_cast<const OpenSim::CustomLigament&>( model.getForceSet().get("pPCL_R")).setRestingLength(si, this_random_pPCL_length);
 		
 		// Create the integrator and manager for the simulation.
 		SimTK::RungeKuttaMersonIntegrator integrator(model.getMultibodySystem());
 		//integrator.setAccuracy(1.0e-3);
 		//integrator.setFixedStepSize(0.0001);
+		fidelity.applyToIntegrator(integrator);
+		telemetry->setIntegrator(&integrator);
 		Manager manager(model, integrator);
 
 		// Define the initial and final simulation times
 		double initialTime = 0.0;
-		double finalTime = 0.25;
+		double finalTime = fidelity.getFinalTime(0.25);
 
 		// Integrate from initial time to final time
 		manager.setInitialTime(initialTime);
 		manager.setFinalTime(finalTime);
-		std::cout<<"\n\nIntegrating from "<<initialTime<<" to " <<finalTime<<". "<< i <<std::endl;
+		mcLog("Integrating from " + changeToString(initialTime) + " to " + changeToString(finalTime) + ". " + changeToString(i));
 
-		result = std::time(nullptr);
-		std::cout << "\nBefore integrate(si) " << std::asctime(std::localtime(&result)) << endl;
+		WatchdogHandler* watchdogHandler = WatchdogHandler::get(model);
+		if (watchdogHandler)
+			watchdogHandler->reset(si);
 
+		ProfileScope integrate("integrate");
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 		manager.integrate(si);
-
-		result = std::time(nullptr);
-		std::cout << "\nAfter integrate(si) " << std::asctime(std::localtime(&result)) << endl;
+		double runTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		integrate.stop();
 
 		// Save the simulation results
+		ProfileScope fileOutput("file_output");
 		Storage statesDegrees(manager.getStateStorage());
 		//statesDegrees.print("../outputs/MonteCarlo/states_rads/" + changeToString(i) +  "_states_flexion.sto");
 		model.updSimbodyEngine().convertRadiansToDegrees(statesDegrees);
 		statesDegrees.setWriteSIMMHeader(true);
-		statesDegrees.print("../outputs/MC_flexion/MC_PclLength_Flexion_v6/states/" + changeToString(i) + "_states_degrees_flexion.mot");
+		statesDegrees.print(outputDir + "states/" + changeToString(i) + "_states_degrees_flexion.mot");
 		// force reporter results
-		forceReporter->getForceStorage().print("../outputs/MC_flexion/MC_PclLength_Flexion_v6/ForceReporter/" + changeToString(i) + "_force_reporter_flexion.mot");
-		customReporter->print( "../outputs/MC_flexion/MC_PclLength_Flexion_v6/CustomReporter/" + changeToString(i) + "_custom_reporter_flexion.mot");
+		forceReporter->getForceStorage().print(outputDir + "ForceReporter/" + changeToString(i) + "_force_reporter_flexion.mot");
+		customReporter->print( outputDir + "CustomReporter/" + changeToString(i) + "_custom_reporter_flexion.mot");
+		telemetry->print(outputDir + "Telemetry/" + changeToString(i) + "_telemetry_flexion.txt");
+		telemetry->appendToFile(outputDir + "telemetry.txt", i);
+		fileOutput.stop();
+		checkWatchdog(model, si, outputDir, i);
+
+		vector<double> outputs;
+		outputs.push_back(getPeakValue(customReporter->m_storage, "aPCL_R_force"));
+		outputs.push_back(getPeakValue(customReporter->m_storage, "pPCL_R_force"));
+		outputs.push_back(getPeakValue(customReporter->m_storage, "APT", true));
+		outputs.push_back(runTime);
 
-		model.removeAnalysis(forceReporter);
-		model.removeAnalysis(customReporter);
+		statistics.add(i, outputs);
+		appendSampleToFile(outputDir + "aPCL_length.txt", i, this_random_aPCL_length);
+		appendSampleToFile(outputDir + "pPCL_length.txt", i, this_random_pPCL_length);
+	});
 
-		writeArrayToFile("../outputs/MC_flexion/MC_PclLength_Flexion_v6/aPCL_length.txt", samplingArray1);
-		writeArrayToFile("../outputs/MC_flexion/MC_PclLength_Flexion_v6/pPCL_length.txt", samplingArray2);
-    }
+	statistics.printSummary(outputDir + "statistics.txt");
+	statistics.logSummary();
+	summarizeTelemetry(outputDir);
 
+	// where the time of the campaign went
+	Profiler::print(outputDir + "profile");
+	Profiler::reset();
 }
 
-void performMCFD_atl(Model model, int iterations)
+/*
+*	Sampled parameters of the anterior tibial loads campaign: aACL and
+*	pACL resting lengths at the point <u> of the unit hypercube
+*/
+static vector<double> getAtlParameters(const vector<double>& u)
 {
-	// gaussian distribution setup
-    std::default_random_engine gen;
-	random_device rd;
-    gen.seed(rd());
-	//std::uniform_real_distribution<double> random_stiff(5*1.e8, 5*1.e9);
-	//std::uniform_real_distribution<double> random_diss(0.0, 20.0);
-	//std::uniform_real_distribution<double> random_aACL_force(1300,1700);
-	std::uniform_real_distribution<double> random_ACL_length_range(0, 0.005); // length diff
+	// sampled parameters
+	//MCParameter random_stiff("stiffness", 5*1.e8, 5*1.e9);
+	//MCParameter random_diss("dissipation", 0.0, 20.0);
+	//MCParameter random_aACL_force("aACL_stiffness", 1300, 1700);
+	MCParameter random_ACL_length_range("ACL_length_diff", 0, 0.005); // length diff
 
-	// init system
-	std::time_t result = std::time(nullptr);
-	std::cout << "\nBefore initSystem() " << std::asctime(std::localtime(&result)) << endl;
-	SimTK::State& si = model.initSystem();
-	result = std::time(nullptr);
-	std::cout << "\nAfter initSystem() " << std::asctime(std::localtime(&result)) << endl;
-	
-	// set gravity	
-	model.updGravityForce().setGravityVector(si, Vec3(0,0,0));
+	//double this_random_stiff = random_stiff.getValue(u[..]);
+	//double this_random_diss = random_diss.getValue(u[..]);
+	//double this_random_aACL = random_aACL_force.getValue(u[..]);
+	//double this_random_pACL = this_random_aACL * 1.266;
+	double this_random_ACL_diff = random_ACL_length_range.getValue(u[0]);
 
-	model.equilibrateMuscles( si);
+	vector<double> parameters;
+	parameters.push_back((0.031 - 0.0025) + this_random_ACL_diff);	// aACL length
+	parameters.push_back((0.0253 - 0.0025) + this_random_ACL_diff);	// pACL length
+	return parameters;
+}
 
-	Array<double> samplingArray1;
-	Array<double> samplingArray2;	
+/*
+*	Parameters of sample <i> of the anterior tibial loads campaign
+*/
+static vector<double> getAtlParameters(const MCSampler& sampler, int i)
+{
+	vector<double> u;
+	sampler.getSample(i, u);
+	return getAtlParameters(u);
+}
 
-    for (int i = 20; i < iterations; i++)
-    {
-		double kneeAngle [6] = {0, -15, -30, -60, -90};
+static vector<string> getAtlParameterNames()
+{
+	vector<string> parameterNames;
+	parameterNames.push_back("aACL_length");
+	parameterNames.push_back("pACL_length");
+	return parameterNames;
+}
+
+static vector<string> getAtlOutputNames()
+{
+	vector<string> outputNames;
+	outputNames.push_back("aACL_peak_force");
+	outputNames.push_back("pACL_peak_force");
+	outputNames.push_back("peak_APT");
+	outputNames.push_back("run_time");
+	return outputNames;
+}
+
+void performMCFD_atl(Model model, int iterations, int numWorkers, unsigned int seed, MCSamplerType samplerType,
+	const MCConvergenceTargets& targets, const vector<int>& samples, const MCFidelity& fidelity, bool workerProcesses,
+	const WatchdogSettings& watchdog)
+{
+	const string outputDir = fidelity.getDirectory(AtlOutputDir);
+	makeOutputDirectories(outputDir);
+
+	//double kneeAngle [6] = {0, -15, -30, -60, -90};
+	const double kneeAngle = -60;
+
+	// resume the campaign if its manifest exists
+	MCCampaign campaign(outputDir, samplerType, seed, iterations, getAtlParameterNames());
+	campaign.open();
+
+	std::unique_ptr<MCSampler> sampler(MCSampler::create(samplerType, 1, iterations, campaign.getSeed()));
+
+	// outputs statistics, the campaign stops once their confidence intervals reach the targets
+	MCStatistics statistics(getAtlOutputNames());
+	statistics.setTargets(targets, samplerType);
+	statistics.setOutputFile(outputDir + "outputs.txt");
+
+	auto getParameters = [&](int i) { return getAtlParameters(*sampler, i); };
+
+	MCEngine engine(model, numWorkers);
+	campaign.attach(engine, getParameters);
+	// without targets the samples keep the cost order
+	if (statistics.hasTargets())
+		engine.setStopCriterion([&]() { return statistics.isConverged(); });
+	// worker processes append to the outputs file, the statistics are read back from it
+	engine.setProcessWorkers(workerProcesses, [&]() { statistics.reload(); });
+	engine.setWorkerSetup([&](Model& model) { setupAnteriorTibialLoads(model, kneeAngle, fidelity, SteadyStateSettings(), watchdog); });
 
-		//double this_random_stiff = random_stiff(gen);
-		//double this_random_diss = random_diss(gen);
-		//double this_random_aACL = random_aACL_force(gen);
-		//double this_random_pACL = this_random_aACL * 1.266;
-		double this_random_ACL_diff = random_ACL_length_range(gen);
-		double this_random_aACL_length = (0.031 - 0.0025) + this_random_ACL_diff;
-		double this_random_pACL_length = (0.0253 - 0.0025) + this_random_ACL_diff;
+	// expected-long samples first (not with targets), run times learned from the finished samples and while running
+	MCCostModel costModel(sampler->getNumDimensions());
+	costModel.addCampaign(outputDir + "outputs.txt", *sampler);
+	costModel.attach(engine, *sampler);
 
+	engine.run(getRequestedSamples(campaign, samples), [&](Model& model, SimTK::State& si, int i)
+	{
+		vector<double> parameters = getParameters(i);
+		double this_random_aACL_length = parameters[0];
+		double this_random_pACL_length = parameters[1];
+
+		// ElasticFoundationForce parameters are properties, changing them needs initSystem()
 		//static_cast<OpenSim::ElasticFoundationForce&>( model.updForceSet().get("femur_lat_meniscii_r")).setStiffness(this_random_stiff);
 		//static_cast<OpenSim::ElasticFoundationForce&>( model.updForceSet().get("femur_med_meniscii_r")).setStiffness(this_random_stiff);
 		//static_cast<OpenSim::ElasticFoundationForce&>( model.updForceSet().get("femur_lat_meniscii_r")).setDissipation(this_random_diss);
 		//static_cast<OpenSim::ElasticFoundationForce&>( model.updForceSet().get("femur_med_meniscii_r")).setDissipation(this_random_diss);
-		//static_cast<OpenSim::CustomLigament&>( model.updForceSet().get("aACL_R")).set_stiffness(this_random_aACL);
-		//static_cast<OpenSim::CustomLigament&>( model.updForceSet().get("pACL_R")).set_stiffness(this_random_pACL);
-		static_cast<OpenSim::CustomLigament&>( model.updForceSet().get("aACL_R")).setRestingLength(this_random_aACL_length);
-		static_cast<OpenSim::CustomLigament&>( model.updForceSet().get("pACL_R")).setRestingLength(this_random_pACL_length);
+		//static_cast<const OpenSim::CustomLigament&>( model.getForceSet().get("aACL_R")).setStiffness(si, this_random_aACL);
+		//static_cast<const OpenSim::CustomLigament&>( model.getForceSet().get("pACL_R")).setStiffness(si, this_random_pACL);
+		static_cast<const OpenSim::CustomLigament&>( model.getForceSet().get("aACL_R")).setRestingLength(si, this_random_aACL_length);
+		static_cast<const OpenSim::CustomLigament&>( model.getForceSet().get("pACL_R")).setRestingLength(si, this_random_pACL_length);
 
-		samplingArray1.append(this_random_aACL_length);
-		samplingArray2.append(this_random_pACL_length);
+		// Add reporters, removed from the model of the worker however the sample ends
+		AnalysisGuard analyses(model);
+		ForceReporter* forceReporter = analyses.add(new ForceReporter(&model));
+		CustomAnalysis* customReporter = analyses.add(new CustomAnalysis(&model, "r"));
+		IntegratorTelemetry* telemetry = analyses.add(new IntegratorTelemetry(&model));
 
-		for (int j=3; j<4; j++)
-		{
-			// Add reporters
-			ForceReporter* forceReporter = new ForceReporter(&model);
-			model.addAnalysis(forceReporter);
-			CustomAnalysis* customReporter = new CustomAnalysis(&model, "r");
-			model.addAnalysis(customReporter);
-
-			//string outputFile = changeToString(i) + "_fd_.sto";
-
-			// edit prescribed force for anterior tibial load
-			addTibialLoads(model, kneeAngle[j]);	
-			si = model.initSystem();
-			setKneeAngle(model, si, kneeAngle[j], true, true);
+		//string outputFile = changeToString(i) + "_fd_.sto";
 		
-			// Create the integrator and manager for the simulation.
-			SimTK::RungeKuttaMersonIntegrator integrator(model.getMultibodySystem());
-			//integrator.setAccuracy(1.0e-3);
-			//integrator.setFixedStepSize(0.0001);
-			Manager manager(model, integrator);
-
-			// Define the initial and final simulation times
-			double initialTime = 0.0;
-			double finalTime = 0.8;
-
-			// Integrate from initial time to final time
-			manager.setInitialTime(initialTime);
-			manager.setFinalTime(finalTime);
-			std::cout<<"\n\nIntegrating from "<<initialTime<<" to " <<finalTime<<". "<< i <<std::endl;
-
-			result = std::time(nullptr);
-			std::cout << "\nBefore integrate(si) " << std::asctime(std::localtime(&result)) << endl;
-
-			manager.integrate(si);
-
-			result = std::time(nullptr);
-			std::cout << "\nAfter integrate(si) " << std::asctime(std::localtime(&result)) << endl;
-
-			// Save the simulation results
-			Storage statesDegrees(manager.getStateStorage());
-			//statesDegrees.print("../outputs/MonteCarlo/states_rads/" + changeToString(i) +  "_states_flexion.sto");
-			model.updSimbodyEngine().convertRadiansToDegrees(statesDegrees);
-			statesDegrees.setWriteSIMMHeader(true);
-			statesDegrees.print("../outputs/MC_anterior_loads/MC_AclLength_Atl_v6/states/" + changeToString(i) + "_states_degrees_atl_" + changeToString(abs(kneeAngle[j])) + ".mot" );
-			// force reporter results
-			forceReporter->getForceStorage().print("../outputs/MC_anterior_loads/MC_AclLength_Atl_v6/ForceReporter/" + changeToString(i) + "_force_reporter_atl_" + changeToString(abs(kneeAngle[j])) + ".mot");
-			customReporter->print( "../outputs/MC_anterior_loads/MC_AclLength_Atl_v6/CustomReporter/" + changeToString(i) + "_custom_reporter_atl_" + changeToString(abs(kneeAngle[j])) + ".mot");
-
-			model.removeAnalysis(forceReporter);
-			model.removeAnalysis(customReporter);
-
-			writeArrayToFile("../outputs/MC_anterior_loads/MC_AclLength_Atl_v6/aACL_length.txt", samplingArray1);
-			writeArrayToFile("../outputs/MC_anterior_loads/MC_AclLength_Atl_v6/pACL_length.txt", samplingArray2);
+		// Create the integrator and manager for the simulation.
+		SimTK::RungeKuttaMersonIntegrator integrator(model.getMultibodySystem());
+		//integrator.setAccuracy(1.0e-3);
+		//integrator.setFixedStepSize(0.0001);
+		fidelity.applyToIntegrator(integrator);
+		telemetry->setIntegrator(&integrator);
+		Manager manager(model, integrator);
+
+		// Define the initial and final simulation times
+		double initialTime = 0.0;
+		double finalTime = fidelity.getFinalTime(0.8);
+
+		// Integrate from initial time to final time
+		manager.setInitialTime(initialTime);
+		manager.setFinalTime(finalTime);
+		mcLog("Integrating from " + changeToString(initialTime) + " to " + changeToString(finalTime) + ". " + changeToString(i));
+
+		SteadyStateHandler* steadyState = SteadyStateHandler::get(model);
+		if (steadyState)
+			steadyState->reset(si);
+		WatchdogHandler* watchdogHandler = WatchdogHandler::get(model);
+		if (watchdogHandler)
+			watchdogHandler->reset(si);
+
+		ProfileScope integrate("integrate");
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		manager.integrate(si);
+		double runTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		integrate.stop();
+
+		if (steadyState)
+			mcLog("Sample " + changeToString(i) + ": " + steadyState->getReport());
+
+		// Save the simulation results
+		ProfileScope fileOutput("file_output");
+		Storage statesDegrees(manager.getStateStorage());
+		//statesDegrees.print("../outputs/MonteCarlo/states_rads/" + changeToString(i) +  "_states_flexion.sto");
+		model.updSimbodyEngine().convertRadiansToDegrees(statesDegrees);
+		statesDegrees.setWriteSIMMHeader(true);
+		statesDegrees.print(outputDir + "states/" + changeToString(i) + "_states_degrees_atl_" + changeToString(abs(kneeAngle)) + ".mot" );
+		// force reporter results
+		forceReporter->getForceStorage().print(outputDir + "ForceReporter/" + changeToString(i) + "_force_reporter_atl_" + changeToString(abs(kneeAngle)) + ".mot");
+		customReporter->print( outputDir + "CustomReporter/" + changeToString(i) + "_custom_reporter_atl_" + changeToString(abs(kneeAngle)) + ".mot");
+		telemetry->print(outputDir + "Telemetry/" + changeToString(i) + "_telemetry_atl_" + changeToString(abs(kneeAngle)) + ".txt");
+		telemetry->appendToFile(outputDir + "telemetry.txt", i);
+		fileOutput.stop();
+		checkWatchdog(model, si, outputDir, i);
+
+		vector<double> outputs;
+		outputs.push_back(getPeakValue(customReporter->m_storage, "aACL_R_force"));
+		outputs.push_back(getPeakValue(customReporter->m_storage, "pACL_R_force"));
+		outputs.push_back(getPeakValue(customReporter->m_storage, "APT", true));
+		outputs.push_back(runTime);
+
+		statistics.add(i, outputs);
+		appendSampleToFile(outputDir + "aACL_length.txt", i, this_random_aACL_length);
+		appendSampleToFile(outputDir + "pACL_length.txt", i, this_random_pACL_length);
+	});
+
+	statistics.printSummary(outputDir + "statistics.txt");
+	statistics.logSummary();
+	summarizeTelemetry(outputDir);
+
+	// where the time of the campaign went
+	Profiler::print(outputDir + "profile");
+	Profiler::reset();
+}
+
+/*
+*	Integrate <si> with <integrator> up to <finalTime> (or the steady
+*	state, see SteadyStateHandler), the peak of every CustomAnalysis
+*	channel is an output
+*/
+static void integratePeakOutputs(Model& model, SimTK::State& si, SimTK::Integrator& integrator, double finalTime,
+	MCOutputs& outputs)
+{
+	AnalysisGuard analyses(model);
+	CustomAnalysis* customReporter = analyses.add(new CustomAnalysis(&model, "r"));
+
+	Manager manager(model, integrator);
+	manager.setInitialTime(0.0);
+	manager.setFinalTime(finalTime);
+	if (SteadyStateHandler::get(model))
+		SteadyStateHandler::get(model)->reset(si);
+	ProfileScope integrate("integrate");
+	manager.integrate(si);
+	integrate.stop();
+
+	addPeakOutputs(customReporter->m_storage, outputs);
+}
+
+/*
+*	Same with the knee subcycled by <integrator>
+*/
+static void integratePeakOutputs(Model& model, SimTK::State& si, MultiRateKneeIntegrator& integrator, double finalTime,
+	MCOutputs& outputs)
+{
+	AnalysisGuard analyses(model);
+	CustomAnalysis* customReporter = analyses.add(new CustomAnalysis(&model, "r"));
+
+	if (SteadyStateHandler::get(model))
+		SteadyStateHandler::get(model)->reset(si);
+	ProfileScope integrate("integrate");
+	integrator.integrate(si, finalTime);
+	integrate.stop();
+
+	addPeakOutputs(customReporter->m_storage, outputs);
+}
+
+/*
+*	Anterior tibial loads simulation of <si>, the peak of every
+*	CustomAnalysis channel is an output
+*/
+static void simulateAnteriorTibialLoads(Model& model, SimTK::State& si, MCOutputs& outputs)
+{
+	SimTK::RungeKuttaMersonIntegrator integrator(model.getMultibodySystem());
+	integratePeakOutputs(model, si, integrator, 0.8, outputs);
+}
+
+/*
+*	Anterior tibial loads sample of <si> solved for the equilibrium of the
+*	free knee coordinates, the CustomAnalysis channels at the equilibrium
+*	are the outputs
+*/
+static void solveAnteriorTibialLoads(Model& model, SimTK::State& si, MCOutputs& outputs,
+	const string& reporterFile = "")
+{
+	QuasiStaticSolver solver(model);
+	solver.addFreeCoordinates(si, "knee_r");
+	ProfileScope solve("quasi_static_solve");
+	QuasiStaticResult equilibrium = solver.solve(si);
+	solve.stop();
+	mcLog(QuasiStaticSolver::getReport(equilibrium));
+	if (!equilibrium.converged)
+		throw OpenSim::Exception("MonteCarloFD: no quasi-static equilibrium, " + QuasiStaticSolver::getReport(equilibrium));
+
+	AnalysisGuard analyses(model);
+	CustomAnalysis* customReporter = analyses.add(new CustomAnalysis(&model, "r"));
+	customReporter->begin(si);
+	customReporter->end(si);
+
+	if (!reporterFile.empty())
+	{
+		ProfileScope fileOutput("file_output");
+		customReporter->print(reporterFile);
+	}
+	addPeakOutputs(customReporter->m_storage, outputs);
+}
+
+/*
+*	Value of each of <outputNames> in <outputs>
+*/
+static vector<double> getOutputValues(const MCOutputs& outputs, const vector<string>& outputNames)
+{
+	vector<double> values;
+	for (unsigned int o=0; o<outputNames.size(); o++)
+	{
+		vector<string>::const_iterator it = std::find(outputs.names.begin(), outputs.names.end(), outputNames[o]);
+		if (it == outputs.names.end())
+			throw OpenSim::Exception("MonteCarloFD: no output " + outputNames[o]);
+		values.push_back(outputs.values[it - outputs.names.begin()]);
+	}
+	return values;
+}
+
+/*
+*	Sobol indices of the outputs of <simulate> with respect to <parameters>,
+*	printed in <outputDir>
+*/
+static void performSensitivity(const Model& model, const vector<MCModelParameter>& parameters, int numBaseSamples,
+	int numWorkers, const string& outputDir, const MCWorkerSetup& setup, const MCOutputTask& simulate)
+{
+	IO::makeDir(outputDir);
+
+	MCSensitivity sensitivity(model, parameters, numWorkers);
+	// also called again when a contact parameter is sampled
+	sensitivity.setWorkerSetup(setup);
+
+	sensitivity.run(numBaseSamples, [&](Model& model, SimTK::State& si, int i, MCOutputs& outputs)
+	{
+		simulate(model, si, i, outputs);
+		mcLog("Sensitivity simulation " + changeToString(i) + " of " + changeToString(sensitivity.getNumEvaluations()) + " done");
+	});
+
+	sensitivity.printIndices(outputDir + "sensitivity_indices.txt");
+	sensitivity.printEvaluations(outputDir + "sensitivity_evaluations.txt");
+}
+
+void performMCSensitivity_atl(Model model, const vector<MCModelParameter>& parameters, int numBaseSamples, int numWorkers)
+{
+	const double kneeAngle = -60;
+
+	performSensitivity(model, parameters, numBaseSamples, numWorkers, "../outputs/MC_anterior_loads/Sensitivity_Atl/",
+		[&](Model& model) { setupAnteriorTibialLoads(model, kneeAngle); },
+		[&](Model& model, SimTK::State& si, int i, MCOutputs& outputs) { simulateAnteriorTibialLoads(model, si, outputs); });
+}
+
+/*
+*	Polynomial chaos surrogate of <outputName> over the first parameter of
+*	the campaign in <outputDir> (the others follow it), fitted to its
+*	finished samples and saved there. Its bounds are the parameter at the
+*	corners of the unit hypercube. Returns the <count> pending samples that
+*	improve it most
+*/
+static vector<int> performSurrogate(const string& outputDir, const vector<string>& parameterNames,
+	const std::function<vector<double>(const vector<double>& u)>& getParameters, int iterations, int count,
+	const string& outputName, int degree, MCSamplerType samplerType)
+{
+	vector<string> inputNames(1, parameterNames[0]);
+
+	// the campaign must exist, its seed is read from the manifest
+	MCCampaign campaign(outputDir, samplerType, 0, iterations, parameterNames);
+	campaign.open();
+	std::unique_ptr<MCSampler> sampler(MCSampler::create(samplerType, 1, iterations, campaign.getSeed()));
+
+	vector<vector<double> > x;
+	vector<double> y;
+	MCSurrogate::readCampaign(outputDir, inputNames, outputName, x, y);
+
+	const int numDimensions = sampler->getNumDimensions();
+	const double lower = getParameters(vector<double>(numDimensions, 0))[0];
+	const double upper = getParameters(vector<double>(numDimensions, 1))[0];
+	MCSurrogate surrogate(degree);
+	surrogate.setInputBounds(vector<double>(1, std::min(lower, upper)), vector<double>(1, std::max(lower, upper)));
+	surrogate.fit(inputNames, outputName, x, y);
+	surrogate.save(outputDir + "surrogate_" + outputName + ".txt");
+
+	// active learning among the samples not simulated yet
+	vector<int> pending = campaign.getPendingSamples();
+	vector<vector<double> > candidates;
+	vector<double> u;
+	for (unsigned int p=0; p<pending.size(); p++)
+	{
+		sampler->getSample(pending[p], u);
+		candidates.push_back(vector<double>(1, getParameters(u)[0]));
+	}
+
+	vector<int> selected = surrogate.selectSamples(candidates, count);
+	vector<int> samples;
+	for (unsigned int s=0; s<selected.size(); s++)
+		samples.push_back(pending[selected[s]]);
+	return samples;
+}
+
+vector<int> performMCSurrogate_atl(int iterations, int count, const string& outputName, int degree,
+	MCSamplerType samplerType)
+{
+	// input: the aACL length (the pACL length differs by a constant)
+	return performSurrogate(AtlOutputDir, getAtlParameterNames(),
+		[](const vector<double>& u) { return getAtlParameters(u); }, iterations, count, outputName, degree, samplerType);
+}
+
+vector<int> performMCSurrogate_flexion(int iterations, int count, const string& outputName, int degree,
+	MCSamplerType samplerType)
+{
+	// input: the aPCL length (the pPCL length differs by a constant)
+	return performSurrogate(FlexionOutputDir, getFlexionParameterNames(),
+		[](const vector<double>& u) { return getFlexionParameters(u); }, iterations, count, outputName, degree,
+		samplerType);
+}
+
+/*
+*	Probability that output <outputName> of <simulate> exceeds <threshold>,
+*	printed in <outputDir> with every simulation of the estimation
+*/
+static MCRareEventResult performRareEvent(const Model& model, const vector<MCModelParameter>& parameters,
+	const string& outputName, double threshold, MCRareEventMethod method, const MCRareEventSettings& settings,
+	int numWorkers, const string& outputDir, const MCWorkerSetup& setup, const MCOutputTask& simulate)
+{
+	IO::makeDir(outputDir);
+
+	MCEngine engine(model, numWorkers);
+	engine.setWorkerSetup(setup);
+
+	// every simulation of the estimation, parameters and response
+	vector<string> outputNames;
+	for (unsigned int p=0; p<parameters.size(); p++)
+		outputNames.push_back(parameters[p].name);
+	outputNames.push_back(outputName);
+	MCStatistics evaluations(outputNames);
+	evaluations.setOutputFile(outputDir + "rare_event_" + getRareEventMethodName(method) + "_evaluations.txt");
+	int numEvaluations = 0;
+
+	// one parallel campaign per batch of points of the standard normal space
+	MCBatchResponse response = [&](const vector<vector<double> >& z, vector<double>& g)
+	{
+		vector<int> batch;
+		for (unsigned int i=0; i<z.size(); i++)
+			batch.push_back(i);
+
+		engine.run(batch, [&](Model& model, SimTK::State& si, int i)
+		{
+			vector<double> u;
+			getUniformFromNormal(z[i], u);
+			vector<double> values;
+			for (unsigned int p=0; p<parameters.size(); p++)
+				values.push_back(parameters[p].getValue(u[p]));
+			applyModelParameters(parameters, values, model, si, setup);
+
+			MCOutputs outputs;
+			simulate(model, si, numEvaluations + i, outputs);
+			g[i] = getOutputValues(outputs, vector<string>(1, outputName))[0];
+
+			values.push_back(g[i]);
+			evaluations.add(numEvaluations + i, values);
+		});
+		numEvaluations += (int)z.size();
+	};
+
+	MCRareEventResult result = estimateRareEvent(method, response, (int)parameters.size(), threshold, settings);
+
+	mcLog("P[" + outputName + " > " + changeToString(threshold) + "] = " + changeToString(result.probability)
+		+ ", CoV " + changeToString(result.cov) + ", " + changeToString(result.numEvaluations) + " simulations");
+	printRareEventResult(result, outputDir + "rare_event_" + getRareEventMethodName(method) + ".txt");
+	return result;
+}
+
+MCRareEventResult performMCRareEvent_atl(Model model, const vector<MCModelParameter>& parameters,
+	const string& outputName, double threshold, MCRareEventMethod method,
+	const MCRareEventSettings& settings, int numWorkers)
+{
+	const double kneeAngle = -60;
+
+	return performRareEvent(model, parameters, outputName, threshold, method, settings, numWorkers,
+		"../outputs/MC_anterior_loads/RareEvent_Atl/",
+		[&](Model& model) { setupAnteriorTibialLoads(model, kneeAngle); },
+		[&](Model& model, SimTK::State& si, int i, MCOutputs& outputs) { simulateAnteriorTibialLoads(model, si, outputs); });
+}
+
+/*
+*	Run <samples> of a campaign at <fidelity> with seed <seed>
+*/
+typedef std::function<void(const vector<int>& samples, const MCFidelity& fidelity, unsigned int seed)> MCCampaignRun;
+
+/*
+*	Two fidelity Monte Carlo: a pilot of <numHigh> samples at both
+*	fidelities gives the correlation and cost of each output, the number
+*	of low fidelity samples is chosen from them (at most <maxLow>) and the
+*	control variate estimates are written to <outputDir>multifidelity.txt.
+*	Each fidelity is a campaign of its own subdirectory, the regular
+*	campaign of <outputDir> is left alone
+*/
+static void performMultiFidelity(const string& outputDir, const vector<string>& outputNames, int numHigh, int maxLow,
+	const MCFidelity& lowFidelity, unsigned int seed, const MCCampaignRun& runCampaign)
+{
+	// full fidelity under a name of its own
+	const MCFidelity highFidelity("high_fidelity", 0, 0);
+	if (lowFidelity.isFull() || lowFidelity.name == highFidelity.name)
+		throw OpenSim::Exception("performMultiFidelity: the low fidelity needs a name other than " + highFidelity.name);
+	const string highDir = highFidelity.getDirectory(outputDir);
+	const string lowDir = lowFidelity.getDirectory(outputDir);
+
+	vector<int> pilot;
+	for (int i=0; i<numHigh; i++)
+		pilot.push_back(i);
+
+	// same seed at both fidelities, sample i has the same parameters
+	runCampaign(pilot, highFidelity, seed);
+	seed = MCCampaign::readSeed(highDir);
+	runCampaign(pilot, lowFidelity, seed);
+
+	auto getMeanTime = [&](const string& directory)
+	{
+		map<int, double> times = MCStatistics::readOutputs(directory + "outputs.txt", "run_time");
+		double sum = 0;
+		for (map<int, double>::const_iterator it = times.begin(); it != times.end(); ++it)
+			sum += it->second;
+		return times.empty() ? SimTK::NaN : sum / times.size();
+	};
+	const double costHigh = getMeanTime(highDir);
+	const double costLow = getMeanTime(lowDir);
+
+	// paired outputs of samples < numLow
+	auto getPaired = [&](const string& output, int numLow, vector<double>& high, vector<double>& lowPaired, vector<double>& lowAll)
+	{
+		map<int, double> highValues = MCStatistics::readOutputs(highDir + "outputs.txt", output);
+		map<int, double> lowValues = MCStatistics::readOutputs(lowDir + "outputs.txt", output);
+		high.clear(); lowPaired.clear(); lowAll.clear();
+		for (map<int, double>::const_iterator it = lowValues.begin(); it != lowValues.end(); ++it)
+		{
+			if (it->first >= numLow)
+				continue;
+			lowAll.push_back(it->second);
+			map<int, double>::const_iterator h = highValues.find(it->first);
+			if (h != highValues.end() && h->first < numHigh)
+			{
+				high.push_back(h->second);
+				lowPaired.push_back(it->second);
+			}
 		}
-    }
+	};
+
+	// allocation: the output that needs most low fidelity samples
+	int numLow = numHigh;
+	for (unsigned int o=0; o<outputNames.size(); o++)
+	{
+		if (outputNames[o] == "run_time")
+			continue;
+		vector<double> high, lowPaired, lowAll;
+		getPaired(outputNames[o], numHigh, high, lowPaired, lowAll);
+		MCMultiFidelityEstimate pilotEstimate = estimateMultiFidelity(high, lowPaired, lowPaired);
+		numLow = std::max(numLow, getOptimalNumLowFidelity(numHigh, pilotEstimate.correlation, costHigh, costLow));
+	}
+	numLow = std::min(numLow, maxLow);
+	mcLog("Multi-fidelity: cost ratio " + changeToString(costHigh / costLow) + ", "
+		+ changeToString(numHigh) + " high and " + changeToString(numLow) + " low fidelity samples");
+
+	vector<int> lowSamples;
+	for (int i=0; i<numLow; i++)
+		lowSamples.push_back(i);
+	runCampaign(lowSamples, lowFidelity, seed);
+
+	ofstream file((outputDir + "multifidelity.txt").c_str());
+	// Labels
+	file << "output\tmean\tvariance\thigh_fidelity_mean\thigh_fidelity_variance\talpha\tcorrelation"
+		<< "\thigh_samples\tlow_samples\tcost_high\tcost_low" << endl;
+	for (unsigned int o=0; o<outputNames.size(); o++)
+	{
+		if (outputNames[o] == "run_time")
+			continue;
+		vector<double> high, lowPaired, lowAll;
+		getPaired(outputNames[o], numLow, high, lowPaired, lowAll);
+		MCMultiFidelityEstimate estimate = estimateMultiFidelity(high, lowPaired, lowAll);
+		file << outputNames[o] << "\t" << estimate.mean << "\t" << estimate.variance
+			<< "\t" << estimate.highFidelityMean << "\t" << estimate.highFidelityVariance
+			<< "\t" << estimate.alpha << "\t" << estimate.correlation << "\t" << estimate.numHigh
+			<< "\t" << estimate.numLow << "\t" << costHigh << "\t" << costLow << endl;
+	}
+	file.close();
+}
+
+void performMCMultiFidelity_flexion(Model model, int numHigh, int maxLow, const MCFidelity& lowFidelity,
+	int numWorkers, unsigned int seed, MCSamplerType samplerType)
+{
+	performMultiFidelity(FlexionOutputDir, getFlexionOutputNames(), numHigh, maxLow, lowFidelity, seed,
+		[&](const vector<int>& samples, const MCFidelity& fidelity, unsigned int campaignSeed)
+	{
+		performMCFD_flexion(model, maxLow, numWorkers, campaignSeed, samplerType, MCConvergenceTargets(), samples, fidelity);
+	});
+}
+
+void performMCMultiFidelity_atl(Model model, int numHigh, int maxLow, const MCFidelity& lowFidelity,
+	int numWorkers, unsigned int seed, MCSamplerType samplerType)
+{
+	performMultiFidelity(AtlOutputDir, getAtlOutputNames(), numHigh, maxLow, lowFidelity, seed,
+		[&](const vector<int>& samples, const MCFidelity& fidelity, unsigned int campaignSeed)
+	{
+		performMCFD_atl(model, maxLow, numWorkers, campaignSeed, samplerType, MCConvergenceTargets(), samples, fidelity);
+	});
+}
+
+//=============================================================================
+// INTEGRATOR BENCHMARKS
+//=============================================================================
+static const string BenchmarkOutputDir = "../outputs/IntegratorBenchmark/";
+
+/*
+*	Run the default integrator settings on a task, print the comparison
+*	and the recommended setting to <fileName>
+*/
+static void benchmarkIntegrators(IntegratorBenchmark& benchmark, const vector<string>& outputNames,
+	const string& fileName, double tolerance)
+{
+	benchmark.addDefaultSettings();
+	benchmark.run(outputNames);
 
-}
\ No newline at end of file
+	IO::makeDir(BenchmarkOutputDir);
+	benchmark.print(BenchmarkOutputDir + fileName, tolerance);
+}
+
+void benchmarkIntegrators_atl(Model model, double tolerance)
+{
+	const double kneeAngle = -60;
+
+	IntegratorBenchmark benchmark(model, [&](Model& model) { setupAnteriorTibialLoads(model, kneeAngle); },
+		[](Model& model, SimTK::State& si, SimTK::Integrator& integrator, MCOutputs& outputs)
+	{
+		integratePeakOutputs(model, si, integrator, 0.8, outputs);
+	});
+	benchmark.setMultiRateTask([](Model& model, SimTK::State& si, MultiRateKneeIntegrator& integrator, MCOutputs& outputs)
+	{
+		integratePeakOutputs(model, si, integrator, 0.8, outputs);
+	});
+
+	vector<string> outputNames;
+	outputNames.push_back("aACL_R_force");
+	outputNames.push_back("pACL_R_force");
+	outputNames.push_back("APT");
+	benchmarkIntegrators(benchmark, outputNames, "integrators_atl.txt", tolerance);
+}
+
+void benchmarkIntegrators_flexion(Model model, double tolerance)
+{
+	addFlexionController(model);
+
+	IntegratorBenchmark benchmark(model, [](Model& model) { setupFlexion(model, MCFidelity()); },
+		[](Model& model, SimTK::State& si, SimTK::Integrator& integrator, MCOutputs& outputs)
+	{
+		integratePeakOutputs(model, si, integrator, 0.25, outputs);
+	});
+	benchmark.setMultiRateTask([](Model& model, SimTK::State& si, MultiRateKneeIntegrator& integrator, MCOutputs& outputs)
+	{
+		integratePeakOutputs(model, si, integrator, 0.25, outputs);
+	});
+
+	vector<string> outputNames;
+	outputNames.push_back("aPCL_R_force");
+	outputNames.push_back("pPCL_R_force");
+	outputNames.push_back("APT");
+	benchmarkIntegrators(benchmark, outputNames, "integrators_flexion.txt", tolerance);
+}
+
+//=============================================================================
+// FORCE COSTS
+//=============================================================================
+static const string ForceCostOutputDir = "../outputs/ForceCosts/";
+
+/*
+*	Simulate the task set up on <model> with a Runge-Kutta-Merson
+*	integrator, profiling the cost of the forces over the run, and print
+*	them to <fileName>
+*/
+static void measureForceCosts(Model& model, double finalTime, const string& fileName)
+{
+	SimTK::State& si = model.updWorkingState();
+	AnalysisGuard analyses(model);
+	ForceCostProfiler* profiler = analyses.add(new ForceCostProfiler(&model));
+
+	SimTK::RungeKuttaMersonIntegrator integrator(model.getMultibodySystem());
+	MCOutputs outputs;
+	integratePeakOutputs(model, si, integrator, finalTime, outputs);
+
+	IO::makeDir(ForceCostOutputDir);
+	profiler->print(ForceCostOutputDir + fileName);
+	mcLog(profiler->getSummary());
+}
+
+void measureForceCosts_atl(Model model)
+{
+	setupAnteriorTibialLoads(model, -60);
+	measureForceCosts(model, 0.8, "force_costs_atl.txt");
+}
+
+void measureForceCosts_flexion(Model model)
+{
+	addFlexionController(model);
+	setupFlexion(model, MCFidelity());
+	measureForceCosts(model, 0.25, "force_costs_flexion.txt");
+}
+
+//=============================================================================
+// STUDIES
+//=============================================================================
+/*
+*	Prepare <model> for the experiment of <study> (reducing it first if the
+*	study asks for it) and return its worker setup
+*/
+static MCWorkerSetup prepareStudy(Model& model, const MCStudy& study)
+{
+	if (study.get_reduce_model())
+	{
+		ModelReductionSettings settings("knee_r");
+		if (study.get_experiment() == "flexion")
+			settings.activeActuators = getFlexionActuatorNames();
+		else
+			settings.keepActuators = true;
+		ModelReductionReport report;
+		model = reduceModel(model, settings, getReducedModelFileName(model, study.get_experiment() + "_reduced"), &report);
+		mcLog(report.getSummary());
+	}
+
+	if (study.get_experiment() == "flexion")
+	{
+		addFlexionController(model);
+		return [](Model& model) { setupFlexion(model, MCFidelity()); };
+	}
+
+	const double kneeAngle = study.get_knee_angle();
+	SteadyStateSettings steadyState;
+	steadyState.enabled = study.get_steady_state();
+	return [kneeAngle, steadyState](Model& model) { setupAnteriorTibialLoads(model, kneeAngle, MCFidelity(), steadyState); };
+}
+
+/*
+*	Simulation of a study sample, the peak of every CustomAnalysis channel
+*	is an output. The CustomAnalysis results are printed to <reporterFile>
+*/
+static void simulateStudy(Model& model, SimTK::State& si, const MCStudy& study, MCOutputs& outputs,
+	const string& reporterFile = "")
+{
+	if (study.get_solver() == "quasi_static")
+	{
+		solveAnteriorTibialLoads(model, si, outputs, reporterFile);
+		return;
+	}
+
+	AnalysisGuard analyses(model);
+	CustomAnalysis* customReporter = analyses.add(new CustomAnalysis(&model, "r"));
+
+	const double finalTime = study.get_final_time() > 0 ? study.get_final_time()
+		: (study.get_experiment() == "flexion" ? 0.25 : 0.8);
+	if (SteadyStateHandler::get(model))
+		SteadyStateHandler::get(model)->reset(si);
+	WatchdogHandler* watchdog = WatchdogHandler::get(model);
+	if (watchdog)
+		watchdog->reset(si);
+	ProfileScope integrate("integrate");
+	if (study.get_integrator() == "implicit_knee")
+	{
+		ImplicitKneeSettings settings;
+		if (study.get_accuracy() > 0)
+			settings.accuracy = study.get_accuracy();
+		ImplicitKneeIntegrator integrator(model, settings);
+		integrator.addFreeCoordinates(si, "knee_r");
+		integrator.integrate(si, finalTime);
+	}
+	else if (study.get_integrator() == "multirate_knee")
+	{
+		MultiRateKneeSettings settings;
+		if (study.get_accuracy() > 0)
+			settings.accuracy = study.get_accuracy();
+		MultiRateKneeIntegrator integrator(model, settings);
+		integrator.addFreeCoordinates(si, "knee_r");
+		integrator.integrate(si, finalTime);
+	}
+	else
+	{
+		SimTK::RungeKuttaMersonIntegrator integrator(model.getMultibodySystem());
+		if (study.get_accuracy() > 0)
+			integrator.setAccuracy(study.get_accuracy());
+		Manager manager(model, integrator);
+		manager.setInitialTime(0.0);
+		manager.setFinalTime(finalTime);
+		manager.integrate(si);
+	}
+	integrate.stop();
+	if (watchdog && watchdog->isTriggered())
+		throw OpenSim::Exception("MonteCarloFD: stopped by the watchdog, " + watchdog->getReason());
+
+	if (!reporterFile.empty())
+	{
+		ProfileScope fileOutput("file_output");
+		customReporter->print(reporterFile);
+	}
+	addPeakOutputs(customReporter->m_storage, outputs);
+}
+
+/*
+*	Monte Carlo campaign of a study, resumable like performMCFD_atl
+*/
+static void performStudyMonteCarlo(Model model, const MCStudy& study)
+{
+	const string outputDir = study.getResultsDirectory();
+	makeOutputDirectories(outputDir);
+
+	const vector<MCModelParameter> parameters = study.getParameters();
+	vector<string> parameterNames;
+	for (unsigned int p=0; p<parameters.size(); p++)
+		parameterNames.push_back(parameters[p].name);
+	const vector<string> studyOutputs = study.getOutputNames();
+	vector<string> outputNames(studyOutputs);
+	outputNames.push_back("run_time");
+
+	const int numSamples = study.get_num_samples();
+	MCCampaign campaign(outputDir, study.getSamplerType(), (unsigned int)study.get_seed(), numSamples, parameterNames);
+	campaign.open();
+
+	std::unique_ptr<MCSampler> sampler(MCSampler::create(study.getSamplerType(), (int)parameters.size(),
+		numSamples, campaign.getSeed()));
+
+	MCStatistics statistics(outputNames);
+	statistics.setTargets(study.getTargets(), study.getSamplerType());
+	statistics.setOutputFile(outputDir + "outputs.txt");
+
+	auto getParameters = [&](int i)
+	{
+		vector<double> u, values;
+		sampler->getSample(i, u);
+		for (unsigned int p=0; p<parameters.size(); p++)
+			values.push_back(parameters[p].getValue(u[p]));
+		return values;
+	};
+
+	MCWorkerSetup setup = prepareStudy(model, study);
+	MCEngine engine(model, study.get_num_workers());
+	campaign.attach(engine, getParameters);
+	// without targets the samples keep the cost order
+	if (statistics.hasTargets())
+		engine.setStopCriterion([&]() { return statistics.isConverged(); });
+	// worker processes append to the outputs file, the statistics are read back from it
+	engine.setProcessWorkers(study.get_worker_processes(), [&]() { statistics.reload(); });
+	engine.setWorkerSetup(setup);
+
+	// expected-long samples first (not with targets), run times learned from the finished samples and while running
+	MCCostModel costModel(sampler->getNumDimensions());
+	costModel.addCampaign(outputDir + "outputs.txt", *sampler);
+	costModel.attach(engine, *sampler);
+
+	engine.run(campaign.getPendingSamples(), [&](Model& model, SimTK::State& si, int i)
+	{
+		vector<double> values = getParameters(i);
+		applyModelParameters(parameters, values, model, si, setup);
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		MCOutputs outputs;
+		simulateStudy(model, si, study, outputs, outputDir + "CustomReporter/" + changeToString(i) + "_custom_reporter.mot");
+		double runTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		vector<double> outputValues = getOutputValues(outputs, studyOutputs);
+		outputValues.push_back(runTime);
+		statistics.add(i, outputValues);
+	});
+
+	statistics.printSummary(outputDir + "statistics.txt");
+	statistics.logSummary();
+
+	// where the time of the campaign went
+	Profiler::print(outputDir + "profile");
+	Profiler::reset();
+}
+
+void performMCStudy(Model model, const MCStudy& study)
+{
+	study.validate();
+	mcLog("Study " + study.getName() + ": " + study.get_task() + " of " + study.get_experiment());
+
+	if (study.get_task() == "monte_carlo")
+	{
+		performStudyMonteCarlo(model, study);
+		return;
+	}
+
+	const vector<string> outputNames = study.getOutputNames();
+	MCWorkerSetup setup = prepareStudy(model, study);
+	MCOutputTask simulate = [&](Model& model, SimTK::State& si, int i, MCOutputs& outputs)
+	{
+		simulateStudy(model, si, study, outputs);
+		if (outputNames.empty())
+			return;
+		// only the declared outputs
+		MCOutputs selected;
+		vector<double> values = getOutputValues(outputs, outputNames);
+		for (unsigned int o=0; o<outputNames.size(); o++)
+			selected.add(outputNames[o], values[o]);
+		outputs = selected;
+	};
+
+	if (study.get_task() == "sensitivity")
+		performSensitivity(model, study.getParameters(), study.get_num_samples(), study.get_num_workers(),
+			study.getResultsDirectory(), setup, simulate);
+	else
+		performRareEvent(model, study.getParameters(), outputNames[0], study.get_threshold(),
+			study.getRareEventMethod(), study.getRareEventSettings(), study.get_num_workers(),
+			study.getResultsDirectory(), setup, simulate);
+
+	Profiler::print(study.getResultsDirectory() + "profile");
+	Profiler::reset();
+}
+
+void performMCStudies(const vector<string>& studyFiles)
+{
+	// read and check every study before running any
+	vector<MCStudy> studies;
+	for (unsigned int f=0; f<studyFiles.size(); f++)
+	{
+		studies.push_back(MCStudy(studyFiles[f]));
+		studies.back().validate();
+	}
+
+	// studies of the same model share its loading, in the order of the files
+	vector<bool> done(studies.size(), false);
+	for (unsigned int s=0; s<studies.size(); s++)
+	{
+		if (done[s])
+			continue;
+
+		const string modelFile = studies[s].get_model_file();
+		const Model& model = MCModelCache::getModel(modelFile);
+
+		for (unsigned int t=s; t<studies.size(); t++)
+		{
+			if (done[t] || studies[t].get_model_file() != modelFile)
+				continue;
+			performMCStudy(model, studies[t]);
+			done[t] = true;
+		}
+	}
+}
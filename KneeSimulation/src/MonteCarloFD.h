@@ -1,12 +1,137 @@
+#include "MCSampler.h"
+#include "MCStatistics.h"
+#include "MCModelParameter.h"
+#include "MCRareEvent.h"
+#include "MCMultiFidelity.h"
+#include "MCStudy.h"
+#include "WatchdogHandler.h"
+
 /*
 *	Perform Monte Carlo analysis for active knee flexion experiment,
 *	repeating this task <iteration> times
-*	and changing a variable (meniscus stiffness, ligament stiffness etc) through uniform distribution
+*	and changing a variable (meniscus stiffness, ligament stiffness etc) through uniform distribution.
+*	Samples run in parallel on <numWorkers> workers (0: one per hardware thread);
+*	the same <seed> gives the same results for any number of workers (0: random seed).
+*	Parameters are drawn by a <samplerType> sampler (see MCSampler.h).
+*	Progress is recorded in the campaign manifest of the output directory;
+*	running the same campaign again resumes it, skipping finished samples.
+*	Peak ligament forces and anterior tibial translation are tracked while
+*	the campaign runs; with <targets> (confidence interval width per output)
+*	the campaign stops once they are reached, <iterations> is the maximum.
+*	The targets need independent samples: MCPseudoRandom or MCLatinHypercube.
+*	If <samples> is not empty only these samples of the campaign are run.
+*	A low <fidelity> keeps its campaign in a subdirectory of the outputs.
+*	With <workerProcesses> the workers are processes sharing the model
+*	built once (see MCEngine::setProcessWorkers).
+*	A sample over the <watchdog> budgets is stopped, its last state is
+*	printed to Failed/ and it is recorded as failed (see WatchdogHandler)
 */
-void performMCFD_flexion(Model model, int iterations);
+void performMCFD_flexion(Model model, int iterations, int numWorkers = 0, unsigned int seed = 0,
+	MCSamplerType samplerType = MCSobol, const MCConvergenceTargets& targets = MCConvergenceTargets(),
+	const vector<int>& samples = vector<int>(), const MCFidelity& fidelity = MCFidelity(),
+	bool workerProcesses = false, const WatchdogSettings& watchdog = WatchdogSettings());
 /*
 *	Perform Monte Carlo analysis for anterior tibial loads experiment,
 *	repeating this task <iteration> times
-*	and changing a variable (meniscus stiffness, ligament stiffness etc) through uniform distribution
+*	and changing a variable (meniscus stiffness, ligament stiffness etc) through uniform distribution.
+*	Samples run in parallel on <numWorkers> workers (0: one per hardware thread);
+*	the same <seed> gives the same results for any number of workers (0: random seed).
+*	Parameters are drawn by a <samplerType> sampler (see MCSampler.h).
+*	Progress is recorded in the campaign manifest of the output directory;
+*	running the same campaign again resumes it, skipping finished samples.
+*	Peak ligament forces and anterior tibial translation are tracked while
+*	the campaign runs; with <targets> (confidence interval width per output)
+*	the campaign stops once they are reached, <iterations> is the maximum.
+*	The targets need independent samples: MCPseudoRandom or MCLatinHypercube.
+*	If <samples> is not empty only these samples of the campaign are run
+*	(see performMCSurrogate_atl).
+*	A low <fidelity> keeps its campaign in a subdirectory of the outputs.
+*	With <workerProcesses> the workers are processes sharing the model
+*	built once (see MCEngine::setProcessWorkers).
+*	A sample over the <watchdog> budgets is stopped, its last state is
+*	printed to Failed/ and it is recorded as failed (see WatchdogHandler)
 */
-void performMCFD_atl(Model model, int iterations);
+void performMCFD_atl(Model model, int iterations, int numWorkers = 0, unsigned int seed = 0,
+	MCSamplerType samplerType = MCSobol, const MCConvergenceTargets& targets = MCConvergenceTargets(),
+	const vector<int>& samples = vector<int>(), const MCFidelity& fidelity = MCFidelity(),
+	bool workerProcesses = false, const WatchdogSettings& watchdog = WatchdogSettings());
+/*
+*	Global sensitivity analysis of the anterior tibial loads experiment:
+*	first order and total Sobol indices of every CustomAnalysis output
+*	(peak value) with respect to <parameters>, from <numBaseSamples>
+*	Saltelli base samples, i.e. numBaseSamples*(parameters+2) simulations
+*/
+void performMCSensitivity_atl(Model model, const vector<MCModelParameter>& parameters, int numBaseSamples,
+	int numWorkers = 0);
+/*
+*	Fit a polynomial chaos surrogate of <outputName> (see MCStatistics outputs)
+*	over the aACL length to the finished samples of the anterior tibial loads
+*	campaign, report its leave-one-out error and save it in the campaign
+*	directory. Returns the <count> pending samples of the campaign that
+*	improve the surrogate most, to be run next with performMCFD_atl
+*/
+vector<int> performMCSurrogate_atl(int iterations, int count, const string& outputName = "aACL_peak_force",
+	int degree = 3, MCSamplerType samplerType = MCSobol);
+/*
+*	Surrogate of <outputName> over the aPCL length fitted to the finished
+*	samples of the flexion campaign (see performMCSurrogate_atl). Returns
+*	the <count> pending samples to be run next with performMCFD_flexion
+*/
+vector<int> performMCSurrogate_flexion(int iterations, int count, const string& outputName = "aPCL_peak_force",
+	int degree = 3, MCSamplerType samplerType = MCSobol);
+/*
+*	Probability that output <outputName> of the anterior tibial loads
+*	experiment (peak of a CustomAnalysis channel, e.g. "aACL_R_force")
+*	exceeds <threshold> when <parameters> are uniformly distributed, by
+*	importance sampling or subset simulation (see MCRareEvent.h).
+*	Reports the estimator variance and coefficient of variation
+*/
+MCRareEventResult performMCRareEvent_atl(Model model, const vector<MCModelParameter>& parameters,
+	const string& outputName, double threshold, MCRareEventMethod method = MCSubsetSimulation,
+	const MCRareEventSettings& settings = MCRareEventSettings(), int numWorkers = 0);
+/*
+*	Multi-fidelity Monte Carlo of the active knee flexion experiment:
+*	<numHigh> full fidelity samples are paired with up to <maxLow> samples
+*	at <lowFidelity> (looser accuracy, shorter horizon, reduced contact
+*	meshes) through control variate estimators of the campaign outputs.
+*	The number of low fidelity samples follows from the correlation and
+*	cost measured on the paired samples. The campaigns run in
+*	<output dir>high_fidelity/ and <output dir><lowFidelity.name>/
+*/
+void performMCMultiFidelity_flexion(Model model, int numHigh, int maxLow, const MCFidelity& lowFidelity,
+	int numWorkers = 0, unsigned int seed = 0, MCSamplerType samplerType = MCSobol);
+/*
+*	Multi-fidelity Monte Carlo of the anterior tibial loads experiment
+*	(see performMCMultiFidelity_flexion)
+*/
+void performMCMultiFidelity_atl(Model model, int numHigh, int maxLow, const MCFidelity& lowFidelity,
+	int numWorkers = 0, unsigned int seed = 0, MCSamplerType samplerType = MCSobol);
+/*
+*	Run the task of <study> (see MCStudy.h) on <model>
+*/
+void performMCStudy(Model model, const MCStudy& study);
+/*
+*	Run the studies of <studyFiles>, loading each model once
+*/
+void performMCStudies(const vector<string>& studyFiles);
+/*
+*	Run the anterior tibial loads (-60 degrees) and the active knee flexion
+*	experiments with Runge-Kutta, semi-explicit Euler, Verlet, CPodes and
+*	multi-rate knee integrators at several accuracies and fixed steps,
+*	against a Runge-Kutta-Merson reference at accuracy 1e-7 (see
+*	IntegratorBenchmark). Wall time, steps, rejected steps and the relative
+*	error of the peak ligament forces and APT are printed to
+*	../outputs/IntegratorBenchmark/, with the multi-rate runs against
+*	Runge-Kutta-Merson at the same accuracy and the fastest
+*	Pareto-optimal setting within <tolerance>
+*/
+void benchmarkIntegrators_atl(Model model, double tolerance = 0.01);
+void benchmarkIntegrators_flexion(Model model, double tolerance = 0.01);
+/*
+*	Cost of every force and force type of the model per evaluation of the
+*	system forces and over one simulation of the anterior tibial loads
+*	(-60 degrees) or the active knee flexion experiment, ranked, printed to
+*	../outputs/ForceCosts/ (see ForceCostProfiler)
+*/
+void measureForceCosts_atl(Model model);
+void measureForceCosts_flexion(Model model);
@@ -0,0 +1,291 @@
+#include "MultiRateKneeIntegrator.h"
+#include "Profiler.h"
+#include "SteadyStateHandler.h"
+#include "WatchdogHandler.h"
+#include "osimutils.h"
+#include <algorithm>
+#include <cmath>
+
+MultiRateKneeIntegrator::MultiRateKneeIntegrator(Model& model, const MultiRateKneeSettings& settings)
+	: m_model(model), m_settings(settings), m_numSteps(0), m_numSubsteps(0), m_numRejected(0), m_numRealizations(0)
+{
+}
+
+void MultiRateKneeIntegrator::addFastCoordinate(const string& name)
+{
+	m_names.push_back(name);
+}
+
+void MultiRateKneeIntegrator::addFreeCoordinates(const SimTK::State& s, const string& jointName)
+{
+	const CoordinateSet& coordinates = m_model.getJointSet().get(jointName).getCoordinateSet();
+	for (int c=0; c<coordinates.getSize(); c++)
+		if (!coordinates.get(c).getLocked(s) && !coordinates.get(c).isConstrained(s))
+			addFastCoordinate(coordinates.get(c).getName());
+}
+
+void MultiRateKneeIntegrator::setMusclesDisabled(SimTK::State& s, bool disabled) const
+{
+	for (unsigned int m=0; m<m_muscles.size(); m++)
+		m_model.getMuscles().get(m_muscles[m]).setDisabled(s, disabled);
+}
+
+SimTK::Vector MultiRateKneeIntegrator::getMuscleForces(const SimTK::State& s0)
+{
+	const SimTK::MultibodySystem& system = m_model.getMultibodySystem();
+	SimTK::State rest(s0);
+	setMusclesDisabled(rest, true);
+	system.realize(rest, SimTK::Stage::Dynamics);
+	m_numRealizations++;
+
+	// the other forces (gravity included) cancel out
+	const SimTK::Vector_<SimTK::SpatialVec> bodyForces = system.getRigidBodyForces(s0, SimTK::Stage::Dynamics)
+		- system.getRigidBodyForces(rest, SimTK::Stage::Dynamics);
+	SimTK::Vector forces;
+	m_model.getMatterSubsystem().multiplyBySystemJacobianTranspose(s0, bodyForces, forces);
+	forces += system.getMobilityForces(s0, SimTK::Stage::Dynamics) - system.getMobilityForces(rest, SimTK::Stage::Dynamics);
+	return forces;
+}
+
+SimTK::Vector MultiRateKneeIntegrator::getKneeAccelerations(const SimTK::State& s, const SimTK::Vector& forces) const
+{
+	// the locked coordinates do not accelerate: M_ff udot_f = f_f on the
+	// free coordinates
+	SimTK::Matrix M;
+	m_model.getMatterSubsystem().calcM(s, M);
+	const int m = (int)m_freeUIndices.size();
+	SimTK::Matrix freeM(m, m);
+	SimTK::Vector freeForces(m), freeAccelerations(m);
+	for (int i=0; i<m; i++)
+	{
+		freeForces[i] = forces[m_freeUIndices[i]];
+		for (int j=0; j<m; j++)
+			freeM(i, j) = M(m_freeUIndices[i], m_freeUIndices[j]);
+	}
+	SimTK::FactorLU(freeM).solve(freeForces, freeAccelerations);
+
+	SimTK::Vector accelerations((int)m_fastFree.size());
+	for (unsigned int i=0; i<m_fastFree.size(); i++)
+		accelerations[i] = freeAccelerations[m_fastFree[i]];
+	return accelerations;
+}
+
+double MultiRateKneeIntegrator::step(const SimTK::State& s0, SimTK::State& s1, double H, int numSubsteps,
+	double& fastError)
+{
+	const SimTK::MultibodySystem& system = m_model.getMultibodySystem();
+	const int n = (int)m_uIndices.size();
+	const double h = H / numSubsteps;
+	const double accuracy = m_settings.accuracy;
+	const SimTK::Vector q0 = s0.getQ(), u0 = s0.getU(), z0 = s0.getZ();
+	const SimTK::Vector qdot0 = s0.getQDot(), udot0 = s0.getUDot(), zdot0 = s0.getZDot();
+
+	// knee substeps, the slow states on their predictor and the muscle
+	// forces frozen at <s0>
+	const bool frozen = !m_muscles.empty();
+	const SimTK::Vector muscleForces = frozen ? getMuscleForces(s0) : SimTK::Vector();
+	s1 = s0;
+	if (frozen)
+		setMusclesDisabled(s1, true);
+	fastError = 0;
+	SimTK::Vector kneeAcceleration(n);
+	for (int i=0; i<n; i++)
+		kneeAcceleration[i] = udot0[m_uIndices[i]];
+	for (int k=1; k<=numSubsteps; k++)
+	{
+		const double tau = k * h;
+		SimTK::Vector q(s1.getQ()), u(s1.getU());
+		for (int j=0; j<u.size(); j++)
+			if (!m_fastU[j])
+				u[j] = u0[j] + tau * udot0[j];
+		for (int j=0; j<q.size(); j++)
+			if (!m_fastQ[j])
+				q[j] = q0[j] + tau * qdot0[j];
+		for (int i=0; i<n; i++)
+		{
+			const double previousSpeed = u[m_uIndices[i]];
+			u[m_uIndices[i]] += h * kneeAcceleration[i];
+			q[m_qIndices[i]] += h * u[m_uIndices[i]];
+			fastError = std::max(fastError, h / 2 * std::fabs(u[m_uIndices[i]] - previousSpeed)
+				/ (accuracy * (std::fabs(q[m_qIndices[i]]) + m_settings.coordinateScale)));
+		}
+		s1.setTime(s0.getTime() + tau);
+		s1.updQ() = q;
+		s1.updU() = u;
+		s1.updZ() = z0 + tau * zdot0;
+		system.realize(s1, SimTK::Stage::Acceleration);
+		m_numRealizations++;
+		const SimTK::Vector muscleAccelerations = frozen ? getKneeAccelerations(s1, muscleForces) : SimTK::Vector(n, 0.0);
+
+		for (int i=0; i<n; i++)
+		{
+			const double acceleration = s1.getUDot()[m_uIndices[i]] + muscleAccelerations[i];
+			fastError = std::max(fastError, h / 2 * std::fabs(acceleration - kneeAcceleration[i])
+				/ (accuracy * (std::fabs(u[m_uIndices[i]]) + m_settings.speedScale)));
+			kneeAcceleration[i] = acceleration;
+		}
+	}
+	m_numSubsteps += numSubsteps;
+
+	// derivatives of the slow states with the muscles at the end of the
+	// substeps
+	if (frozen)
+	{
+		setMusclesDisabled(s1, false);
+		system.realize(s1, SimTK::Stage::Acceleration);
+		m_numRealizations++;
+	}
+
+	// slow states: trapezoidal corrector
+	double slowError = 0;
+	SimTK::Vector q(s1.getQ()), u(s1.getU()), z(s1.getZ());
+	for (int j=0; j<u.size(); j++)
+		if (!m_fastU[j])
+		{
+			u[j] = u0[j] + H / 2 * (udot0[j] + s1.getUDot()[j]);
+			slowError = std::max(slowError, H / 2 * std::fabs(s1.getUDot()[j] - udot0[j])
+				/ (accuracy * (std::fabs(u[j]) + m_settings.speedScale)));
+		}
+	for (int j=0; j<q.size(); j++)
+		if (!m_fastQ[j])
+		{
+			q[j] = q0[j] + H / 2 * (qdot0[j] + s1.getQDot()[j]);
+			slowError = std::max(slowError, H / 2 * std::fabs(s1.getQDot()[j] - qdot0[j])
+				/ (accuracy * (std::fabs(q[j]) + m_settings.coordinateScale)));
+		}
+	for (int j=0; j<z.size(); j++)
+	{
+		z[j] = z0[j] + H / 2 * (zdot0[j] + s1.getZDot()[j]);
+		slowError = std::max(slowError, H / 2 * std::fabs(s1.getZDot()[j] - zdot0[j])
+			/ (accuracy * (std::fabs(z[j]) + m_settings.auxiliaryScale)));
+	}
+	s1.updQ() = q;
+	s1.updU() = u;
+	s1.updZ() = z;
+	system.realize(s1, SimTK::Stage::Acceleration);
+	m_numRealizations++;
+
+	return slowError;
+}
+
+void MultiRateKneeIntegrator::recordState(const SimTK::State& s)
+{
+	Array<double> values;
+	m_model.getStateValues(s, values);
+	m_states.append(s.getTime(), values.getSize(), values.getSize() > 0 ? &values[0] : 0);
+}
+
+void MultiRateKneeIntegrator::integrate(SimTK::State& s, double finalTime)
+{
+	if (m_names.empty())
+		throw OpenSim::Exception("MultiRateKneeIntegrator: no fast coordinates");
+
+	getCoordinateIndices(m_model, s, m_names, m_qIndices, m_uIndices);
+	m_fastQ.assign(s.getNQ(), false);
+	m_fastU.assign(s.getNU(), false);
+	for (unsigned int i=0; i<m_names.size(); i++)
+	{
+		m_fastQ[m_qIndices[i]] = true;
+		m_fastU[m_uIndices[i]] = true;
+	}
+
+	// muscles frozen over the macro steps, their forces spread on the free
+	// coordinates
+	const ConstraintSet& constraints = m_model.getConstraintSet();
+	for (int c=0; c<constraints.getSize(); c++)
+		if (!constraints.get(c).isDisabled(s))
+			throw OpenSim::Exception("MultiRateKneeIntegrator: constraint " + constraints.get(c).getName()
+				+ " is enabled, only coordinate locks are supported");
+	m_muscles.clear();
+	for (int m=0; m<m_model.getMuscles().getSize(); m++)
+		if (!m_model.getMuscles().get(m).isDisabled(s))
+			m_muscles.push_back(m);
+	vector<string> freeNames;
+	const CoordinateSet& coordinates = m_model.getCoordinateSet();
+	for (int c=0; c<coordinates.getSize(); c++)
+		if (!coordinates.get(c).getLocked(s) && !coordinates.get(c).isConstrained(s))
+			freeNames.push_back(coordinates.get(c).getName());
+	vector<int> freeQIndices;
+	getCoordinateIndices(m_model, s, freeNames, freeQIndices, m_freeUIndices);
+	m_fastFree.clear();
+	for (unsigned int i=0; i<m_uIndices.size(); i++)
+	{
+		vector<int>::const_iterator it = std::find(m_freeUIndices.begin(), m_freeUIndices.end(), m_uIndices[i]);
+		if (it == m_freeUIndices.end())
+			throw OpenSim::Exception("MultiRateKneeIntegrator: " + m_names[i] + " is locked or constrained");
+		m_fastFree.push_back((int)(it - m_freeUIndices.begin()));
+	}
+
+	Array<string> labels;
+	labels.append("time");
+	labels.append(m_model.getStateVariableNames());
+	m_states.reset(0);
+	m_states.setColumnLabels(labels);
+
+	SteadyStateHandler* steadyState = SteadyStateHandler::get(m_model);
+	double nextCheck = steadyState ? s.getTime() + steadyState->getEventInterval() : SimTK::Infinity;
+	WatchdogHandler* watchdog = WatchdogHandler::get(m_model);
+
+	m_model.getMultibodySystem().realize(s, SimTK::Stage::Acceleration);
+	m_numRealizations++;
+	m_model.updAnalysisSet().begin(s);
+	recordState(s);
+
+	double H = m_settings.initialStepSize, h = m_settings.initialFastStepSize;
+	int stepNumber = 0;
+	SimTK::State next(s);
+	while (s.getTime() < finalTime - 1.e-12 * std::max(1.0, std::fabs(finalTime)))
+	{
+		// budgets checked on every attempt, rejected steps included: a step
+		// size shrinking without progress is the stall the watchdog stops
+		if (watchdog && watchdog->getValue(s) < 0)
+			break;
+
+		const double stepSize = std::min(H, finalTime - s.getTime());
+		const int numSubsteps = std::max(1, std::min(m_settings.maxSubsteps, (int)std::ceil(stepSize / h - 1.e-9)));
+		double fastError;
+		const double slowError = step(s, next, stepSize, numSubsteps, fastError);
+		const double substep = stepSize / numSubsteps;
+		const double slowFactor = slowError > 0 && SimTK::isFinite(slowError) ? 0.9 / std::sqrt(slowError) : 2.0;
+		const double fastFactor = fastError > 0 && SimTK::isFinite(fastError) ? 0.9 / std::sqrt(fastError) : 2.0;
+
+		if (!(slowError <= 1) || !(fastError <= 1))
+		{
+			m_numRejected++;
+			if (!(slowError <= 1))
+				H = stepSize * std::max(0.2, std::min(slowFactor, 0.9));
+			if (!(fastError <= 1))
+			{
+				h = substep * std::max(0.2, std::min(fastFactor, 0.9));
+				// out of substeps: the macro step has to shrink too
+				if (numSubsteps == m_settings.maxSubsteps)
+					H = std::min(H, stepSize / 2);
+			}
+			if (H < m_settings.minStepSize || h < m_settings.minStepSize)
+				throw OpenSim::Exception("MultiRateKneeIntegrator: step size below the minimum at t = "
+					+ std::to_string((long double)s.getTime()));
+			continue;
+		}
+
+		s = next;
+		m_numSteps++;
+		{
+			ProfileScope recording("analysis_recording");
+			m_model.updAnalysisSet().step(s, ++stepNumber);
+			recordState(s);
+		}
+		H = std::min(m_settings.maxStepSize, stepSize * std::max(0.2, std::min(slowFactor, 2.0)));
+		h = std::min(H, substep * std::max(0.2, std::min(fastFactor, 2.0)));
+
+		if (s.getTime() >= nextCheck)
+		{
+			bool terminate = false;
+			steadyState->handleEvent(s, m_settings.accuracy, terminate);
+			nextCheck += steadyState->getEventInterval();
+			if (terminate)
+				break;
+		}
+	}
+
+	m_model.updAnalysisSet().end(s);
+}
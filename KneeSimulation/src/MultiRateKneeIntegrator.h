@@ -0,0 +1,107 @@
+#ifndef MULTIRATEKNEEINTEGRATOR_H
+#define MULTIRATEKNEEINTEGRATOR_H
+
+#include <OpenSim/OpenSim.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace OpenSim;
+
+struct MultiRateKneeSettings
+{
+	double accuracy;
+	double initialStepSize;		// macro step of the slow states
+	double initialFastStepSize;	// substep of the knee
+	double minStepSize;
+	double maxStepSize;
+	int maxSubsteps;			// per macro step
+	// error of a state variable relative to (|value| + scale)
+	double coordinateScale;		// m or rad
+	double speedScale;			// m/s or rad/s
+	double auxiliaryScale;		// muscle states
+
+	MultiRateKneeSettings()
+		: accuracy(1.e-3), initialStepSize(1.e-3), initialFastStepSize(1.e-5), minStepSize(1.e-10), maxStepSize(1.e-2),
+		maxSubsteps(1000), coordinateScale(1.e-2), speedScale(1.e-1), auxiliaryScale(1.e-1) {}
+};
+
+/*
+*	Multi-rate integration: the muscle states and the coordinates outside
+*	the knee (slow) advance by macro steps, predicted linearly from their
+*	derivatives at the start and corrected by the trapezoidal rule at the
+*	end; the knee coordinates (fast), driven by the contact and ligament
+*	forces, subcycle inside each macro step with semi-explicit Euler
+*	substeps against the predicted slow states.
+*	The macro step follows the error of the slow states and the substep
+*	the error of the knee, so the muscles are not stepped at the contact
+*	step size. Nor are they evaluated at it: their generalized forces are
+*	computed at the start of each macro step and held over its substeps,
+*	which run with the muscles disabled (one realization each) and add
+*	the frozen forces through the mass matrix of the free coordinates.
+*	The knee coordinates are assumed to have qdot = u (CustomJoint), and
+*	the only constraints of the model to be the coordinate locks.
+*	Drives the analyses of the model like Manager::integrate and stops on
+*	the steady state of a SteadyStateHandler of the system or out of the
+*	budgets of its WatchdogHandler (checked at every step)
+*/
+class MultiRateKneeIntegrator
+{
+public:
+	MultiRateKneeIntegrator(Model& model, const MultiRateKneeSettings& settings = MultiRateKneeSettings());
+
+	void addFastCoordinate(const string& name);
+	/*
+	*	Add the coordinates of joint <jointName> neither locked nor
+	*	constrained in <s>
+	*/
+	void addFreeCoordinates(const SimTK::State& s, const string& jointName);
+
+	/*
+	*	Integrate <s> from its time to <finalTime>
+	*/
+	void integrate(SimTK::State& s, double finalTime);
+
+	// states of the accepted macro steps
+	Storage& getStateStorage() { return m_states; }
+
+	int getNumStepsTaken() const { return m_numSteps; }
+	int getNumSubsteps() const { return m_numSubsteps; }
+	int getNumStepsRejected() const { return m_numRejected; }
+	int getNumRealizations() const { return m_numRealizations; }
+
+private:
+	/*
+	*	Macro step of <H> with <numSubsteps> knee substeps from <s0>
+	*	(realized to Acceleration) to <s1>; returns the weighted error of
+	*	the slow states and sets <fastError> to the one of the knee
+	*	(accepted up to 1)
+	*/
+	double step(const SimTK::State& s0, SimTK::State& s1, double H, int numSubsteps, double& fastError);
+	void recordState(const SimTK::State& s);
+
+	void setMusclesDisabled(SimTK::State& s, bool disabled) const;
+	// generalized forces of the enabled muscles in <s0> (realized to Dynamics)
+	SimTK::Vector getMuscleForces(const SimTK::State& s0);
+	// accelerations of the knee coordinates under <forces> alone in <s>
+	SimTK::Vector getKneeAccelerations(const SimTK::State& s, const SimTK::Vector& forces) const;
+
+	Model& m_model;
+	MultiRateKneeSettings m_settings;
+	vector<string> m_names;
+	vector<int> m_qIndices;
+	vector<int> m_uIndices;
+	vector<bool> m_fastQ;	// per entry of Q
+	vector<bool> m_fastU;	// per entry of U
+	vector<int> m_muscles;		// enabled at the start of the integration
+	vector<int> m_freeUIndices;	// of the coordinates neither locked nor constrained
+	vector<int> m_fastFree;		// entry of each knee coordinate in m_freeUIndices
+
+	Storage m_states;
+	int m_numSteps;
+	int m_numSubsteps;
+	int m_numRejected;
+	int m_numRealizations;
+};
+
+#endif
@@ -0,0 +1,243 @@
+#include "Profiler.h"
+#include "MCEngine.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+struct ProfileNode
+{
+	string name;
+	long long calls;
+	long long totalNs;
+	long long childrenNs;	// of the nested scopes
+	long long minNs;
+	long long maxNs;
+	map<string, std::unique_ptr<ProfileNode> > children;
+
+	explicit ProfileNode(const string& aName) : name(aName) { reset(); }
+
+	void reset()
+	{
+		calls = totalNs = childrenNs = maxNs = 0;
+		minNs = std::numeric_limits<long long>::max();
+		for (map<string, std::unique_ptr<ProfileNode> >::iterator child = children.begin(); child != children.end(); ++child)
+			child->second->reset();
+	}
+};
+
+struct ProfileFrame
+{
+	ProfileNode* node;
+	std::chrono::steady_clock::time_point start;
+};
+
+static std::mutex profileMutex;
+static ProfileNode profileRoot("all");
+static map<std::thread::id, vector<ProfileFrame> > profileStacks;
+
+void Profiler::begin(const char* name)
+{
+	std::lock_guard<std::mutex> lock(profileMutex);
+	vector<ProfileFrame>& stack = profileStacks[std::this_thread::get_id()];
+	ProfileNode* parent = stack.empty() ? &profileRoot : stack.back().node;
+	std::unique_ptr<ProfileNode>& node = parent->children[name];
+	if (!node)
+		node.reset(new ProfileNode(name));
+	ProfileFrame frame = {node.get(), std::chrono::steady_clock::now()};
+	stack.push_back(frame);
+}
+
+void Profiler::end()
+{
+	const std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+	std::lock_guard<std::mutex> lock(profileMutex);
+	map<std::thread::id, vector<ProfileFrame> >::iterator stack = profileStacks.find(std::this_thread::get_id());
+	if (stack == profileStacks.end() || stack->second.empty())
+		return;
+
+	const ProfileFrame frame = stack->second.back();
+	stack->second.pop_back();
+	const long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - frame.start).count();
+	ProfileNode& node = *frame.node;
+	node.calls++;
+	node.totalNs += ns;
+	node.minNs = std::min(node.minNs, ns);
+	node.maxNs = std::max(node.maxNs, ns);
+	(stack->second.empty() ? profileRoot : *stack->second.back().node).childrenNs += ns;
+
+	// threads of the workers come and go
+	if (stack->second.empty())
+		profileStacks.erase(stack);
+}
+
+void Profiler::reset()
+{
+	std::lock_guard<std::mutex> lock(profileMutex);
+	profileRoot.reset();
+}
+
+static string escapeJSON(const string& text)
+{
+	string escaped;
+	for (size_t c=0; c<text.size(); c++)
+	{
+		if (text[c] == '"' || text[c] == '\\')
+			escaped += '\\';
+		escaped += text[c];
+	}
+	return escaped;
+}
+
+static void printJSONNode(ostream& out, const ProfileNode& node, const string& indent)
+{
+	// the root is not a scope, its time is the one of the outer scopes
+	const bool root = &node == &profileRoot;
+	const long long totalNs = root ? node.childrenNs : node.totalNs;
+	out << indent << "{\"name\": \"" << escapeJSON(node.name) << "\", \"calls\": " << node.calls
+		<< ", \"total_ns\": " << totalNs << ", \"self_ns\": " << totalNs - node.childrenNs
+		<< ", \"min_ns\": " << (node.calls > 0 ? node.minNs : 0) << ", \"max_ns\": " << node.maxNs
+		<< ", \"children\": [";
+	bool first = true;
+	for (map<string, std::unique_ptr<ProfileNode> >::const_iterator child = node.children.begin();
+		child != node.children.end(); ++child)
+	{
+		if (child->second->calls == 0)
+			continue;
+		out << (first ? "\n" : ",\n");
+		printJSONNode(out, *child->second, indent + "\t");
+		first = false;
+	}
+	out << (first ? "" : "\n" + indent) << "]}";
+}
+
+void Profiler::printJSON(const string& fileName)
+{
+	std::lock_guard<std::mutex> lock(profileMutex);
+	ofstream file(fileName.c_str());
+	printJSONNode(file, profileRoot, "");
+	file << endl;
+}
+
+/*
+*	Folded stack names: no separators and no blanks
+*/
+static string getFoldedName(const string& name)
+{
+	string folded(name);
+	for (size_t c=0; c<folded.size(); c++)
+		if (folded[c] == ';' || folded[c] == ' ' || folded[c] == '\t' || folded[c] == '\n')
+			folded[c] = '_';
+	return folded;
+}
+
+static void printFoldedNode(ostream& out, const ProfileNode& node, const string& path)
+{
+	for (map<string, std::unique_ptr<ProfileNode> >::const_iterator child = node.children.begin();
+		child != node.children.end(); ++child)
+	{
+		const ProfileNode& scope = *child->second;
+		if (scope.calls == 0)
+			continue;
+		const string scopePath = path.empty() ? getFoldedName(scope.name) : path + ";" + getFoldedName(scope.name);
+		if (scope.totalNs > scope.childrenNs)
+			out << scopePath << " " << scope.totalNs - scope.childrenNs << "\n";
+		printFoldedNode(out, scope, scopePath);
+	}
+}
+
+void Profiler::printFoldedStacks(const string& fileName)
+{
+	std::lock_guard<std::mutex> lock(profileMutex);
+	ofstream file(fileName.c_str());
+	printFoldedNode(file, profileRoot, "");
+}
+
+/*
+*	One line per scope in depth first order: depth, counters and name
+*/
+static void serializeNode(ostream& out, const ProfileNode& node, int depth)
+{
+	for (map<string, std::unique_ptr<ProfileNode> >::const_iterator child = node.children.begin();
+		child != node.children.end(); ++child)
+	{
+		const ProfileNode& scope = *child->second;
+		// scopes left open by the parent of a worker process only hold children
+		if (scope.calls == 0 && scope.childrenNs == 0)
+			continue;
+		out << depth << "\t" << scope.calls << "\t" << scope.totalNs << "\t" << scope.childrenNs << "\t"
+			<< scope.minNs << "\t" << scope.maxNs << "\t" << scope.name << "\n";
+		serializeNode(out, scope, depth + 1);
+	}
+}
+
+string Profiler::serialize()
+{
+	std::lock_guard<std::mutex> lock(profileMutex);
+	std::ostringstream out;
+	serializeNode(out, profileRoot, 0);
+	return out.str();
+}
+
+void Profiler::merge(const string& profile)
+{
+	std::lock_guard<std::mutex> lock(profileMutex);
+	std::istringstream in(profile);
+	vector<ProfileNode*> path(1, &profileRoot);
+	string line;
+	while (getline(in, line))
+	{
+		std::istringstream fields(line);
+		int depth;
+		long long calls, totalNs, childrenNs, minNs, maxNs;
+		string name;
+		if (!(fields >> depth >> calls >> totalNs >> childrenNs >> minNs >> maxNs) || depth < 0
+			|| depth >= (int)path.size())
+			continue;
+		fields.ignore(1);
+		getline(fields, name);
+
+		path.resize(depth + 1);
+		std::unique_ptr<ProfileNode>& node = path.back()->children[name];
+		if (!node)
+			node.reset(new ProfileNode(name));
+		node->calls += calls;
+		node->totalNs += totalNs;
+		node->childrenNs += childrenNs;
+		node->minNs = std::min(node->minNs, minNs);
+		node->maxNs = std::max(node->maxNs, maxNs);
+		if (depth == 0)
+			profileRoot.childrenNs += totalNs;
+		path.push_back(node.get());
+	}
+}
+
+string Profiler::getSummary()
+{
+	std::lock_guard<std::mutex> lock(profileMutex);
+	std::ostringstream summary;
+	summary << "Profile (wall time of the outer scopes):";
+	for (map<string, std::unique_ptr<ProfileNode> >::const_iterator child = profileRoot.children.begin();
+		child != profileRoot.children.end(); ++child)
+	{
+		const ProfileNode& scope = *child->second;
+		if (scope.calls > 0)
+			summary << "\n\t" << scope.name << ": " << setprecision(6) << scope.totalNs * 1.e-9 << " s, "
+				<< scope.calls << " calls";
+	}
+	return summary.str();
+}
+
+void Profiler::print(const string& prefix)
+{
+	printJSON(prefix + ".json");
+	printFoldedStacks(prefix + ".folded");
+	mcLog(getSummary());
+}
@@ -0,0 +1,66 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <string>
+
+using namespace std;
+
+/*
+*	Hierarchical wall clock profiler: a ProfileScope times its lifetime
+*	(steady clock, nanoseconds) and nests in the scopes open on the same
+*	thread. Timings are aggregated by call path over all the calls and
+*	threads, e.g. "sample;integrate" over the samples of a campaign.
+*	Printed as JSON (call tree with calls, total, self, min and max time
+*	of every path) and as folded stacks, one "a;b;c <self ns>" line per
+*	path, the input of flamegraph.pl and speedscope.
+*	Worker processes (MCEngine::setProcessWorkers) time their own copy,
+*	merged into the one of the calling process when they end
+*/
+class Profiler
+{
+public:
+	static void begin(const char* name);
+	static void end();
+	// zero every timing, the scopes open stay valid
+	static void reset();
+
+	static void printJSON(const string& fileName);
+	static void printFoldedStacks(const string& fileName);
+	/*
+	*	<prefix>.json and <prefix>.folded, and the time of the outer scopes
+	*	to the log
+	*/
+	static void print(const string& prefix);
+	// time of the outer scopes, one per line
+	static string getSummary();
+
+	/*
+	*	Timings of every call path as text, and added to the timings of
+	*	this process (e.g. those of a worker process)
+	*/
+	static string serialize();
+	static void merge(const string& profile);
+};
+
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char* name) : m_open(true) { Profiler::begin(name); }
+	~ProfileScope() { stop(); }
+
+	// end the scope before the end of its block
+	void stop()
+	{
+		if (m_open)
+			Profiler::end();
+		m_open = false;
+	}
+
+private:
+	ProfileScope(const ProfileScope&);
+	ProfileScope& operator=(const ProfileScope&);
+
+	bool m_open;
+};
+
+#endif
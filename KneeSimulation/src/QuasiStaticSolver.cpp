@@ -0,0 +1,205 @@
+#include "QuasiStaticSolver.h"
+#include "osimutils.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+static double getMaxAbs(const SimTK::Vector& v)
+{
+	double max = 0;
+	for (int i=0; i<v.size(); i++)
+		max = std::max(max, std::fabs(v[i]));
+	return max;
+}
+
+QuasiStaticSolver::QuasiStaticSolver(const Model& model, const QuasiStaticSettings& settings)
+	: m_model(model), m_settings(settings), m_numEvaluations(0)
+{
+}
+
+void QuasiStaticSolver::addCoordinate(const string& name)
+{
+	m_names.push_back(name);
+	m_coordinates.push_back(&m_model.getCoordinateSet().get(name));
+}
+
+void QuasiStaticSolver::addFreeCoordinates(const SimTK::State& s, const string& jointName)
+{
+	const CoordinateSet& coordinates = m_model.getJointSet().get(jointName).getCoordinateSet();
+	for (int c=0; c<coordinates.getSize(); c++)
+		if (!coordinates.get(c).getLocked(s) && !coordinates.get(c).isConstrained(s))
+			addCoordinate(coordinates.get(c).getName());
+}
+
+SimTK::Vector QuasiStaticSolver::getResidual(SimTK::State& s, const SimTK::Vector& q) const
+{
+	for (unsigned int c=0; c<m_coordinates.size(); c++)
+		m_coordinates[c]->setValue(s, q[c], false);
+	s.updU() = 0;
+	const SimTK::MultibodySystem& system = m_model.getMultibodySystem();
+	system.realize(s, SimTK::Stage::Dynamics);
+	m_numEvaluations++;
+
+	// at rest M udot = f, the residual of udot = 0 is -f
+	SimTK::Vector forces;
+	m_model.getMatterSubsystem().calcResidualForceIgnoringConstraints(s,
+		system.getMobilityForces(s, SimTK::Stage::Dynamics), system.getRigidBodyForces(s, SimTK::Stage::Dynamics),
+		SimTK::Vector(s.getNU(), 0.0), forces);
+
+	SimTK::Vector residual((int)m_coordinates.size());
+	for (unsigned int c=0; c<m_coordinates.size(); c++)
+		residual[c] = forces[m_uIndices[c]];
+	return residual;
+}
+
+SimTK::Matrix QuasiStaticSolver::getJacobian(SimTK::State& s, const SimTK::Vector& q) const
+{
+	const int n = q.size();
+	const double h = m_settings.perturbation;
+	SimTK::Matrix jacobian(n, n);
+	for (int j=0; j<n; j++)
+	{
+		SimTK::Vector qPlus(q), qMinus(q);
+		qPlus[j] += h;
+		qMinus[j] -= h;
+		SimTK::Vector column = (getResidual(s, qPlus) - getResidual(s, qMinus)) / (2 * h);
+		for (int i=0; i<n; i++)
+			jacobian(i, j) = column[i];
+	}
+	return jacobian;
+}
+
+SimTK::Vector QuasiStaticSolver::getStep(const SimTK::Matrix& jacobian, const SimTK::Vector& residual) const
+{
+	SimTK::Vector step(residual.size());
+	SimTK::FactorLU lu(jacobian);
+	if (!lu.isSingular())
+	{
+		lu.solve(-residual, step);
+		return step;
+	}
+
+	// a coordinate the forces do not hold (yet): damped least squares
+	const int n = jacobian.ncol();
+	SimTK::Matrix normal = ~jacobian * jacobian;
+	double damping = 0;
+	for (int i=0; i<n; i++)
+		damping = std::max(damping, normal(i, i));
+	for (int i=0; i<n; i++)
+		normal(i, i) += 1.e-6 * (damping > 0 ? damping : 1.0);
+	SimTK::FactorLU(normal).solve(-(~jacobian * residual), step);
+	return step;
+}
+
+QuasiStaticResult QuasiStaticSolver::solve(SimTK::State& s) const
+{
+	if (m_coordinates.empty())
+		throw OpenSim::Exception("QuasiStaticSolver: no coordinates to solve for");
+
+	const int n = (int)m_coordinates.size();
+	m_numEvaluations = 0;
+	vector<int> qIndices;
+	getCoordinateIndices(m_model, s, m_names, qIndices, m_uIndices);
+
+	QuasiStaticResult result;
+	result.converged = false;
+	result.iterations = 0;
+
+	SimTK::Vector q(n);
+	for (int c=0; c<n; c++)
+		q[c] = m_coordinates[c]->getValue(s);
+	SimTK::Vector residual = getResidual(s, q);
+	double norm = getMaxAbs(residual);
+
+	SimTK::Matrix jacobian;
+	bool fresh = false;
+	while (result.iterations < m_settings.maxIterations)
+	{
+		if (norm <= m_settings.residualTolerance)
+		{
+			result.converged = true;
+			break;
+		}
+		result.iterations++;
+
+		if (!fresh && (!m_settings.broyden || jacobian.nrow() == 0))
+		{
+			jacobian = getJacobian(s, q);
+			fresh = true;
+		}
+
+		// bounded step, in the units of each coordinate
+		SimTK::Vector step = getStep(jacobian, residual);
+		double scale = 1;
+		for (int c=0; c<n; c++)
+		{
+			const double maxStep = m_coordinates[c]->getMotionType() == Coordinate::Translational
+				? m_settings.maxTranslationStep : m_settings.maxRotationStep;
+			if (std::fabs(step[c]) * scale > maxStep)
+				scale = maxStep / std::fabs(step[c]);
+		}
+		step *= scale;
+
+		// backtracking until the residual decreases
+		SimTK::Vector qNext, residualNext;
+		double normNext = norm;
+		for (double alpha=1; alpha>=1./64; alpha/=2)
+		{
+			qNext = q + alpha * step;
+			residualNext = getResidual(s, qNext);
+			normNext = getMaxAbs(residualNext);
+			if (normNext < (1 - 1.e-4 * alpha) * norm)
+				break;
+		}
+
+		if (normNext >= norm)
+		{
+			// an updated Jacobian may be off, retry with a new one
+			if (fresh)
+				break;
+			jacobian = getJacobian(s, q);
+			fresh = true;
+			continue;
+		}
+
+		if (m_settings.broyden)
+		{
+			SimTK::Vector dq = qNext - q;
+			SimTK::Vector dr = residualNext - residual - jacobian * dq;
+			const double dqNorm = ~dq * dq;
+			if (dqNorm > 0)
+				for (int i=0; i<n; i++)
+					for (int j=0; j<n; j++)
+						jacobian(i, j) += dr[i] * dq[j] / dqNorm;
+		}
+		fresh = false;
+
+		const double stepSize = getMaxAbs(qNext - q);
+		q = qNext;
+		residual = residualNext;
+		norm = normNext;
+		if (stepSize < m_settings.stepTolerance)
+			break;
+	}
+
+	// leave <s> at the last iterate
+	residual = getResidual(s, q);
+	m_model.getMultibodySystem().realize(s, SimTK::Stage::Acceleration);
+	result.residual = getMaxAbs(residual);
+	result.converged = result.residual <= m_settings.residualTolerance;
+	result.numEvaluations = m_numEvaluations;
+	result.names = m_names;
+	for (int c=0; c<n; c++)
+		result.values.push_back(q[c]);
+	return result;
+}
+
+string QuasiStaticSolver::getReport(const QuasiStaticResult& result)
+{
+	std::ostringstream report;
+	report << (result.converged ? "equilibrium" : "no equilibrium") << " after " << result.iterations
+		<< " iterations (" << result.numEvaluations << " evaluations), residual " << result.residual;
+	for (unsigned int c=0; c<result.names.size(); c++)
+		report << ", " << result.names[c] << " = " << result.values[c];
+	return report.str();
+}
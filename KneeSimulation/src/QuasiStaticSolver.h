@@ -0,0 +1,90 @@
+#ifndef QUASISTATICSOLVER_H
+#define QUASISTATICSOLVER_H
+
+#include <OpenSim/OpenSim.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace OpenSim;
+
+struct QuasiStaticSettings
+{
+	int maxIterations;
+	double residualTolerance;	// largest generalized force at equilibrium (N or N m)
+	double stepTolerance;		// smallest Newton step (coordinate units)
+	double maxTranslationStep;	// largest Newton step (m)
+	double maxRotationStep;		// largest Newton step (rad)
+	double perturbation;		// central differences of the Jacobian
+	bool broyden;				// rank one updates between finite difference Jacobians
+
+	QuasiStaticSettings()
+		: maxIterations(50), residualTolerance(1.e-3), stepTolerance(1.e-10), maxTranslationStep(0.002),
+		maxRotationStep(0.05), perturbation(1.e-6), broyden(true) {}
+};
+
+struct QuasiStaticResult
+{
+	bool converged;
+	int iterations;
+	int numEvaluations;		// residual evaluations (realizations to Dynamics)
+	double residual;		// largest generalized force (N or N m)
+	vector<string> names;
+	vector<double> values;	// equilibrium value of the coordinates
+};
+
+/*
+*	Static equilibrium of some coordinates of a model (e.g. the free knee
+*	coordinates under the anterior tibial load): Newton iterations on the
+*	generalized forces that hold these coordinates at rest (inverse
+*	dynamics with zero speeds and accelerations), with the other
+*	coordinates, the muscle states and the time held. Accelerations would
+*	not do: through the mass matrix the unbalanced ankle and toe
+*	coordinates would move the root away from equilibrium. The forces of
+*	the model (PrescribedForce, CustomLigament, contact, gravity) are
+*	evaluated as they are, damping vanishes at rest; constraint forces are
+*	left out, the solved coordinates are the unconstrained ones.
+*	The Jacobian is computed by central differences, then updated by
+*	Broyden between the steps and recomputed when a step fails; steps are
+*	bounded and backtracked along the Newton direction
+*/
+class QuasiStaticSolver
+{
+public:
+	QuasiStaticSolver(const Model& model, const QuasiStaticSettings& settings = QuasiStaticSettings());
+
+	void addCoordinate(const string& name);
+	/*
+	*	Add the coordinates of joint <jointName> neither locked nor
+	*	constrained in <s>
+	*/
+	void addFreeCoordinates(const SimTK::State& s, const string& jointName);
+	const vector<string>& getCoordinateNames() const { return m_names; }
+
+	/*
+	*	Move <s> to the equilibrium of the coordinates, starting from their
+	*	values in <s>. The speeds of <s> are zeroed and it is left realized
+	*	to Acceleration at the last iterate, also when not converged
+	*/
+	QuasiStaticResult solve(SimTK::State& s) const;
+
+	/*
+	*	Convergence and coordinate values on one line
+	*/
+	static string getReport(const QuasiStaticResult& result);
+
+private:
+	// generalized forces missing to hold the coordinates at rest at <q>
+	SimTK::Vector getResidual(SimTK::State& s, const SimTK::Vector& q) const;
+	SimTK::Matrix getJacobian(SimTK::State& s, const SimTK::Vector& q) const;
+	SimTK::Vector getStep(const SimTK::Matrix& jacobian, const SimTK::Vector& residual) const;
+
+	const Model& m_model;
+	QuasiStaticSettings m_settings;
+	vector<string> m_names;
+	vector<const Coordinate*> m_coordinates;
+	mutable vector<int> m_uIndices;
+	mutable int m_numEvaluations;
+};
+
+#endif
@@ -0,0 +1,169 @@
+#include "SteadyStateHandler.h"
+#include "CustomLigament.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+// handler of each system, to find it again from the model
+static std::mutex handlersMutex;
+static map<const SimTK::System*, SteadyStateHandler*> handlers;
+
+SteadyStateHandler::SteadyStateHandler(const Model& model, const SteadyStateSettings& settings)
+	: SimTK::PeriodicEventHandler(settings.interval), m_model(model), m_system(&model.getMultibodySystem()), m_settings(settings),
+	m_lastTime(-1), m_numStable(0), m_convergedTime(-1)
+{
+	std::lock_guard<std::mutex> lock(handlersMutex);
+	handlers[m_system] = this;
+}
+
+SteadyStateHandler::~SteadyStateHandler()
+{
+	std::lock_guard<std::mutex> lock(handlersMutex);
+	map<const SimTK::System*, SteadyStateHandler*>::iterator it = handlers.find(m_system);
+	if (it != handlers.end() && it->second == this)
+		handlers.erase(it);
+}
+
+SteadyStateHandler* SteadyStateHandler::get(const Model& model)
+{
+	std::lock_guard<std::mutex> lock(handlersMutex);
+	map<const SimTK::System*, SteadyStateHandler*>::const_iterator it = handlers.find(&model.getMultibodySystem());
+	return it == handlers.end() ? nullptr : it->second;
+}
+
+void SteadyStateHandler::add(Model& model, const SteadyStateSettings& settings, const string& leg)
+{
+	if (!settings.enabled)
+		return;
+
+	SteadyStateHandler* handler = new SteadyStateHandler(model, settings);
+	handler->addAnteriorTibialLoadOutputs(leg);
+	model.updMultibodySystem().addEventHandler(handler);
+}
+
+SimTK::State& SteadyStateHandler::initSystem(Model& model, const SteadyStateSettings& settings, const string& leg)
+{
+	model.buildSystem();
+	add(model, settings, leg);
+	return model.initializeState();
+}
+
+void SteadyStateHandler::addOutput(const string& name, const SteadyStateOutput& output, double tolerance)
+{
+	m_names.push_back(name);
+	m_outputs.push_back(output);
+	m_tolerances.push_back(tolerance);
+}
+
+void SteadyStateHandler::addCoordinate(const string& name)
+{
+	m_coordinateNames.push_back(name);
+}
+
+void SteadyStateHandler::addAnteriorTibialLoadOutputs(const string& leg)
+{
+	const CoordinateSet& knee = m_model.getJointSet().get("knee_" + leg).getCoordinateSet();
+	for (int c=0; c<knee.getSize(); c++)
+		addCoordinate(knee.get(c).getName());
+
+	// translations along the tibia axes, as in CustomAnalysis
+	m_tibia = "tibia_" + leg;
+	for (int axis=0; axis<2; axis++)
+		addOutput(axis == 0 ? "APT" : "SIT", [this, axis](const SimTK::State& s) -> double
+		{
+			SimTK::Transform transform = m_model.getSimbodyEngine().getTransform(s, m_model.getBodySet().get(m_tibia));
+			SimTK::Vec3 diff = transform.p() - m_initialPosition;
+			return ~diff * (axis == 0 ? transform.x() : transform.y());
+		}, m_settings.translationTolerance);
+
+	// cruciate and collateral ligaments, named like aACL_R
+	string suffix = "_" + leg;
+	std::transform(suffix.begin(), suffix.end(), suffix.begin(), ::toupper);
+	const ForceSet& forces = m_model.getForceSet();
+	for (int f=0; f<forces.getSize(); f++)
+	{
+		const string name = forces.get(f).getName();
+		if (name.size() < 4 || name.substr(2, 2) != "CL" || name.size() < suffix.size()
+			|| name.substr(name.size() - suffix.size()) != suffix)
+			continue;
+
+		const Force* force = &forces.get(f);
+		addOutput(name + "_force", [force](const SimTK::State& s) -> double
+		{
+			const CustomLigament* custom = dynamic_cast<const CustomLigament*>(force);
+			if (custom)
+				return custom->getTension(s);
+			const Ligament* ligament = dynamic_cast<const Ligament*>(force);
+			return ligament ? ligament->getTension(s) : 0.0;
+		}, m_settings.tensionTolerance);
+	}
+}
+
+void SteadyStateHandler::reset(const SimTK::State& initial)
+{
+	m_values.clear();
+	m_lastTime = -1;
+	m_numStable = 0;
+	m_convergedTime = -1;
+
+	if (!m_tibia.empty())
+	{
+		m_model.getMultibodySystem().realize(initial, SimTK::Stage::Position);
+		m_initialPosition = m_model.getSimbodyEngine().getTransform(initial, m_model.getBodySet().get(m_tibia)).p();
+	}
+}
+
+void SteadyStateHandler::handleEvent(SimTK::State& state, SimTK::Real accuracy, bool& shouldTerminate) const
+{
+	m_model.getMultibodySystem().realize(state, SimTK::Stage::Dynamics);
+
+	// watched coordinates at rest
+	double speed = 0;
+	if (m_coordinateNames.empty())
+	{
+		for (int i=0; i<state.getNU(); i++)
+			speed = std::max(speed, std::fabs(state.getU()[i]));
+	}
+	else
+	{
+		for (unsigned int c=0; c<m_coordinateNames.size(); c++)
+			speed = std::max(speed, std::fabs(m_model.getCoordinateSet().get(m_coordinateNames[c]).getSpeedValue(state)));
+	}
+	bool stable = speed <= m_settings.speedTolerance;
+
+	// outputs not drifting since the last check
+	vector<double> values(m_outputs.size());
+	for (unsigned int o=0; o<m_outputs.size(); o++)
+		values[o] = m_outputs[o](state);
+
+	const double dt = state.getTime() - m_lastTime;
+	if (m_lastTime < 0 || values.size() != m_values.size() || dt <= 0)
+		stable = false;
+	else
+		for (unsigned int o=0; o<values.size() && stable; o++)
+			stable = std::fabs(values[o] - m_values[o]) / dt <= m_tolerances[o];
+
+	m_values = values;
+	m_lastTime = state.getTime();
+	m_numStable = stable ? m_numStable + 1 : 0;
+
+	if (m_numStable >= m_settings.numStableChecks && state.getTime() >= m_settings.minTime)
+	{
+		m_convergedTime = state.getTime();
+		shouldTerminate = true;
+	}
+}
+
+string SteadyStateHandler::getReport() const
+{
+	std::ostringstream report;
+	if (isConverged())
+		report << "steady state at t = " << m_convergedTime;
+	else
+		report << "no steady state up to t = " << m_lastTime;
+	for (unsigned int o=0; o<m_names.size() && o<m_values.size(); o++)
+		report << ", " << m_names[o] << " = " << m_values[o];
+	return report.str();
+}
@@ -0,0 +1,124 @@
+#ifndef STEADYSTATEHANDLER_H
+#define STEADYSTATEHANDLER_H
+
+#include <OpenSim/OpenSim.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace OpenSim;
+
+/*
+*	Output watched by the steady state detection, evaluated on a state
+*	realized to Dynamics
+*/
+typedef std::function<double(const SimTK::State& state)> SteadyStateOutput;
+
+struct SteadyStateSettings
+{
+	bool enabled;
+	double interval;			// time between checks (s)
+	double speedTolerance;		// largest speed of the watched coordinates
+	double translationTolerance;	// APT, SIT rate of change (m/s)
+	double tensionTolerance;	// ligament tension rate of change (N/s)
+	int numStableChecks;		// consecutive checks within the tolerances
+	double minTime;				// never stop before
+
+	SteadyStateSettings()
+		: enabled(true), interval(0.01), speedTolerance(1.e-3), translationTolerance(1.e-4), tensionTolerance(1.0),
+		numStableChecks(3), minTime(0.05) {}
+};
+
+/*
+*	Stops the integration once the watched coordinates are at rest and the
+*	watched outputs stop drifting, e.g. the tibia settled under the constant
+*	anterior load. Checked every settings.interval; the converged values
+*	are kept for the report.
+*
+*	Added to the system between Model::buildSystem() and
+*	Model::initializeState() (the system owns it), then found again with
+*	SteadyStateHandler::get(model)
+*/
+class SteadyStateHandler : public SimTK::PeriodicEventHandler
+{
+public:
+	SteadyStateHandler(const Model& model, const SteadyStateSettings& settings = SteadyStateSettings());
+	~SteadyStateHandler();
+
+	/*
+	*	Add <output>, steady when it changes less than <tolerance> per second
+	*/
+	void addOutput(const string& name, const SteadyStateOutput& output, double tolerance);
+	/*
+	*	Watch the speed of coordinate <name>; without any, all the speeds
+	*/
+	void addCoordinate(const string& name);
+	/*
+	*	Watch the knee coordinates, the anterior and superior translations
+	*	of the tibia (APT, SIT as in CustomAnalysis) and the tension of the
+	*	cruciate and collateral ligaments of <leg>
+	*/
+	void addAnteriorTibialLoadOutputs(const string& leg = "r");
+
+	/*
+	*	Clear the history before integrating from <initial>, the reference
+	*	of the tibia translations
+	*/
+	void reset(const SimTK::State& initial);
+
+	void handleEvent(SimTK::State& state, SimTK::Real accuracy, bool& shouldTerminate) const;
+
+	bool isConverged() const { return m_convergedTime >= 0; }
+	// time the integration was stopped, -1 if it ran to the end
+	double getConvergedTime() const { return m_convergedTime; }
+	const vector<string>& getOutputNames() const { return m_names; }
+	// last checked values of the outputs
+	const vector<double>& getOutputValues() const { return m_values; }
+
+	/*
+	*	Converged time and values on one line
+	*/
+	string getReport() const;
+
+	/*
+	*	Handler of the system of <model>, nullptr if it has none
+	*/
+	static SteadyStateHandler* get(const Model& model);
+
+	/*
+	*	Add a new steady state handler watching the anterior tibial load
+	*	outputs of <leg> to the system of <model>, between
+	*	Model::buildSystem() and Model::initializeState(); nothing if the
+	*	settings are disabled
+	*/
+	static void add(Model& model, const SteadyStateSettings& settings = SteadyStateSettings(), const string& leg = "r");
+	/*
+	*	Build the system of <model> with a new steady state handler
+	*	watching the anterior tibial load outputs of <leg> (replaces
+	*	Model::initSystem())
+	*/
+	static SimTK::State& initSystem(Model& model, const SteadyStateSettings& settings = SteadyStateSettings(),
+		const string& leg = "r");
+
+private:
+	const Model& m_model;
+	const SimTK::System* m_system;	// key of the handler
+	SteadyStateSettings m_settings;
+	vector<string> m_names;
+	vector<SteadyStateOutput> m_outputs;
+	vector<double> m_tolerances;
+	vector<string> m_coordinateNames;
+
+	// tibia translations, relative to its position in the initial state
+	string m_tibia;
+	SimTK::Vec3 m_initialPosition;
+
+	// history of the integration, the handler is called on a const object
+	mutable vector<double> m_values;
+	mutable double m_lastTime;
+	mutable int m_numStable;
+	mutable double m_convergedTime;
+};
+
+#endif
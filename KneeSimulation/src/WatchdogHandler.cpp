@@ -0,0 +1,145 @@
+#include "WatchdogHandler.h"
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+// handler of each system, to find it again from the model
+static std::mutex handlersMutex;
+static map<const SimTK::System*, WatchdogHandler*> handlers;
+
+WatchdogHandler::WatchdogHandler(const Model& model, const WatchdogSettings& settings)
+	: SimTK::TriggeredEventHandler(SimTK::Stage::Time), m_model(model), m_system(&model.getMultibodySystem()),
+	m_settings(settings), m_start(std::chrono::steady_clock::now()), m_startRealizations(0), m_lastTime(0),
+	m_windowTime(0), m_windowRealizations(0)
+{
+	// the witness only goes from within to out of the budgets
+	getTriggerInfo().setTriggerOnRisingSignTransition(false);
+
+	std::lock_guard<std::mutex> lock(handlersMutex);
+	handlers[m_system] = this;
+}
+
+WatchdogHandler::~WatchdogHandler()
+{
+	std::lock_guard<std::mutex> lock(handlersMutex);
+	map<const SimTK::System*, WatchdogHandler*>::iterator it = handlers.find(m_system);
+	if (it != handlers.end() && it->second == this)
+		handlers.erase(it);
+}
+
+WatchdogHandler* WatchdogHandler::get(const Model& model)
+{
+	std::lock_guard<std::mutex> lock(handlersMutex);
+	map<const SimTK::System*, WatchdogHandler*>::const_iterator it = handlers.find(&model.getMultibodySystem());
+	return it == handlers.end() ? nullptr : it->second;
+}
+
+void WatchdogHandler::add(Model& model, const WatchdogSettings& settings)
+{
+	if (settings.enabled)
+		model.updMultibodySystem().addEventHandler(new WatchdogHandler(model, settings));
+}
+
+void WatchdogHandler::reset(const SimTK::State& initial)
+{
+	m_start = std::chrono::steady_clock::now();
+	m_startRealizations = m_system->getNumRealizationsOfThisStage(SimTK::Stage::Dynamics);
+	m_lastTime = m_windowTime = initial.getTime();
+	m_windowRealizations = 0;
+	m_reason.clear();
+}
+
+long long WatchdogHandler::getNumRealizations() const
+{
+	return m_system->getNumRealizationsOfThisStage(SimTK::Stage::Dynamics) - m_startRealizations;
+}
+
+double WatchdogHandler::getWallTime() const
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+}
+
+void WatchdogHandler::check(const SimTK::State& state) const
+{
+	// the stages of a step and the localization of events realize times
+	// out of order, the window follows the latest one
+	m_lastTime = std::max(m_lastTime, state.getTime());
+	const long long realizations = getNumRealizations();
+	const double wallTime = getWallTime();
+
+	std::ostringstream reason;
+	if (m_settings.maxWallTime > 0 && wallTime > m_settings.maxWallTime)
+		reason << "wall time " << wallTime << " s over " << m_settings.maxWallTime << " s";
+	else if (m_settings.maxRealizations > 0 && realizations > m_settings.maxRealizations)
+		reason << realizations << " evaluations of the forces over " << m_settings.maxRealizations;
+	else if (m_settings.stallRealizations > 0 && realizations - m_windowRealizations >= m_settings.stallRealizations)
+	{
+		const double stepSize = (m_lastTime - m_windowTime) / (realizations - m_windowRealizations);
+		if (stepSize < m_settings.minStepSize)
+			reason << "stalled, " << stepSize << " s per evaluation of the forces over the last "
+				<< realizations - m_windowRealizations << " (minimum " << m_settings.minStepSize << " s)";
+		m_windowTime = m_lastTime;
+		m_windowRealizations = realizations;
+	}
+
+	if (!reason.str().empty())
+		m_reason = reason.str() + " at t = " + std::to_string((long double)m_lastTime);
+}
+
+SimTK::Real WatchdogHandler::getValue(const SimTK::State& state) const
+{
+	if (!isTriggered())
+		check(state);
+	return isTriggered() ? -1 : 1;
+}
+
+void WatchdogHandler::handleEvent(SimTK::State& state, SimTK::Real accuracy, bool& shouldTerminate) const
+{
+	shouldTerminate = true;
+}
+
+void WatchdogHandler::printDiagnostics(const SimTK::State& state, const string& prefix) const
+{
+	m_model.getMultibodySystem().realize(state, SimTK::Stage::Dynamics);
+
+	// state variables
+	Array<string> labels;
+	labels.append("time");
+	labels.append(m_model.getStateVariableNames());
+	Array<double> values;
+	m_model.getStateValues(state, values);
+	Storage states;
+	states.setName("watchdog_state");
+	states.setColumnLabels(labels);
+	states.append(state.getTime(), values.getSize(), values.getSize() > 0 ? &values[0] : 0);
+	states.print(prefix + "_state.sto");
+
+	// contact forces
+	Array<string> contactLabels;
+	Array<double> contactValues;
+	contactLabels.append("time");
+	const ForceSet& forces = m_model.getForceSet();
+	for (int f=0; f<forces.getSize(); f++)
+	{
+		const Force& force = forces.get(f);
+		if (!dynamic_cast<const ElasticFoundationForce*>(&force) && !dynamic_cast<const HuntCrossleyForce*>(&force))
+			continue;
+		if (force.isDisabled(state))
+			continue;
+		contactLabels.append(force.getRecordLabels());
+		contactValues.append(force.getRecordValues(state));
+	}
+	Storage contacts;
+	contacts.setName("watchdog_contacts");
+	contacts.setColumnLabels(contactLabels);
+	contacts.append(state.getTime(), contactValues.getSize(), contactValues.getSize() > 0 ? &contactValues[0] : 0);
+	contacts.print(prefix + "_contacts.sto");
+
+	ofstream file((prefix + "_watchdog.txt").c_str());
+	file << "reason\t" << (isTriggered() ? m_reason : "none") << endl;
+	file << "time\t" << state.getTime() << endl;
+	file << "wall_time\t" << getWallTime() << endl;
+	file << "realizations\t" << getNumRealizations() << endl;
+}
@@ -0,0 +1,93 @@
+#ifndef WATCHDOGHANDLER_H
+#define WATCHDOGHANDLER_H
+
+#include <OpenSim/OpenSim.h>
+#include <chrono>
+#include <string>
+
+using namespace std;
+using namespace OpenSim;
+
+struct WatchdogSettings
+{
+	bool enabled;
+	double maxWallTime;			// of an integration (s), 0 for no limit
+	long long maxRealizations;	// evaluations of the forces (Dynamics stage) of an integration, 0 for no limit
+	double minStepSize;			// mean simulated time per evaluation of the forces ...
+	int stallRealizations;		// ... over this many evaluations, 0 for no limit
+
+	WatchdogSettings(bool aEnabled = true)
+		: enabled(aEnabled), maxWallTime(3600), maxRealizations(5000000), minStepSize(1.e-9), stallRealizations(20000) {}
+};
+
+/*
+*	Stops an integration that ran out of its budgets: wall time, number
+*	of evaluations of the forces, or simulated time per evaluation (an
+*	integrator stalled on near-zero step sizes). The budgets are checked
+*	by the witness function, on every state realized to Time during the
+*	integration, and the first one exceeded is kept; the integrator then
+*	triggers the event at the end of its step and the handler terminates
+*	the integration like the end of the simulation. The caller checks
+*	isTriggered() afterwards.
+*
+*	Added to the system between Model::buildSystem() and
+*	Model::initializeState() (the system owns it), then found again with
+*	WatchdogHandler::get(model)
+*/
+class WatchdogHandler : public SimTK::TriggeredEventHandler
+{
+public:
+	WatchdogHandler(const Model& model, const WatchdogSettings& settings = WatchdogSettings());
+	~WatchdogHandler();
+
+	/*
+	*	Start the budgets before integrating from <initial>
+	*/
+	void reset(const SimTK::State& initial);
+
+	// positive within the budgets, negative once one is exceeded
+	SimTK::Real getValue(const SimTK::State& state) const;
+	void handleEvent(SimTK::State& state, SimTK::Real accuracy, bool& shouldTerminate) const;
+
+	bool isTriggered() const { return !m_reason.empty(); }
+	// exceeded budget, empty if none
+	const string& getReason() const { return m_reason; }
+
+	/*
+	*	Snapshot of <state>, the last one of a stopped integration:
+	*	<prefix>_state.sto (state variables), <prefix>_contacts.sto (record
+	*	values of the contact forces) and <prefix>_watchdog.txt (reason and
+	*	budgets used)
+	*/
+	void printDiagnostics(const SimTK::State& state, const string& prefix) const;
+
+	/*
+	*	Handler of the system of <model>, nullptr if it has none
+	*/
+	static WatchdogHandler* get(const Model& model);
+	/*
+	*	Add a new watchdog to the system of <model>, between
+	*	Model::buildSystem() and Model::initializeState(); nothing if the
+	*	settings are disabled
+	*/
+	static void add(Model& model, const WatchdogSettings& settings = WatchdogSettings());
+
+private:
+	long long getNumRealizations() const;
+	double getWallTime() const;
+	void check(const SimTK::State& state) const;
+
+	const Model& m_model;
+	const SimTK::System* m_system;	// key of the handler
+	WatchdogSettings m_settings;
+
+	// budgets used by the integration, the handler is called on a const object
+	std::chrono::steady_clock::time_point m_start;
+	int m_startRealizations;
+	mutable double m_lastTime;			// latest time realized
+	mutable double m_windowTime;		// latest time at the start of the stall window
+	mutable long long m_windowRealizations;
+	mutable string m_reason;
+};
+
+#endif
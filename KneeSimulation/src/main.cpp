@@ -4,6 +4,7 @@
 #include "CustomLigament.h"
 #include <ctime>
 #include "MonteCarloFD.h"
+#include "KneeKinematicsTable.h"
 #include <math.h>
 #include <random>
 
@@ -27,6 +28,17 @@ int main(int argc, char *argv[])
 	try 
 	{
 		Object::registerType(CustomLigament());
+		MCStudy::registerTypes();
+
+		/*
+		*	HEADLESS: run the study files given as arguments (see MCStudy.h), e.g.
+		*	aclsim ../resources/studies/acl_lengths_atl.xml
+		*/
+		if (argc > 1)
+		{
+			performMCStudies(vector<string>(argv + 1, argv + argc));
+			return 0;
+		}
 
 		// Create an OpenSim model and set its name
 		OpenSim::Model model("../resources/3DGaitModel2392_optimized_v6.osim");
@@ -52,6 +64,11 @@ int main(int argc, char *argv[])
 		//model.print("../resources/geometries/closed_knee_ligaments_1_0.osim");	
 		//printLigamentLengths(model);
 
+		/*
+		*	PASSIVE KNEE KINEMATICS TABLE (interpolated by setKneeAngle)
+		*/
+		//KneeKinematicsTable::generate(model, -120, 0, 1).print(KneeKinematicsTable::DefaultFileName);
+
 		/*
 		*	ANTERIOR TIBIAL LOADS SIMULATION
 		*/
@@ -59,11 +76,57 @@ int main(int argc, char *argv[])
 		//for (int i=0; i<5; i++){
 		//	anteriorTibialLoadsFD(model, kneeAngle[i]);
 		//}
+		// static equilibrium only, without integrating
+		//anteriorTibialLoadsQS(model, -60);
+		// load-displacement and angle-laxity curves from 0 to -90 degrees in one pass
+		//anteriorTibialLoadsSweep(model, 0, -90, 1, 110, 11);
 
 		/*
 		*	ANTERIOR TIBIAL LOADS MONTE CARLO ANALYSIS
 		*/
 		//performMCFD_atl(model, 40);
+		// multi-fidelity: 20 full samples, up to 400 at accuracy 1e-2 over 0.4 s
+		//performMCMultiFidelity_atl(model, 20, 400, MCFidelity("low_fidelity", 1.e-2, 0.4));
+
+		/*
+		*	ANTERIOR TIBIAL LOADS SURROGATE WITH ACTIVE LEARNING
+		*/
+		//vector<int> samples;
+		//for (int i=0; i<10; i++)
+		//	samples.push_back(i);
+		//for (int batch=0; batch<5; batch++)
+		//{
+		//	performMCFD_atl(model, 1000, 0, 0, MCSobol, MCConvergenceTargets(), samples);
+		//	samples = performMCSurrogate_atl(1000, 4);
+		//}
+
+		/*
+		*	FLEXION SURROGATE WITH ACTIVE LEARNING
+		*/
+		//vector<int> samples;
+		//for (int i=0; i<10; i++)
+		//	samples.push_back(i);
+		//for (int batch=0; batch<5; batch++)
+		//{
+		//	performMCFD_flexion(model, 1000, 0, 0, MCSobol, MCConvergenceTargets(), samples);
+		//	samples = performMCSurrogate_flexion(1000, 4);
+		//}
+
+		/*
+		*	ANTERIOR TIBIAL LOADS SENSITIVITY ANALYSIS
+		*/
+		//vector<MCModelParameter> parameters;
+		//parameters.push_back(MCModelParameter("aACL_R", MCRestingLength, 0.0285, 0.0335));
+		//parameters.push_back(MCModelParameter("pACL_R", MCRestingLength, 0.0228, 0.0278));
+		//parameters.push_back(MCModelParameter("aACL_R", MCStiffness, 1300, 1700));
+		//parameters.push_back(MCModelParameter("femur_lat_meniscii_r", MCContactStiffness, 5*1.e8, 5*1.e9));
+		//parameters.push_back(MCModelParameter("femur_lat_meniscii_r", MCContactDissipation, 0.0, 20.0));
+		//performMCSensitivity_atl(model, parameters, 64);
+
+		/*
+		*	ANTERIOR TIBIAL LOADS ACL OVERLOAD PROBABILITY
+		*/
+		//performMCRareEvent_atl(model, parameters, "aACL_R_force", 400, MCSubsetSimulation);
 
 		/*
 		*	ACTIVE KNEE FLEXION SIMULATION
@@ -74,6 +137,19 @@ int main(int argc, char *argv[])
 		*	ACTIVE KNEE FLEXION MONTE CARLO ANALYSIS
 		*/
 		//performMCFD_flexion(model, 100);
+		//performMCMultiFidelity_flexion(model, 20, 400, MCFidelity("low_fidelity", 1.e-2, 0.15));
+
+		/*
+		*	INTEGRATOR SETTINGS: TIME AGAINST ERROR OF THE LIGAMENT FORCES
+		*/
+		//benchmarkIntegrators_atl(model);
+		//benchmarkIntegrators_flexion(model);
+
+		/*
+		*	COST OF EVERY FORCE PER EVALUATION, RANKED
+		*/
+		//measureForceCosts_atl(model);
+		//measureForceCosts_flexion(model);
 
 		/*
 		*	PERFORM A KNEE TASK AND VISUALIZE ARTICULAR CONTACT POINTS (ON TIBIA AND FEMUR)
@@ -102,6 +178,8 @@ int main(int argc, char *argv[])
         std::cout << "UNRECOGNIZED EXCEPTION" << std::endl;
     }
 
-	std::cin.get();
+	// no console input when running studies
+	if (argc == 1)
+		std::cin.get();
 	return 1;
 }
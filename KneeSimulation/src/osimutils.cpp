@@ -1,4 +1,5 @@
 #include "osimutils.h"
+#include <mutex>
 
 template <class charT, charT sep> class punct_facet : public std::numpunct<charT> {
 protected:
@@ -167,4 +168,74 @@ void writeArrayToFile(string filename, const Array<double> myArray)
 
     file.close();
 
-}
\ No newline at end of file
+}
+
+AnalysisGuard::~AnalysisGuard()
+{
+	for (int a=(int)m_analyses.size()-1; a>=0; a--)
+	{
+		try
+		{
+			m_model.removeAnalysis(m_analyses[a]);
+		}
+		catch (...)
+		{
+			// the model may be going away with the exception
+		}
+	}
+}
+
+void appendSampleToFile(string filename, int sample, double value)
+{
+	// called from the workers of a campaign
+	static std::mutex fileMutex;
+	std::lock_guard<std::mutex> lock(fileMutex);
+
+	ifstream test(filename.c_str());
+	const bool exists = test.good();
+	test.close();
+
+	ofstream file(filename.c_str(), ios::app);
+
+	// Labels
+	if (!exists)
+		file << "sample\tvalue" << endl;
+	file << sample << "\t" << setprecision(17) << value << endl;
+
+	file.close();
+}
+
+double getPeakValue(Storage& storage, const string& column, bool absolute)
+{
+	Array<double> values;
+	storage.getDataColumn(column, values);
+
+	double peak = SimTK::NaN;
+	for (int t=0; t<values.getSize(); t++)
+	{
+		double value = absolute ? std::abs(values[t]) : values[t];
+		if (t == 0 || value > peak)
+			peak = value;
+	}
+	return peak;
+}
+
+void getCoordinateIndices(const Model& model, const State& s, const vector<string>& names, vector<int>& qIndices,
+	vector<int>& uIndices)
+{
+	qIndices.clear();
+	uIndices.clear();
+	for (unsigned int c=0; c<names.size(); c++)
+	{
+		const Coordinate& coordinate = model.getCoordinateSet().get(names[c]);
+		const MobilizedBody& mobod = model.getMatterSubsystem().getMobilizedBody(coordinate.getBodyIndex());
+		// a coordinate only has a U of the same index in a mobilizer with
+		// u = qdot (CustomJoint), not in one with quaternions
+		if (mobod.getNumQ(s) != mobod.getNumU(s))
+			throw OpenSim::Exception("getCoordinateIndices: the mobilizer of " + names[c] + " has "
+				+ std::to_string((long long)mobod.getNumQ(s)) + " Qs and "
+				+ std::to_string((long long)mobod.getNumU(s)) + " Us");
+		qIndices.push_back(mobod.getFirstQIndex(s) + coordinate.getMobilizerQIndex());
+		uIndices.push_back(mobod.getFirstUIndex(s) + coordinate.getMobilizerQIndex());
+	}
+}
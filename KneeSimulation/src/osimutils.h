@@ -35,6 +35,36 @@ public:
         const Array<Vector> &forces, const Vector &times);
 };
 
+/*
+*	Analyses added to a model for the lifetime of the guard: they are
+*	removed (and deleted by the model) on every way out of the scope,
+*	exceptions included, so a failed sample leaves no reporter attached
+*	to the model of its worker
+*/
+class AnalysisGuard
+{
+public:
+	explicit AnalysisGuard(Model& model) : m_model(model) {}
+	~AnalysisGuard();
+
+	/*
+	*	Add <analysis> to the model, which owns it until the guard removes it
+	*/
+	template<class T> T* add(T* analysis)
+	{
+		m_model.addAnalysis(analysis);
+		m_analyses.push_back(analysis);
+		return analysis;
+	}
+
+private:
+	AnalysisGuard(const AnalysisGuard&);
+	AnalysisGuard& operator=(const AnalysisGuard&);
+
+	Model& m_model;
+	vector<Analysis*> m_analyses;
+};
+
 /*
 *	Print ligament lengths during knee extension
 */
@@ -43,5 +73,21 @@ void printLigamentLengthsInExtension(Model model);
 *	Write <myArray> values to file with name <filename>
 */
 void writeArrayToFile(string filename, const Array<double> myArray);
+/*
+*	Append the value of sample <sample> to file with name <filename>,
+*	writing the column labels first if the file is new. Safe from the
+*	workers of a campaign
+*/
+void appendSampleToFile(string filename, int sample, double value);
+/*
+*	Peak of column <column> of <storage>, in absolute value if <absolute>
+*/
+double getPeakValue(Storage& storage, const string& column, bool absolute = false);
+/*
+*	Entries of coordinates <names> in the Q and U vectors of <s>. The
+*	mobilizers of the coordinates must have as many Us as Qs
+*/
+void getCoordinateIndices(const Model& model, const State& s, const vector<string>& names, vector<int>& qIndices,
+	vector<int>& uIndices);
 
 #endif
\ No newline at end of file